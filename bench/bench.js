@@ -0,0 +1,306 @@
+// Benchmarks the hot Matrix methods through the binding and prints the results
+// as JSON, so two runs can be compared with bench/compare.js.
+//
+//   node bench/bench.js [--filter regex] [--time ms] [--out file]
+//
+// With the profiler on, each result also carries the time spent in native
+// code (nativeNs), so overheadNs is what the call costs on top of OpenCV.
+// Both are null for cases that only call untimed accessors.
+var cv = require('../lib/opencv');
+var fs = require('fs');
+var path = require('path');
+var os = require('os');
+
+var files = path.join(__dirname, '..', 'examples', 'files');
+var data = path.join(__dirname, '..', 'data');
+
+var args = process.argv.slice(2);
+function option(name, fallback) {
+  var i = args.indexOf('--' + name);
+  return i >= 0 ? args[i + 1] : fallback;
+}
+
+var filter = new RegExp(option('filter', '.'));
+var minTime = parseInt(option('time', '1000'), 10);
+var out = option('out');
+
+var car = fs.readFileSync(path.join(files, 'car1.jpg'));
+
+// Decoded once up front, see loadImages()
+var images = {};
+
+function load(name) {
+  return images[name].clone();
+}
+
+// setup(mona) prepares the state passed to every fn(state) call, which makes
+// one call of the method under test. Async cases return a Promise.
+var cases = [
+  {
+    name: 'readImage(path)',
+    fn: function() { return cv.readImage(path.join(files, 'mona.png')); }
+  },
+  {
+    name: 'readImage(buffer)',
+    fn: function() { return cv.readImage(car); }
+  },
+  {
+    name: 'toBuffer(jpg)',
+    setup: function(im) { return im; },
+    fn: function(im) { return im.toBuffer({ext: '.jpg'}); }
+  },
+  {
+    name: 'toBuffer(png)',
+    setup: function(im) { return im; },
+    fn: function(im) { return im.toBuffer({ext: '.png'}); }
+  },
+  {
+    name: 'toBufferAsync(jpg)',
+    setup: function(im) { return im; },
+    fn: function(im) {
+      return new Promise(function(resolve, reject) {
+        im.toBufferAsync(function(err, buf) { err ? reject(err) : resolve(buf); });
+      });
+    }
+  },
+  {
+    name: 'getData',
+    setup: function(im) { return im; },
+    fn: function(im) { return im.getData(); }
+  },
+  {
+    name: 'pixel',
+    setup: function(im) { return im; },
+    fn: function(im) { return im.pixel(10, 10); }
+  },
+  {
+    name: 'pixelRow',
+    setup: function(im) { return im; },
+    fn: function(im) { return im.pixelRow(10); }
+  },
+  {
+    name: 'pixelCol',
+    setup: function(im) { return im; },
+    fn: function(im) { return im.pixelCol(10); }
+  },
+  {
+    name: 'row',
+    setup: function(im) {
+      var gray = im.clone();
+      gray.convertGrayscale();
+      return gray;
+    },
+    fn: function(gray) { return gray.row(10); }
+  },
+  {
+    name: 'col',
+    setup: function(im) {
+      var gray = im.clone();
+      gray.convertGrayscale();
+      return gray;
+    },
+    fn: function(gray) { return gray.col(10); }
+  },
+  {
+    name: 'resize',
+    setup: function(im) { return im; },
+    fn: function(im) { return im.resize(new cv.Size(im.width() / 2, im.height() / 2)); }
+  },
+  {
+    name: 'resizeAsync',
+    setup: function(im) { return im; },
+    fn: function(im) { return im.resizeAsync(new cv.Size(im.width() / 2, im.height() / 2)); }
+  },
+  {
+    // Same size in and out, so running it on its own output costs the same
+    name: 'cvtColor(BGR2HSV)',
+    setup: function(im) { return im.clone(); },
+    fn: function(im) { return im.cvtColor('CV_BGR2HSV'); }
+  },
+  {
+    name: 'gaussianBlur',
+    setup: function(im) { return im.clone(); },
+    fn: function(im) { return im.gaussianBlur([5, 5]); }
+  },
+  {
+    name: 'findContours',
+    setup: function() {
+      var im = load('shapes.jpg');
+      im.convertGrayscale();
+      im.canny(0, 100);
+      return im;
+    },
+    // findContours modifies its input
+    fn: function(edges) { return edges.clone().findContours(); }
+  },
+  {
+    name: 'detectMultiScale',
+    setup: function(im) {
+      return {
+        im: im,
+        classifier: new cv.CascadeClassifier(path.join(data, 'haarcascade_frontalface_alt.xml'))
+      };
+    },
+    fn: function(state) {
+      return new Promise(function(resolve, reject) {
+        state.classifier.detectMultiScale(state.im, function(err, faces) {
+          err ? reject(err) : resolve(faces);
+        });
+      });
+    }
+  },
+  {
+    name: 'matchTemplate',
+    setup: function() {
+      return {im: load('car1.jpg'), templ: load('car1_template.jpg')};
+    },
+    fn: function(state) {
+      return state.im.matchTemplate(state.templ, cv.Constants.TM_CCORR_NORMED);
+    }
+  }
+];
+
+function now() {
+  var t = process.hrtime();
+  return t[0] * 1e9 + t[1];
+}
+
+function percentile(sorted, p) {
+  return sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * p))];
+}
+
+// Runs fn enough times per sample for the timer to not matter, and keeps
+// sampling until minTime has passed. Returns the per-call time of each sample,
+// and the number of calls made in total for nativeTime().
+function measureSync(fn, state) {
+  var batch = 1;
+  var calls = 0;
+  for (;;) {
+    var start = now();
+    for (var i = 0; i < batch; i++) {
+      fn(state);
+    }
+    calls += batch;
+    if (now() - start > 1e5 || batch >= 1 << 20) {
+      break;
+    }
+    batch *= 2;
+  }
+
+  var samples = [];
+  var end = now() + minTime * 1e6;
+  while (now() < end || samples.length < 5) {
+    var t = now();
+    for (var j = 0; j < batch; j++) {
+      fn(state);
+    }
+    samples.push((now() - t) / batch);
+    calls += batch;
+  }
+  return {samples: samples, calls: calls};
+}
+
+function measureAsync(fn, state) {
+  var samples = [];
+  var end = now() + minTime * 1e6;
+
+  function next() {
+    if (now() >= end && samples.length >= 5) {
+      return Promise.resolve({samples: samples, calls: samples.length});
+    }
+    var t = now();
+    return fn(state).then(function() {
+      samples.push(now() - t);
+      return next();
+    });
+  }
+  return next();
+}
+
+// Native time of everything the case called, per call of the case, or null
+// when nothing it called is timed (plain accessors such as pixel() are not)
+function nativeTime(stats, calls) {
+  if (!Object.keys(stats).length) {
+    return null;
+  }
+  var total = 0;
+  Object.keys(stats).forEach(function(op) {
+    // The synchronous half of an async method only queues the worker
+    if (/:worker$/.test(op) || !stats[op + ':worker']) {
+      total += stats[op].totalMs * 1e6;
+    }
+  });
+  return total / calls;
+}
+
+function run(c) {
+  var state = c.setup ? c.setup(load('mona.png')) : undefined;
+
+  // Warm up, and find out whether the case is async
+  var warmup = c.fn(state);
+  var isAsync = warmup instanceof Promise;
+
+  return Promise.resolve(warmup).then(function() {
+    cv.profiler.reset();
+    cv.profiler.enable();
+    return isAsync ? measureAsync(c.fn, state) : measureSync(c.fn, state);
+  }).then(function(result) {
+    cv.profiler.disable();
+    var stats = cv.stats();
+
+    var sorted = result.samples.slice().sort(function(a, b) { return a - b; });
+    var mean = sorted.reduce(function(a, b) { return a + b; }, 0) / sorted.length;
+    var nativeNs = nativeTime(stats, result.calls);
+
+    return {
+      name: c.name,
+      async: isAsync,
+      calls: result.calls,
+      samples: sorted.length,
+      meanNs: Math.round(mean),
+      minNs: Math.round(sorted[0]),
+      p50Ns: Math.round(percentile(sorted, 0.5)),
+      p99Ns: Math.round(percentile(sorted, 0.99)),
+      maxNs: Math.round(sorted[sorted.length - 1]),
+      nativeNs: nativeNs === null ? null : Math.round(nativeNs),
+      overheadNs: nativeNs === null ? null : Math.round(mean - nativeNs),
+      profile: stats
+    };
+  });
+}
+
+function loadImages() {
+  var names = ['mona.png', 'shapes.jpg', 'car1.jpg', 'car1_template.jpg'];
+  return Promise.all(names.map(function(name) {
+    return cv.readImage(path.join(files, name)).then(function(im) {
+      images[name] = im;
+    });
+  }));
+}
+
+var results = [];
+cases.filter(function(c) { return filter.test(c.name); }).reduce(function(p, c) {
+  return p.then(function() {
+    return run(c).then(function(result) {
+      results.push(result);
+      process.stderr.write(c.name + ': ' + (result.meanNs / 1e3).toFixed(1) + 'us/call\n');
+    });
+  });
+}, loadImages()).then(function() {
+  var report = JSON.stringify({
+    date: new Date().toISOString(),
+    node: process.version,
+    opencv: cv.version,
+    cpu: os.cpus()[0].model,
+    results: results
+  }, null, 2);
+
+  if (out) {
+    fs.writeFileSync(out, report + '\n');
+  } else {
+    console.log(report);
+  }
+}).catch(function(err) {
+  console.error(err.stack || err);
+  process.exit(1);
+});
@@ -0,0 +1,65 @@
+// Compares two bench/bench.js reports and exits with 1 if any case got slower
+// by more than the threshold.
+//
+//   node bench/compare.js base.json new.json [--threshold 10]
+var fs = require('fs');
+
+var args = process.argv.slice(2);
+var i = args.indexOf('--threshold');
+var threshold = i >= 0 ? parseFloat(args.splice(i, 2)[1]) : 10;
+
+if (args.length !== 2) {
+  console.error('usage: node bench/compare.js base.json new.json [--threshold percent]');
+  process.exit(2);
+}
+
+function read(file) {
+  var byName = {};
+  JSON.parse(fs.readFileSync(file, 'utf8')).results.forEach(function(r) {
+    byName[r.name] = r;
+  });
+  return byName;
+}
+
+var base = read(args[0]);
+var current = read(args[1]);
+
+function pad(s, n) {
+  s = String(s);
+  while (s.length < n) {
+    s += ' ';
+  }
+  return s;
+}
+
+// Overhead is null for cases with no native time to split it from
+function us(ns) {
+  return ns === null || ns === undefined ? '-' : (ns / 1e3).toFixed(1);
+}
+
+var regressions = 0;
+console.log(pad('case', 24) + pad('base us', 12) + pad('new us', 12) + pad('change', 10) + 'overhead us');
+Object.keys(current).forEach(function(name) {
+  var now = current[name];
+  var before = base[name];
+  if (!before) {
+    console.log(pad(name, 24) + pad('-', 12) + pad((now.meanNs / 1e3).toFixed(1), 12) + 'new');
+    return;
+  }
+
+  // p50 is steadier than the mean when the machine is busy
+  var change = (now.p50Ns - before.p50Ns) / before.p50Ns * 100;
+  var slower = change > threshold;
+  if (slower) {
+    regressions++;
+  }
+
+  console.log(pad(name, 24) +
+      pad((before.p50Ns / 1e3).toFixed(1), 12) +
+      pad((now.p50Ns / 1e3).toFixed(1), 12) +
+      pad((change > 0 ? '+' : '') + change.toFixed(1) + '%', 10) +
+      us(before.overheadNs) + ' -> ' + us(now.overheadNs) +
+      (slower ? '  SLOWER' : ''));
+});
+
+process.exit(regressions ? 1 : 0);
@@ -0,0 +1,215 @@
+// Benchmarks the OpenCV calls behind the hot Matrix methods, without the
+// binding, so `make bench` can show how much of a JS call is OpenCV's own time.
+//
+// Run from the repository root: make bench-native
+// Set BENCH_FILES to read the images from somewhere other than examples/files.
+
+#include <benchmark/benchmark.h>
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/objdetect/objdetect.hpp>
+#if CV_MAJOR_VERSION >= 3
+#include <opencv2/imgcodecs.hpp>
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static std::string FilePath(const std::string &name) {
+  const char *dir = getenv("BENCH_FILES");
+  return std::string(dir ? dir : "examples/files") + "/" + name;
+}
+
+static cv::Mat LoadImage(const std::string &name) {
+  cv::Mat mat = cv::imread(FilePath(name));
+  if (mat.empty()) {
+    throw std::runtime_error("Could not read " + FilePath(name));
+  }
+  return mat;
+}
+
+static std::vector<uchar> LoadFile(const std::string &name) {
+  std::ifstream in(FilePath(name).c_str(), std::ios::binary);
+  return std::vector<uchar>(std::istreambuf_iterator<char>(in),
+      std::istreambuf_iterator<char>());
+}
+
+static void SetBytes(benchmark::State &state, const cv::Mat &mat) {
+  state.SetBytesProcessed(state.iterations() * (mat.dataend - mat.datastart));
+}
+
+// readImage(path)
+static void BM_imread(benchmark::State &state) {
+  std::string path = FilePath("mona.png");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cv::imread(path));
+  }
+}
+BENCHMARK(BM_imread)->Unit(benchmark::kMillisecond);
+
+// readImage(buffer)
+static void BM_imdecode(benchmark::State &state) {
+  std::vector<uchar> data = LoadFile("car1.jpg");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cv::imdecode(data, cv::IMREAD_COLOR));
+  }
+  state.SetBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_imdecode)->Unit(benchmark::kMillisecond);
+
+// toBuffer({ext})
+static void BM_imencode(benchmark::State &state, const char *ext) {
+  cv::Mat mat = LoadImage("mona.png");
+  std::vector<uchar> out;
+  for (auto _ : state) {
+    cv::imencode(ext, mat, out);
+  }
+  SetBytes(state, mat);
+}
+BENCHMARK_CAPTURE(BM_imencode, jpg, ".jpg")->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_imencode, png, ".png")->Unit(benchmark::kMillisecond);
+
+// getData(), a copy of every byte into a new Buffer
+static void BM_getData(benchmark::State &state) {
+  cv::Mat mat = LoadImage("mona.png");
+  size_t size = mat.dataend - mat.datastart;
+  std::vector<uchar> out(size);
+  for (auto _ : state) {
+    memcpy(&out[0], mat.data, size);
+    benchmark::ClobberMemory();
+  }
+  SetBytes(state, mat);
+}
+BENCHMARK(BM_getData);
+
+// pixel(y, x)
+static void BM_pixel(benchmark::State &state) {
+  cv::Mat mat = LoadImage("mona.png");
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(mat.at<cv::Vec3b>(i % mat.rows, i % mat.cols));
+    i++;
+  }
+}
+BENCHMARK(BM_pixel);
+
+// pixelRow(y)
+static void BM_pixelRow(benchmark::State &state) {
+  cv::Mat mat = LoadImage("mona.png");
+  std::vector<double> row(mat.cols * 3);
+  int y = 0;
+  for (auto _ : state) {
+    for (int x = 0; x < mat.cols; x++) {
+      cv::Vec3b pixel = mat.at<cv::Vec3b>(y, x);
+      row[x * 3] = pixel[0];
+      row[x * 3 + 1] = pixel[1];
+      row[x * 3 + 2] = pixel[2];
+    }
+    benchmark::ClobberMemory();
+    y = (y + 1) % mat.rows;
+  }
+}
+BENCHMARK(BM_pixelRow);
+
+// pixelCol(x)
+static void BM_pixelCol(benchmark::State &state) {
+  cv::Mat mat = LoadImage("mona.png");
+  std::vector<double> col(mat.rows * 3);
+  int x = 0;
+  for (auto _ : state) {
+    for (int y = 0; y < mat.rows; y++) {
+      cv::Vec3b pixel = mat.at<cv::Vec3b>(y, x);
+      col[y * 3] = pixel[0];
+      col[y * 3 + 1] = pixel[1];
+      col[y * 3 + 2] = pixel[2];
+    }
+    benchmark::ClobberMemory();
+    x = (x + 1) % mat.cols;
+  }
+}
+BENCHMARK(BM_pixelCol);
+
+static void BM_resize(benchmark::State &state) {
+  cv::Mat mat = LoadImage("mona.png");
+  cv::Mat out;
+  for (auto _ : state) {
+    cv::resize(mat, out, cv::Size(mat.cols / 2, mat.rows / 2));
+  }
+  SetBytes(state, mat);
+}
+BENCHMARK(BM_resize)->Unit(benchmark::kMicrosecond);
+
+static void BM_cvtColor(benchmark::State &state, int code) {
+  cv::Mat mat = LoadImage("mona.png");
+  cv::Mat out;
+  for (auto _ : state) {
+    cv::cvtColor(mat, out, code);
+  }
+  SetBytes(state, mat);
+}
+BENCHMARK_CAPTURE(BM_cvtColor, gray, CV_BGR2GRAY)->Unit(benchmark::kMicrosecond);
+BENCHMARK_CAPTURE(BM_cvtColor, hsv, CV_BGR2HSV)->Unit(benchmark::kMicrosecond);
+
+static void BM_gaussianBlur(benchmark::State &state) {
+  cv::Mat mat = LoadImage("mona.png");
+  cv::Mat out;
+  for (auto _ : state) {
+    cv::GaussianBlur(mat, out, cv::Size(5, 5), 0);
+  }
+  SetBytes(state, mat);
+}
+BENCHMARK(BM_gaussianBlur)->Unit(benchmark::kMicrosecond);
+
+// findContours on a Canny edge map, as in examples/contours.js
+static void BM_findContours(benchmark::State &state) {
+  cv::Mat gray, edges;
+  cv::cvtColor(LoadImage("shapes.jpg"), gray, CV_BGR2GRAY);
+  cv::Canny(gray, edges, 0, 100);
+  for (auto _ : state) {
+    cv::Mat work = edges.clone();
+    std::vector<std::vector<cv::Point> > contours;
+    cv::findContours(work, contours, CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE);
+    benchmark::DoNotOptimize(contours.data());
+  }
+}
+BENCHMARK(BM_findContours)->Unit(benchmark::kMicrosecond);
+
+// detectMultiScale with the binding's defaults
+static void BM_detectMultiScale(benchmark::State &state) {
+  const char *dir = getenv("BENCH_DATA");
+  cv::CascadeClassifier classifier(std::string(dir ? dir : "data") +
+      "/haarcascade_frontalface_alt.xml");
+  if (classifier.empty()) {
+    state.SkipWithError("Could not load the cascade");
+    return;
+  }
+
+  cv::Mat gray;
+  cv::cvtColor(LoadImage("mona.png"), gray, CV_BGR2GRAY);
+  cv::equalizeHist(gray, gray);
+  for (auto _ : state) {
+    std::vector<cv::Rect> objects;
+    classifier.detectMultiScale(gray, objects, 1.1, 2, CV_HAAR_SCALE_IMAGE,
+        cv::Size(30, 30));
+    benchmark::DoNotOptimize(objects.data());
+  }
+}
+BENCHMARK(BM_detectMultiScale)->Unit(benchmark::kMillisecond);
+
+static void BM_matchTemplate(benchmark::State &state) {
+  cv::Mat image = LoadImage("car1.jpg");
+  cv::Mat templ = LoadImage("car1_template.jpg");
+  cv::Mat out;
+  for (auto _ : state) {
+    cv::matchTemplate(image, templ, out, CV_TM_CCORR_NORMED);
+  }
+}
+BENCHMARK(BM_matchTemplate)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
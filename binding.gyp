@@ -6,6 +6,8 @@
       "sources": [
         "src/init.cc",
         "src/Matrix.cc",
+        "src/MatrixOp.cc",
+        "src/Pipeline.cc",
         "src/OpenCV.cc",
         "src/CascadeClassifierWrap.cc",
         "src/Contours.cc",
@@ -22,6 +24,13 @@
         "src/Constants.cc",
         "src/Calib3D.cc",
         "src/ImgProc.cc",
+        "src/MatPool.cc",
+        "src/Profiler.cc",
+        "src/VideoCaptureGroup.cc",
+        "src/VideoWriterWrap.cc",
+        "src/MjpegProducer.cc",
+        "src/ImageDecoder.cc",
+        "src/ImageHeader.cc",
         "src/Stereo.cc",
         "src/LDAWrap.cc"
       ],
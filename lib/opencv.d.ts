@@ -1,6 +1,6 @@
 declare module 'opencv' {
     import 'node';
-    import { Stream } from 'stream';
+    import { Stream, Readable, ReadableOptions, Writable, WritableOptions } from 'stream';
 
     export type Point2F = {
         x: number;
@@ -38,6 +38,10 @@ declare module 'opencv' {
 
     export type ContourHierarchy = [number, number, number, number];
     export type SerializedContours = { contours: Point2F[][], hierarchy: ContourHierarchy[] };
+    /** contours: x, y per point; offsets: first point of each contour, plus the total; hierarchy: 4 per contour */
+    export type TypedSerializedContours = { contours: Int32Array, offsets: Int32Array, hierarchy: Int32Array };
+    export type TypedOutputOption = { typed: true };
+    export type PixelArray = Uint8Array | Uint8ClampedArray | Int8Array | Uint16Array | Int16Array | Int32Array | Float32Array | Float64Array;
 
     export type MatrixType = number;
     export type BorderType = number;
@@ -89,12 +93,26 @@ declare module 'opencv' {
         scale?: number;
         neighbors?: number;
         min?: ArraySize;
+        typed?: boolean;
     };
 
     export type MatrixToBufferOptions = {
-        ext: string;
-        jpegQuality: number;
-        pngCompression: number;
+        ext?: string;
+        jpegQuality?: number;
+        pngCompression?: number;
+    };
+
+    export type MatrixToBufferMaxBytesOptions = MatrixToBufferOptions & {
+        maxBytes: number;
+        buffer?: Buffer;
+    };
+
+    export type MatrixToBufferIntoOptions = MatrixToBufferOptions & {
+        buffer: Buffer;
+    };
+
+    export type MatrixRendition = MatrixToBufferOptions & {
+        maxWidth?: number;
     };
 
     export type MatrixEllipseOptions = {
@@ -141,6 +159,35 @@ declare module 'opencv' {
 
     export const version: string;
 
+    export type ReadImageOptions = {
+        mode?: "color" | "grayscale" | "unchanged" | number;
+        maxDim?: number;
+        reduce?: 1 | 2 | 4 | 8;
+        crop?: RectLike;
+    }
+
+    export type ReadImagesResult = {
+        path: string;
+        index: number;
+        image?: Matrix;
+        error?: Error;
+    }
+
+    export type ImageProbe = {
+        format: "jpeg" | "png" | "gif" | "bmp" | "webp" | "tiff";
+        width: number;
+        height: number;
+        channels: number;
+        depth: number;
+    }
+
+    export function probeImage(src: string | Buffer): ImageProbe;
+    export function probeImage(paths: string[]): Array<ImageProbe | { error: string }>;
+    export function probeImage(src: string | Buffer, callback: (err: Error, probe: ImageProbe) => void): void;
+    export function probeImage(paths: string[], callback: (err: Error, probes: Array<ImageProbe | { error: string }>) => void): void;
+    export function readImage(src: string | Buffer, opts: ReadImageOptions): Promise<Matrix>;
+    export function readImage(src: string | Buffer, opts: ReadImageOptions, callback: (err: Error, image: Matrix) => void): void;
+    export function readImages(paths: string[], opts?: ReadImageOptions & { concurrency?: number }): AsyncIterableIterator<ReadImagesResult>;
     export function readImage(buffer: Buffer): Promise<Matrix>;
     export function readImage(filename: string): Promise<Matrix>;
     export function readImage(buffer: Buffer, callback: (err: Error, image: Matrix) => void): void;
@@ -195,6 +242,7 @@ declare module 'opencv' {
         export function Zeros(width: number, height: number, type?: MatrixType): Matrix;
         export function Ones(width: number, height: number, type?: MatrixType): Matrix;
         export function Eye(width: number, height: number, type?: MatrixType): Matrix;
+        export function fromBuffer(buf: Buffer, rows: number, cols: number, type: MatrixType, step?: number): Matrix;
         export function getRotationMatrix2D(angle: number, x: number, y: number, scale?: number): Matrix;
     }
 
@@ -220,6 +268,14 @@ declare module 'opencv' {
         norm(type: NormalizationType, mask: Matrix): number;
         norm(src2: Matrix, type: NormalizationType, mask: Matrix): number;
         getData(): Buffer;
+        /** Shares the pixels with the matrix; throws unless it is continuous (not a ROI). */
+        getDataView(): Buffer;
+        readRegion<T extends PixelArray = PixelArray>(rect: RectLike, out?: T): T;
+        writeRegion(rect: RectLike, data: PixelArray): Matrix;
+        readRow<T extends PixelArray = PixelArray>(y: number, out?: T): T;
+        readCol<T extends PixelArray = PixelArray>(x: number, out?: T): T;
+        writeRow(y: number, data: PixelArray): Matrix;
+        writeCol(x: number, data: PixelArray): Matrix;
         pixel(x: number, y: number): ArrayColor | number;
         pixel(x: number, y: number, color?: ArrayColor | [number]): ArrayColor | [number];
         width(): number;
@@ -227,9 +283,16 @@ declare module 'opencv' {
         size(): Size;
         clone(): Matrix;
         crop(x: number, y: number, width: number, height: number): Matrix;
+        toBuffer(opt: MatrixToBufferIntoOptions): number;
         toBuffer(opt?: MatrixToBufferOptions): Buffer;
+        toBuffer(callback: (err: Error, length: number) => void, opt: MatrixToBufferIntoOptions): void;
         toBuffer(callback: (err: Error, buf: Buffer) => void, opt?: MatrixToBufferOptions): void;
+        toBuffer(callback: (err: Error, result: Buffer | number, quality: number) => void, opt: MatrixToBufferMaxBytesOptions): void;
+        toBufferAsync(callback: (err: Error, result: Buffer | number, quality: number) => void, opt: MatrixToBufferMaxBytesOptions): void;
+        toBufferAsync(callback: (err: Error, length: number) => void, opt: MatrixToBufferIntoOptions): void;
         toBufferAsync(callback: (err: Error, buf: Buffer) => void, opt?: MatrixToBufferOptions): void;
+        encodeRenditions(renditions: MatrixRendition[]): Promise<Buffer[]>;
+        encodeRenditions(renditions: MatrixRendition[], callback: (err: Error, bufs: Buffer[]) => void): void;
         ellipse(opts: MatrixEllipseOptions): void;
         ellipse(x: number, y: number, width: number, height: number, color?: ArrayColor, thickness?: number): void;
         rectangle(topLeft: ArraySize, widthHeight: ArrayPoint, color?: ArrayColor, thickness?: number): void;
@@ -239,22 +302,34 @@ declare module 'opencv' {
         save(filename: string, callback: (err: Error, result: number) => void): void;
         saveAsync(filename: string, callback: (err: Error, result: number) => void): void;
         resize(size: SizeLike, fx?: number, fy?: number, interpolation?: InterpolationMode): Matrix;
+        resize(size: SizeLike, dst: Matrix): Matrix;
         rotate(angle: number, x: number, y: number): void;
+        rotate(angle: number, dst: Matrix): Matrix;
+        rotate(angle: number, x: number, y: number, dst: Matrix): Matrix;
         warpAffine(rotation: Matrix, dstRows: number, dstCols: number): void;
+        warpAffine(rotation: Matrix, dst: Matrix): Matrix;
+        warpAffine(rotation: Matrix, dstRows: number, dstCols: number, dst: Matrix): Matrix;
         copyTo(dst: Matrix, dstX: number, dstY: number): void;
         convertTo(dst: Matrix, type: MatrixType, scale?: number, delta?: number): void;
         pyrDown(): void;
+        pyrDown(dst: Matrix): Matrix;
         pyrUp(): void;
+        pyrUp(dst: Matrix): Matrix;
         channels(): number;
         convertGrayscale(): void;
         convertHSVscale(): void;
         gaussianBlur(ksize: ArraySize): void;
+        gaussianBlur(ksize: ArraySize, sigma: number, dst: Matrix): Matrix;
+        gaussianBlur(ksize: ArraySize, dst: Matrix): Matrix;
         medianBlur(ksize: number): void;
+        medianBlur(ksize: number, dst: Matrix): Matrix;
         bilateralFilter(): void;
         bilateralFilter(diameter: number, maxSigmaColor: number, sigmaSpace: number, borderType?: BorderType): void;
+        bilateralFilter(diameter: number, maxSigmaColor: number, sigmaSpace: number, dst: Matrix): Matrix;
         sobel(ddepth: number, xorder: number, yorder: number, ksize?: number, scale?: number, delta?: number, borderType?: BorderType): Matrix;
         copy(): Matrix;
         flip(flipCode: 0 | 1 | -1): Matrix;
+        flip(flipCode: 0 | 1 | -1, dst: Matrix): Matrix;
         roi(rect: RectLike): Matrix;
         roi(point: PointLike, size: SizeLike): Matrix;
         roi(point1: PointLike, point2: PointLike): Matrix;
@@ -268,32 +343,47 @@ declare module 'opencv' {
         countNonZero(): number;
         moments(): Moments;
         canny(low: number, high: number): void;
+        canny(low: number, high: number, dst: Matrix): Matrix;
         dilate(iterations: number, kernel?: Matrix): void;
+        dilate(iterations: number, kernel: Matrix | null, dst: Matrix): Matrix;
         erode(iterations: number, kernel?: Matrix): void;
+        erode(iterations: number, kernel: Matrix | null, dst: Matrix): Matrix;
         findContours(mode?: number, chain?: number): Contours;
         drawContour(contours: Contours, pos: number, color?: ArrayColor, thickness?: number);
         drawAllContours(contours: Contours, color?: ArrayColor, thickness?: number);
-        goodFeaturesToTrack(): ArrayPoint[];
+        goodFeaturesToTrack(maxCorners?: number, qualityLevel?: number, minDistance?: number): ArrayPoint[];
+        /** x, y per corner */
+        goodFeaturesToTrack(maxCorners: number, qualityLevel: number, minDistance: number, opts: TypedOutputOption): Float32Array;
+        goodFeaturesToTrack(opts: TypedOutputOption): Float32Array;
         houghLinesP(rho?: number, theta?: number, threshold?: number, minLineLength?: number, maxLineGap?: number): HoughLine[];
+        /** x1, y1, x2, y2 per line */
+        houghLinesP(rho: number, theta: number, threshold: number, minLineLength: number, maxLineGap: number, opts: TypedOutputOption): Int32Array;
+        houghLinesP(opts: TypedOutputOption): Int32Array;
         houghCircles(dp?: number, minDist?: number, higherThreshold?: number, accumulatorThreshold?: number, minRadius?: number, maxRadius?: number): HoughCircle[];
         inRange(low: ArrayColor, high: ArrayColor): void;
         adjustROI(dtop: number, dbottom: number, dleft: number, dright: number): number;
         locateROI(): ArrayRect;
         threshold(threshold: number, maxVal: number, type?: "Binary" | "Binary Inverted" | "Threshold Truncated" | "Threshold to Zero" | "Threshold to Zero Inverted", algorithm?: "Simple" | "Otsu"): Matrix;
+        threshold(threshold: number, maxVal: number, dst: Matrix): Matrix;
         adaptiveThreshold(maxVal: number, adaptiveMethod: AdaptiveThresholdMethod, thresholdType: ThresholdType, blockSize: number, C: number);
         meanStdDev(): { mean: Matrix, stddev: Matrix };
         cvtColor(code: "CV_BGR2GRAY" | "CV_GRAY2BGR" | "CV_BGR2XYZ" | "CV_XYZ2BGR" | "CV_BGR2YCrCb" | "CV_YCrCb2BGR" | "CV_BGR2HSV" | "CV_HSV2BGR" | "CV_BGR2HLS" | "CV_HLS2BGR" | "CV_BGR2Lab" | "CV_Lab2BGR" | "CV_BGR2Luv" | "CV_Luv2BGR" | "CV_BayerBG2BGR" | "CV_BayerGB2BGR" | "CV_BayerRG2BGR" | "CV_BayerGR2BGR" | "CV_BGR2RGB"): void;
+        cvtColor(code: string, dst: Matrix): Matrix;
         split(): Matrix[];
         merge(channels: Matrix[]): void;
         equalizeHist(): void;
         floodFill(opt: { seedPoint: ArrayPoint, newColor: ArrayColor, rect: [ArrayPoint, ArraySize], loDiff: ArrayColor, upDiff: ArrayColor }): number;
         matchTemplate(templ: Matrix, method: TemplateMatchMode, mask?: Matrix): Matrix;
         templateMatches(minProbability?: number, maxProbability?: number, limit?: number, ascending?: boolean, minXDistance?: number, minYDistance?: number): Array<Point2F & { probability: number }>;
+        /** x, y, probability per match */
+        templateMatches(minProbability: number, maxProbability: number, limit: number, ascending: boolean, minXDistance: number, minYDistance: number, opts: TypedOutputOption): Float32Array;
+        templateMatches(opts: TypedOutputOption): Float32Array;
         minMaxLoc(): { minVal: number, maxVal: number, minLoc: Point, maxLoc: Point };
         pushBack(mat: Matrix);
         putText(text: string, x: number, y: number, font?: "HERSEY_SIMPLEX" | "HERSEY_PLAIN" | "HERSEY_DUPLEX" | "HERSEY_COMPLEX" | "HERSEY_TRIPLEX" | "HERSEY_COMPLEX_SMALL" | "HERSEY_SCRIPT_SIMPLEX" | "HERSEY_SCRIPT_COMPLEX" | "HERSEY_SCRIPT_SIMPLEX", color?: ArrayColor, scale?: number, thickness?: number);
         getPerspectiveTransform(srcCorners: Point2F[], targetCorners: Point2F[]): Matrix;
         warpPerspective(M: Matrix, width: number, height: number, color?: ArrayColor): void;
+        warpPerspective(M: Matrix, width: number, height: number, color: ArrayColor | undefined, dst: Matrix): Matrix;
         copyWithMask(dst: Matrix, mask: Matrix): void;
         setWithMask(value: ArrayColor, mask: Matrix): void;
         meanWithMask(mask: Matrix): Scalar;
@@ -303,12 +393,82 @@ declare module 'opencv' {
         release(): void;
         subtract(src2: Matrix): void;
 
+        // Thread pool variants. Each returns a Promise unless a callback is passed last.
+        convertGrayscaleAsync(): Promise<Matrix>;
+        convertHSVscaleAsync(): Promise<Matrix>;
+        cvtColorAsync(code: string): Promise<Matrix>;
+        brightnessAsync(diff: number): Promise<Matrix>;
+        brightnessAsync(alpha: number, beta: number): Promise<Matrix>;
+        gaussianBlurAsync(ksize?: ArraySize, sigma?: number): Promise<Matrix>;
+        gaussianBlurAsync(ksize: ArraySize, callback: (err: Error, im: Matrix) => void): void;
+        medianBlurAsync(ksize: number): Promise<Matrix>;
+        bilateralFilterAsync(diameter?: number, maxSigmaColor?: number, sigmaSpace?: number, borderType?: BorderType): Promise<Matrix>;
+        cannyAsync(low: number, high: number): Promise<Matrix>;
+        dilateAsync(iterations: number, kernel?: Matrix): Promise<Matrix>;
+        erodeAsync(iterations: number, kernel?: Matrix): Promise<Matrix>;
+        equalizeHistAsync(): Promise<Matrix>;
+        pyrDownAsync(): Promise<Matrix>;
+        pyrUpAsync(): Promise<Matrix>;
+        rotateAsync(angle: number, x?: number, y?: number): Promise<Matrix>;
+        warpAffineAsync(rotation: Matrix, dstRows?: number, dstCols?: number): Promise<Matrix>;
+        warpPerspectiveAsync(M: Matrix, width: number, height: number, color?: ArrayColor): Promise<Matrix>;
+        inRangeAsync(low: ArrayColor, high: ArrayColor): Promise<Matrix>;
+        resizeAsync(size: SizeLike, fx?: number, fy?: number, interpolation?: InterpolationMode): Promise<Matrix>;
+        resizeAsync(size: SizeLike, callback: (err: Error, im: Matrix) => void): void;
+        flipAsync(flipCode: 0 | 1 | -1): Promise<Matrix>;
+        sobelAsync(ddepth: number, xorder: number, yorder: number, ksize?: number, scale?: number, delta?: number, borderType?: BorderType): Promise<Matrix>;
+        adaptiveThresholdAsync(maxVal: number, adaptiveMethod: AdaptiveThresholdMethod, thresholdType: ThresholdType, blockSize: number, C: number): Promise<Matrix>;
+        matchTemplateAsync(templ: Matrix, method: TemplateMatchMode, mask?: Matrix): Promise<Matrix>;
+        findContoursAsync(mode?: number, chain?: number): Promise<Contours>;
+        findContoursAsync(callback: (err: Error, contours: Contours) => void): void;
+        houghLinesPAsync(rho?: number, theta?: number, threshold?: number, minLineLength?: number, maxLineGap?: number): Promise<HoughLine[]>;
+        houghCirclesAsync(dp?: number, minDist?: number, higherThreshold?: number, accumulatorThreshold?: number, minRadius?: number, maxRadius?: number): Promise<HoughCircle[]>;
+
         detectObject(classifier: string, opts: CascadeClassifierOptions, callback: (err: Error, objects: RectLike[]) => void);
     }
 
+    export class Pipeline {
+        static operations: string[];
+        constructor();
+        add(name: string, ...args: any[]): Pipeline;
+        size(): number;
+        clear(): Pipeline;
+        run(im: Matrix): Promise<any>;
+        run(im: Matrix, callback: (err: Error, result: any) => void): void;
+
+        convertGrayscale(): Pipeline;
+        convertHSVscale(): Pipeline;
+        cvtColor(code: string): Pipeline;
+        gaussianBlur(ksize?: ArraySize, sigma?: number): Pipeline;
+        medianBlur(ksize: number): Pipeline;
+        bilateralFilter(diameter?: number, maxSigmaColor?: number, sigmaSpace?: number, borderType?: BorderType): Pipeline;
+        canny(low: number, high: number): Pipeline;
+        dilate(iterations: number, kernel?: Matrix): Pipeline;
+        erode(iterations: number, kernel?: Matrix): Pipeline;
+        equalizeHist(): Pipeline;
+        pyrDown(): Pipeline;
+        pyrUp(): Pipeline;
+        rotate(angle: number, x?: number, y?: number): Pipeline;
+        warpAffine(rotation: Matrix, dstRows?: number, dstCols?: number): Pipeline;
+        warpPerspective(M: Matrix, width: number, height: number, color?: ArrayColor): Pipeline;
+        inRange(low: ArrayColor, high: ArrayColor): Pipeline;
+        resize(size: SizeLike, fx?: number, fy?: number, interpolation?: InterpolationMode): Pipeline;
+        flip(flipCode: 0 | 1 | -1): Pipeline;
+        sobel(ddepth: number, xorder: number, yorder: number, ksize?: number, scale?: number, delta?: number, borderType?: BorderType): Pipeline;
+        adaptiveThreshold(maxVal: number, adaptiveMethod: AdaptiveThresholdMethod, thresholdType: ThresholdType, blockSize: number, C: number): Pipeline;
+        matchTemplate(templ: Matrix, method: TemplateMatchMode, mask?: Matrix): Pipeline;
+        findContours(mode?: number, chain?: number): Pipeline;
+        houghLinesP(rho?: number, theta?: number, threshold?: number, minLineLength?: number, maxLineGap?: number): Pipeline;
+        houghCircles(dp?: number, minDist?: number, higherThreshold?: number, accumulatorThreshold?: number, minRadius?: number, maxRadius?: number): Pipeline;
+    }
+
     export class CascadeClassifier {
         constructor(filename: string);
         detectMultiScale(image: Matrix, callback: (err: Error, objects: RectLike[]) => void, scale?: number, neighbors?: number, minWidth?: number, minHeight?: number);
+        /** x, y, width, height per rect */
+        detectMultiScale(image: Matrix, callback: (err: Error, objects: Int32Array) => void, scale: number, neighbors: number, minWidth: number, minHeight: number, opts: TypedOutputOption);
+        detectMultiScaleBatch(images: Matrix[], opts?: CascadeClassifierOptions): Promise<{ rects: Int32Array, offsets: Int32Array }>;
+        detectMultiScaleBatch(images: Matrix[], opts: CascadeClassifierOptions, callback: (err: Error, result: { rects: Int32Array, offsets: Int32Array }) => void): void;
     }
 
     export class VideoCapture {
@@ -324,7 +484,49 @@ declare module 'opencv' {
         ReadSync(): Matrix;
         grab(callback: (err: Error, image: Matrix) => void): void;
         retrieve(callback: (err: Error, image: Matrix) => void, channel: number): void;
+        startGrabbing(opts?: { size?: number, policy?: "dropOldest" | "block" }): void;
+        stopGrabbing(): void;
+        grabberStats(): { running: boolean, size: number, depth: number, grabbed: number, dropped: number };
         toStream(): VideoStream;
+        toMjpeg(opts?: MjpegProducerOptions): MjpegProducer;
+    }
+
+    export type MjpegProducerOptions = {
+        quality?: number;
+        minQuality?: number;
+        maxWidth?: number;
+        boundary?: string;
+    };
+
+    export class MjpegProducer {
+        constructor(capture: VideoCapture, opts?: MjpegProducerOptions);
+        /** The callback returns true when a subscriber could not take the chunk */
+        start(callback: (err: Error, chunk: Buffer | null) => boolean | void): void;
+        stop(): void;
+        setActive(active: boolean): void;
+        boundary(): string;
+        contentType(): string;
+        subscribe(opts?: ReadableOptions): MjpegStream;
+        stats(): { encoded: number, delivered: number, dropped: number, quality: number };
+    }
+
+    export class VideoWriter {
+        constructor(filename: string, fourcc: string | number, fps: number, size: SizeLike, opts?: { isColor?: boolean, queueSize?: number });
+        write(image: Matrix, callback?: (err: Error) => void): boolean;
+        release(callback?: (err: Error) => void): void;
+        isOpened(): boolean;
+        stats(): { queued: number, written: number, queueSize: number };
+        toStream(opts?: WritableOptions): VideoWriterStream;
+    }
+
+    export class VideoCaptureGroup {
+        constructor(captures: VideoCapture[]);
+        read(callback: (err: Error, frames: Matrix[], timestamps: number[]) => void): void;
+        start(callback: (err: Error, frames: Matrix[], timestamps: number[]) => void, opts?: { policy?: "dropOldest" | "block" }): void;
+        /** Returns at once; the callback runs once the loop thread has stopped */
+        stop(callback?: () => void): void;
+        size(): number;
+        stats(): { running: boolean, ticks: number, dropped: number, skewMs: number };
     }
 
     export class Contours {
@@ -343,7 +545,8 @@ declare module 'opencv' {
         moments(pos: number): { m00: number, m10: number, m01: number, m11: number };
         hierarchy(pos: number): ContourHierarchy;
         serialize(): SerializedContours;
-        deserialize(serialized: SerializedContours): void;
+        serialize(opts: TypedOutputOption): TypedSerializedContours;
+        deserialize(serialized: SerializedContours | TypedSerializedContours): void;
     }
 
     export class TrackedObject {
@@ -454,10 +657,36 @@ declare module 'opencv' {
     export namespace imgproc {
         export function undistort(image: Matrix, K: Matrix, distortion: Matrix): Matrix;
         export function initUndistortRectifyMap(K: Matrix, distortion: Matrix, R: Matrix, newK: Matrix, imageSize: ArraySize, m1type: MatrixType): { map1: Matrix, map2: Matrix };
-        export function remap(image: Matrix, map1: Matrix, map2: Matrix, interpolation: InterpolationMode): Matrix;
+        export function remap(image: Matrix, map1: Matrix, map2: Matrix, interpolation: InterpolationMode, dst?: Matrix): Matrix;
         export function getStructuringElement(shape: MorphShape, ksize: ArraySize): Matrix;
     }
 
+    export namespace matPool {
+        export function enable(opts?: { maxBytes?: number }): void;
+        export function disable(): void;
+        export function stats(): { supported: boolean, enabled: boolean, maxBytes?: number, pooledBytes?: number, pooledBuffers?: number, hits?: number, misses?: number };
+    }
+
+    export interface OperationStats {
+        calls: number;
+        totalMs: number;
+        minMs: number;
+        maxMs: number;
+        p50Ms: number;
+        p99Ms: number;
+        bytes: number;
+        queueMs: number;
+    }
+
+    export function stats(): { [operation: string]: OperationStats };
+
+    export namespace profiler {
+        export function enable(): void;
+        export function disable(): void;
+        export function reset(): void;
+        export function stats(): { [operation: string]: OperationStats };
+    }
+
     abstract class Stereo {
         compute(left: Matrix, right: Matrix, type?: MatrixType): Matrix;
     }
@@ -523,8 +752,17 @@ declare module 'opencv' {
         on(event: "data", listener: (image: Matrix) => void): this;
     }
 
+    export class ImageDecoder {
+        constructor(expectedLength?: number);
+        push(buf: Buffer): number;
+        decode(callback: (err: Error, im: Matrix) => void): void;
+        length(): number;
+    }
+
     export class ImageDataStream extends Stream {
         writable: boolean;
+        decoder: ImageDecoder;
+        constructor(opts?: { length?: number });
         write(buf: Buffer): void;
         end(buf?: Buffer): void;
 
@@ -556,6 +794,16 @@ declare module 'opencv' {
         on(event: "end", listener: () => void): this;
     }
 
+    export class VideoWriterStream extends Writable {
+        writer: VideoWriter;
+        constructor(writer: VideoWriter, opts?: WritableOptions);
+    }
+
+    export class MjpegStream extends Readable {
+        producer: MjpegProducer;
+        constructor(producer: MjpegProducer, opts?: ReadableOptions);
+    }
+
     export const FACE_CASCADE: string;
     export const EYE_CASCADE: string;
     export const EYEGLASSES_CASCADE: string;
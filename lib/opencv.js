@@ -1,5 +1,6 @@
 var Stream = require('stream').Stream
-  , Buffers = require('buffers')
+  , Readable = require('stream').Readable
+  , Writable = require('stream').Writable
   , util = require('util')
   , path = require('path');
 
@@ -11,7 +12,9 @@ var Matrix = cv.Matrix
   , ImageStream
   , ImageDataStream
   , ObjectDetectionStream
-  , VideoStream;
+  , VideoStream
+  , VideoWriterStream
+  , MjpegStream;
 
 Matrix.prototype.detectObject = function(classifier, opts, cb) {
   var face_cascade;
@@ -24,7 +27,92 @@ Matrix.prototype.detectObject = function(classifier, opts, cb) {
   }
 
   face_cascade.detectMultiScale(this, cb, opts.scale, opts.neighbors
-    , opts.min && opts.min[0], opts.min && opts.min[1]);
+    , opts.min && opts.min[0], opts.min && opts.min[1], {typed: !!opts.typed});
+};
+
+
+// Chainable shortcuts, pipeline.gaussianBlur([5, 5]) is
+// pipeline.add('gaussianBlur', [5, 5])
+cv.Pipeline.operations.forEach(function(name) {
+  cv.Pipeline.prototype[name] = function() {
+    return this.add.apply(this, [name].concat(Array.prototype.slice.call(arguments)));
+  };
+});
+
+
+// Typed array rows and columns, see readRegion/writeRegion
+Matrix.prototype.readRow = function(y, out) {
+  return this.readRegion({x: 0, y: y, width: this.width(), height: 1}, out);
+};
+
+Matrix.prototype.readCol = function(x, out) {
+  return this.readRegion({x: x, y: 0, width: 1, height: this.height()}, out);
+};
+
+Matrix.prototype.writeRow = function(y, data) {
+  return this.writeRegion({x: 0, y: y, width: this.width(), height: 1}, data);
+};
+
+Matrix.prototype.writeCol = function(x, data) {
+  return this.writeRegion({x: x, y: 0, width: 1, height: this.height()}, data);
+};
+
+
+// Reads many images on the thread pool, at most opts.concurrency at a time, and
+// returns an async iterator of {path, index, image} in the order of paths. An
+// image that cannot be read comes back as {path, index, error}. The other
+// options are passed on to readImage. Reads never run more than `concurrency`
+// images ahead of the consumer, so memory stays bounded however many paths
+// there are.
+cv.readImages = function(paths, opts) {
+  opts = opts || {};
+  var concurrency = Math.max(1, opts.concurrency || 4);
+  var readOpts = {};
+  Object.keys(opts).forEach(function(k) {
+    if (k !== 'concurrency') readOpts[k] = opts[k];
+  });
+
+  var started = 0;
+  var inFlight = [];
+
+  function read(index) {
+    var path = paths[index];
+    return cv.readImage(path, readOpts).then(function(image) {
+      return {path: path, index: index, image: image};
+    }, function(err) {
+      return {path: path, index: index, error: err};
+    });
+  }
+
+  function fill() {
+    while (inFlight.length < concurrency && started < paths.length) {
+      inFlight.push(read(started++));
+    }
+  }
+
+  var iterator = {
+    // The next read only starts when the consumer comes back for another
+    // image, so with the one it holds there are never more than
+    // `concurrency` images alive
+    next: function() {
+      fill();
+      if (!inFlight.length) {
+        return Promise.resolve({done: true, value: undefined});
+      }
+      return inFlight.shift().then(function(result) {
+        return {done: false, value: result};
+      });
+    },
+
+    // Called on break, stops starting new reads
+    return: function() {
+      started = paths.length;
+      inFlight = [];
+      return Promise.resolve({done: true, value: undefined});
+    }
+  };
+  iterator[Symbol.asyncIterator] = function() { return this; };
+  return iterator;
 };
 
 
@@ -52,25 +140,26 @@ ImageStream.prototype.write = function(buf){
 }
 
 
-ImageDataStream = cv.ImageDataStream = function(){
-  this.data = Buffers([]);
+// Chunks are copied straight into a native buffer as they arrive, see
+// cv.ImageDecoder. opts.length, when known, sizes that buffer up front.
+ImageDataStream = cv.ImageDataStream = function(opts){
+  this.decoder = new cv.ImageDecoder(opts && opts.length);
   this.writable = true;
 }
 util.inherits(ImageDataStream, Stream);
 
 
 ImageDataStream.prototype.write = function(buf){
-  this.data.push(buf);
+  this.decoder.push(buf);
   return true;
 }
 
 
 ImageDataStream.prototype.end = function(b){
   var self = this;
-  if (b) ImageStream.prototype.write.call(this, b);
+  if (b) this.write(b);
 
-  var buf = this.data.toBuffer();
-  cv.readImage(buf, function(err, im){
+  this.decoder.decode(function(err, im){
     if (err) return self.emit('error', err);
     self.emit('load', im);
   });
@@ -139,6 +228,137 @@ VideoCapture.prototype.toStream = function(){
 }
 
 
+// A Writable of Matrix frames. The writer's queue provides the backpressure:
+// a frame is only acknowledged once the queue has room for the next one.
+VideoWriterStream = cv.VideoWriterStream = function(writer, opts){
+  Writable.call(this, Object.assign({highWaterMark: 1}, opts, {objectMode: true}));
+  this.writer = writer;
+}
+util.inherits(VideoWriterStream, Writable);
+
+
+VideoWriterStream.prototype._write = function(mat, enc, done){
+  try {
+    if (this.writer.write(mat, done)) process.nextTick(done);
+  } catch (err) {
+    done(err);
+  }
+}
+
+
+VideoWriterStream.prototype._final = function(done){
+  this.writer.release(done);
+}
+
+
+cv.VideoWriter.prototype.toStream = function(opts){
+  return new VideoWriterStream(this, opts);
+}
+
+
+// A Readable of multipart/x-mixed-replace chunks from a cv.MjpegProducer,
+// to pipe into an HTTP response. It holds at most one chunk: while the
+// consumer is behind, chunks are skipped for this subscriber only.
+MjpegStream = cv.MjpegStream = function(producer, opts){
+  Readable.call(this, opts);
+  this.producer = producer;
+  this.wanting = false;
+}
+util.inherits(MjpegStream, Readable);
+
+
+MjpegStream.prototype._read = function(){
+  this.wanting = true;
+}
+
+
+// A destination that closes, usually a client going away, ends the
+// subscription, as pipe() alone would leave it in place
+MjpegStream.prototype.pipe = function(dest, opts){
+  var self = this;
+  dest.once('close', function(){
+    self.destroy();
+  });
+  return Readable.prototype.pipe.call(this, dest, opts);
+}
+
+
+MjpegStream.prototype._destroy = function(err, done){
+  this.producer._unsubscribe(this);
+  done(err);
+}
+
+
+// Starts the producer with the first subscriber. Every subscriber is sent
+// the same Buffer for a frame, so a frame is encoded once however many
+// there are, and encoding pauses while there are none.
+cv.MjpegProducer.prototype.subscribe = function(opts){
+  var self = this;
+  var stream = new MjpegStream(this, opts);
+
+  if (this._ended) {
+    stream.push(null);
+    return stream;
+  }
+  if (!this._subscribers) {
+    this._subscribers = [];
+    this.start(function(err, chunk){
+      return self._deliver(err, chunk);
+    });
+  }
+
+  this._subscribers.push(stream);
+  this.setActive(true);
+  return stream;
+}
+
+
+cv.MjpegProducer.prototype._unsubscribe = function(stream){
+  var subscribers = this._subscribers || [];
+  var i = subscribers.indexOf(stream);
+  if (i < 0) return;
+  subscribers.splice(i, 1);
+  if (!subscribers.length && !this._ended) this.setActive(false);
+}
+
+
+// Returns true, which lowers the quality, when a subscriber was not ready
+cv.MjpegProducer.prototype._deliver = function(err, chunk){
+  var subscribers = this._subscribers.slice();
+
+  if (!chunk) {
+    this._ended = true;
+    this._subscribers = [];
+    subscribers.forEach(function(stream){
+      if (err) stream.destroy(err);
+      else stream.push(null);
+    });
+    return false;
+  }
+
+  var congested = false;
+  subscribers.forEach(function(stream){
+    if (!stream.wanting) {
+      congested = true;
+      return;
+    }
+    stream.wanting = false;
+    stream.push(chunk);
+  });
+  return congested;
+}
+
+
+cv.MjpegProducer.prototype.contentType = function(){
+  return 'multipart/x-mixed-replace; boundary=' + this.boundary();
+}
+
+
+VideoCapture.prototype.toMjpeg = function(opts){
+  return new cv.MjpegProducer(this, opts);
+}
+
+
 
 // Provide cascade data for faces etc.
 var CASCADES = {
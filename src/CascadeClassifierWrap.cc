@@ -1,6 +1,8 @@
 #include "CascadeClassifierWrap.h"
 #include "OpenCV.h"
 #include "Matrix.h"
+#include "TypedArrays.h"
+#include "Profiler.h"
 #include <nan.h>
 
 Nan::Persistent<FunctionTemplate> CascadeClassifierWrap::constructor;
@@ -17,6 +19,7 @@ void CascadeClassifierWrap::Init(Local<Object> target) {
   // Local<ObjectTemplate> proto = constructor->PrototypeTemplate();
 
   Nan::SetPrototypeMethod(ctor, "detectMultiScale", DetectMultiScale);
+  Nan::SetPrototypeMethod(ctor, "detectMultiScaleBatch", DetectMultiScaleBatch);
 
   target->Set(Nan::New("CascadeClassifier").ToLocalChecked(), ctor->GetFunction());
 }
@@ -34,31 +37,83 @@ NAN_METHOD(CascadeClassifierWrap::New) {
 }
 
 CascadeClassifierWrap::CascadeClassifierWrap(v8::Value* fileName) {
-  std::string filename;
   filename = std::string(*Nan::Utf8String(fileName->ToString()));
 
   if (!cc.load(filename.c_str())) {
     Nan::ThrowTypeError("Error loading file");
+    return;
   }
+
+  idle.push_back(&cc);
+}
+
+CascadeClassifierWrap::~CascadeClassifierWrap() {
+  for (size_t i = 0; i < clones.size(); i++) {
+    delete clones[i];
+  }
+}
+
+cv::CascadeClassifier *CascadeClassifierWrap::Acquire() {
+  std::lock_guard<std::mutex> lock(poolMutex);
+
+  if (!idle.empty()) {
+    cv::CascadeClassifier *classifier = idle.back();
+    idle.pop_back();
+    return classifier;
+  }
+
+  if (!storage.isOpened()) {
+    storage.open(filename, cv::FileStorage::READ);
+  }
+
+  cv::CascadeClassifier *classifier = new cv::CascadeClassifier();
+  // read() only understands the new cascade format, the old Haar format
+  // has to be loaded from the file again
+  if (!(storage.isOpened() && classifier->read(storage.getFirstTopLevelNode()))
+      && !classifier->load(filename)) {
+    delete classifier;
+    throw "Error loading file";
+  }
+
+  clones.push_back(classifier);
+  return classifier;
+}
+
+void CascadeClassifierWrap::Release(cv::CascadeClassifier *classifier) {
+  std::lock_guard<std::mutex> lock(poolMutex);
+  idle.push_back(classifier);
 }
 
 class AsyncDetectMultiScale: public Nan::AsyncWorker {
 public:
   AsyncDetectMultiScale(Nan::Callback *callback, CascadeClassifierWrap *cc,
-      Matrix* im, double scale, int neighbors, int minw, int minh) :
+      Matrix* im, double scale, int neighbors, int minw, int minh, bool typed) :
       Nan::AsyncWorker(callback),
       cc(cc),
       im(im),
       scale(scale),
       neighbors(neighbors),
       minw(minw),
-      minh(minh) {
+      minh(minh),
+      typed(typed),
+      queuedAt(Profiler::Now()) {
+    static int op = Profiler::Register("CascadeClassifier.detectMultiScale:worker");
+    profilerOp = op;
   }
   
   ~AsyncDetectMultiScale() {
   }
 
   void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
+    cv::CascadeClassifier *classifier;
+    try {
+      classifier = this->cc->Acquire();
+    } catch (const char *msg) {
+      SetErrorMessage(msg);
+      return;
+    }
+
     try {
       std::vector < cv::Rect > objects;
 
@@ -70,12 +125,14 @@ public:
       } else {
         gray = this->im->mat;
       }
-      this->cc->cc.detectMultiScale(gray, objects, this->scale, this->neighbors,
+      classifier->detectMultiScale(gray, objects, this->scale, this->neighbors,
           0 | CV_HAAR_SCALE_IMAGE, cv::Size(this->minw, this->minh));
       res = objects;
     } catch (cv::Exception& e) {
       SetErrorMessage(e.what());
     }
+
+    this->cc->Release(classifier);
   }
 
   void HandleOKCallback() {
@@ -83,6 +140,21 @@ public:
     //  this->matrix->Unref();
 
     Local < Value > argv[2];
+
+    if (typed) {
+      // x, y, width, height per rect
+      const int *data = res.empty() ? NULL : &res[0].x;
+      argv[0] = Nan::Null();
+      argv[1] = NewTypedArray<Int32Array>(data, res.size() * 4);
+
+      Nan::TryCatch try_catch;
+      callback->Call(2, argv);
+      if (try_catch.HasCaught()) {
+        Nan::FatalException(try_catch);
+      }
+      return;
+    }
+
     v8::Local < v8::Array > arr = Nan::New < v8::Array > (this->res.size());
 
     for (unsigned int i = 0; i < this->res.size(); i++) {
@@ -111,7 +183,10 @@ private:
   int neighbors;
   int minw;
   int minh;
+  bool typed;
   std::vector<cv::Rect> res;
+  uint64_t queuedAt;
+  int profilerOp;
 };
 
 NAN_METHOD(CascadeClassifierWrap::DetectMultiScale) {
@@ -119,33 +194,274 @@ NAN_METHOD(CascadeClassifierWrap::DetectMultiScale) {
 
   CascadeClassifierWrap *self = Nan::ObjectWrap::Unwrap<CascadeClassifierWrap> (info.This());
 
-  if (info.Length() < 2) {
-    Nan::ThrowTypeError("detectMultiScale takes at least 2 info");
+  int argc;
+  bool typed = TypedOutputRequested(info, argc);
+
+  if (argc < 2) {
+    return Nan::ThrowTypeError("detectMultiScale takes at least 2 info");
   }
 
   Matrix *im = Nan::ObjectWrap::Unwrap < Matrix > (info[0]->ToObject());
   REQ_FUN_ARG(1, cb);
 
   double scale = 1.1;
-  if (info.Length() > 2 && info[2]->IsNumber()) {
+  if (argc > 2 && info[2]->IsNumber()) {
     scale = info[2]->NumberValue();
   }
 
   int neighbors = 2;
-  if (info.Length() > 3 && info[3]->IsInt32()) {
+  if (argc > 3 && info[3]->IsInt32()) {
     neighbors = info[3]->IntegerValue();
   }
 
   int minw = 30;
   int minh = 30;
-  if (info.Length() > 5 && info[4]->IsInt32() && info[5]->IsInt32()) {
+  if (argc > 5 && info[4]->IsInt32() && info[5]->IsInt32()) {
     minw = info[4]->IntegerValue();
     minh = info[5]->IntegerValue();
   }
 
   Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
 
-  Nan::AsyncQueueWorker( new AsyncDetectMultiScale(callback, self, im, scale,
-          neighbors, minw, minh));
+  AsyncDetectMultiScale *worker = new AsyncDetectMultiScale(callback, self, im,
+      scale, neighbors, minw, minh, typed);
+  // Both must outlive the detection
+  worker->SaveToPersistent("classifier", info.This());
+  worker->SaveToPersistent("matrix", info[0]);
+  Nan::AsyncQueueWorker(worker);
   return;
 }
+
+// Detects in images [from, to) of a batch, each on its own pooled classifier
+class DetectMultiScaleBody: public cv::ParallelLoopBody {
+public:
+  DetectMultiScaleBody(CascadeClassifierWrap *cc, const std::vector<cv::Mat> &images,
+      std::vector<std::vector<cv::Rect> > &results, std::string &error,
+      std::mutex &errorMutex, double scale, int neighbors, cv::Size minSize,
+      int profilerOp) :
+      cc(cc),
+      images(images),
+      results(results),
+      error(error),
+      errorMutex(errorMutex),
+      scale(scale),
+      neighbors(neighbors),
+      minSize(minSize),
+      profilerOp(profilerOp) {
+  }
+
+  void operator()(const cv::Range &range) const {
+    cv::CascadeClassifier *classifier;
+    try {
+      classifier = cc->Acquire();
+    } catch (const char *msg) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      error = msg;
+      return;
+    }
+
+    try {
+      cv::Mat gray;
+      for (int i = range.start; i < range.end; i++) {
+        Profiler::Timer timer(profilerOp);
+        if (images[i].channels() != 1) {
+          cvtColor(images[i], gray, CV_BGR2GRAY);
+          equalizeHist(gray, gray);
+        } else {
+          gray = images[i];
+        }
+        classifier->detectMultiScale(gray, results[i], scale, neighbors,
+            0 | CV_HAAR_SCALE_IMAGE, minSize);
+      }
+    } catch (cv::Exception& e) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      error = e.what();
+    }
+
+    cc->Release(classifier);
+  }
+
+private:
+  CascadeClassifierWrap *cc;
+  const std::vector<cv::Mat> &images;
+  std::vector<std::vector<cv::Rect> > &results;
+  std::string &error;
+  std::mutex &errorMutex;
+  double scale;
+  int neighbors;
+  cv::Size minSize;
+  int profilerOp;
+};
+
+class AsyncDetectMultiScaleBatch: public Nan::AsyncWorker {
+public:
+  AsyncDetectMultiScaleBatch(Nan::Callback *callback, CascadeClassifierWrap *cc,
+      const std::vector<cv::Mat> &images, double scale, int neighbors, cv::Size minSize) :
+      Nan::AsyncWorker(callback),
+      cc(cc),
+      images(images),
+      results(images.size()),
+      scale(scale),
+      neighbors(neighbors),
+      minSize(minSize),
+      queuedAt(Profiler::Now()) {
+    static int batchOp = Profiler::Register("CascadeClassifier.detectMultiScaleBatch:worker");
+    static int imageOp = Profiler::Register("CascadeClassifier.detectMultiScaleBatch:image");
+    profilerOp = batchOp;
+    imageProfilerOp = imageOp;
+  }
+
+  void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
+    std::string error;
+    std::mutex errorMutex;
+
+    cv::parallel_for_(cv::Range(0, images.size()), DetectMultiScaleBody(cc,
+        images, results, error, errorMutex, scale, neighbors, minSize,
+        imageProfilerOp));
+
+    if (!error.empty()) {
+      SetErrorMessage(error.c_str());
+      return;
+    }
+
+    // Flatten to x, y, width, height per rect, with image i's rects at
+    // [offsets[i], offsets[i + 1])
+    offsets.push_back(0);
+    for (size_t i = 0; i < results.size(); i++) {
+      for (size_t j = 0; j < results[i].size(); j++) {
+        const cv::Rect &r = results[i][j];
+        rects.push_back(r.x);
+        rects.push_back(r.y);
+        rects.push_back(r.width);
+        rects.push_back(r.height);
+      }
+      offsets.push_back(rects.size() / 4);
+    }
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    Local<Object> result = Nan::New<Object>();
+    result->Set(Nan::New("rects").ToLocalChecked(), NewTypedArray<Int32Array>(rects));
+    result->Set(Nan::New("offsets").ToLocalChecked(), NewTypedArray<Int32Array>(offsets));
+
+    if (callback) {
+      Local<Value> argv[] = {
+        Nan::Null(),
+        result
+      };
+
+      Nan::TryCatch try_catch;
+      callback->Call(2, argv);
+      if (try_catch.HasCaught()) {
+        Nan::FatalException(try_catch);
+      }
+    } else {
+      Local<Promise::Resolver> resolver = GetFromPersistent("resolver").As<Promise::Resolver>();
+      resolver->Resolve(Nan::GetCurrentContext(), result);
+      Isolate::GetCurrent()->RunMicrotasks();
+    }
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+
+    Local<Value> error = Nan::Error(ErrorMessage());
+
+    if (callback) {
+      Local<Value> argv[] = {
+        error
+      };
+
+      Nan::TryCatch try_catch;
+      callback->Call(1, argv);
+      if (try_catch.HasCaught()) {
+        Nan::FatalException(try_catch);
+      }
+    } else {
+      Local<Promise::Resolver> resolver = GetFromPersistent("resolver").As<Promise::Resolver>();
+      resolver->Reject(Nan::GetCurrentContext(), error);
+      Isolate::GetCurrent()->RunMicrotasks();
+    }
+  }
+
+private:
+  CascadeClassifierWrap *cc;
+  std::vector<cv::Mat> images;
+  std::vector<std::vector<cv::Rect> > results;
+  std::vector<int> rects;
+  std::vector<int> offsets;
+  double scale;
+  int neighbors;
+  cv::Size minSize;
+  uint64_t queuedAt;
+  int profilerOp;
+  int imageProfilerOp;
+};
+
+// classifier.detectMultiScaleBatch(matrices, [opts], [callback])
+// Runs detectMultiScale over an array of matrices, spread across OpenCV's
+// threads. opts takes scale, neighbors and min ([width, height]), as
+// detectObject does. Resolves with {rects, offsets}: rects is an Int32Array
+// of x, y, width, height for every detection, and the detections for
+// matrices[i] are rects offsets[i] up to offsets[i + 1].
+NAN_METHOD(CascadeClassifierWrap::DetectMultiScaleBatch) {
+  Nan::HandleScope scope;
+
+  CascadeClassifierWrap *self = Nan::ObjectWrap::Unwrap<CascadeClassifierWrap> (info.This());
+
+  if (info.Length() < 1 || !info[0]->IsArray()) {
+    return Nan::ThrowTypeError("Argument 1 must be an array of Matrix");
+  }
+
+  Local<Array> matrices = info[0].As<Array>();
+  std::vector<cv::Mat> images(matrices->Length());
+  for (unsigned int i = 0; i < matrices->Length(); i++) {
+    Local<Value> m = matrices->Get(i);
+    if (!Matrix::HasInstance(m)) {
+      return Nan::ThrowTypeError("Argument 1 must be an array of Matrix");
+    }
+    images[i] = Nan::ObjectWrap::Unwrap<Matrix>(m->ToObject())->mat;
+  }
+
+  double scale = 1.1;
+  int neighbors = 2;
+  cv::Size minSize(30, 30);
+
+  if (info.Length() > 1 && info[1]->IsObject() && !info[1]->IsFunction()) {
+    Local<Object> opts = info[1]->ToObject();
+    Local<Value> v = opts->Get(Nan::New("scale").ToLocalChecked());
+    if (v->IsNumber()) {
+      scale = v->NumberValue();
+    }
+    v = opts->Get(Nan::New("neighbors").ToLocalChecked());
+    if (v->IsNumber()) {
+      neighbors = v->IntegerValue();
+    }
+    v = opts->Get(Nan::New("min").ToLocalChecked());
+    if (v->IsArray()) {
+      Local<Object> min = v->ToObject();
+      minSize = cv::Size(min->Get(0)->IntegerValue(), min->Get(1)->IntegerValue());
+    }
+  }
+
+  Nan::Callback *callback = nullptr;
+  if (info.Length() > 0 && info[info.Length() - 1]->IsFunction()) {
+    callback = new Nan::Callback(info[info.Length() - 1].As<Function>());
+  }
+
+  AsyncDetectMultiScaleBatch *worker = new AsyncDetectMultiScaleBatch(callback,
+      self, images, scale, neighbors, minSize);
+  worker->SaveToPersistent("classifier", info.This());
+  worker->SaveToPersistent("matrices", matrices);
+
+  if (!callback) {
+    Local<Promise::Resolver> resolver = Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked();
+    worker->SaveToPersistent("resolver", resolver);
+    info.GetReturnValue().Set(resolver->GetPromise());
+  }
+
+  Nan::AsyncQueueWorker(worker);
+}
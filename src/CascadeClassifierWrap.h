@@ -3,20 +3,38 @@
 #include <opencv2/objdetect.hpp>
 #endif
 
+#include <mutex>
+
 class CascadeClassifierWrap: public Nan::ObjectWrap {
 public:
   cv::CascadeClassifier cc;
+  std::string filename;
+
+  // cv::CascadeClassifier keeps per-detection scratch state, so concurrent
+  // detections each need their own instance. Acquire hands out an idle one,
+  // loading a new clone if none is free, and Release puts it back.
+  cv::CascadeClassifier *Acquire();
+  void Release(cv::CascadeClassifier *classifier);
 
   static Nan::Persistent<FunctionTemplate> constructor;
   static void Init(Local<Object> target);
   static NAN_METHOD(New);
 
   CascadeClassifierWrap(v8::Value* fileName);
+  ~CascadeClassifierWrap();
 
   //static Handle<Value> LoadHaarClassifierCascade(const v8::Arguments&);
 
   static NAN_METHOD(DetectMultiScale);
+  static NAN_METHOD(DetectMultiScaleBatch);
 
   static void EIO_DetectMultiScale(uv_work_t *req);
   static int EIO_AfterDetectMultiScale(uv_work_t *req);
+
+private:
+  std::mutex poolMutex;
+  // The parsed cascade, so clones don't go back to the file
+  cv::FileStorage storage;
+  std::vector<cv::CascadeClassifier *> idle;
+  std::vector<cv::CascadeClassifier *> clones;
 };
@@ -78,6 +78,20 @@ void Constants::Init(Local<Object> target) {
   CONST_ENUM(INTER_CUBIC);
   CONST_ENUM(INTER_LANCZOS4);
 
+#if CV_MAJOR_VERSION >= 3
+  CONST_ENUM(IMREAD_UNCHANGED);
+  CONST_ENUM(IMREAD_GRAYSCALE);
+  CONST_ENUM(IMREAD_COLOR);
+  CONST_ENUM(IMREAD_ANYDEPTH);
+  CONST_ENUM(IMREAD_ANYCOLOR);
+  CONST_ENUM(IMREAD_REDUCED_GRAYSCALE_2);
+  CONST_ENUM(IMREAD_REDUCED_COLOR_2);
+  CONST_ENUM(IMREAD_REDUCED_GRAYSCALE_4);
+  CONST_ENUM(IMREAD_REDUCED_COLOR_4);
+  CONST_ENUM(IMREAD_REDUCED_GRAYSCALE_8);
+  CONST_ENUM(IMREAD_REDUCED_COLOR_8);
+#endif
+
   CONST_ENUM(NORM_MINMAX);
   CONST_ENUM(NORM_INF);
   CONST_ENUM(NORM_L1);
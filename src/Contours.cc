@@ -1,5 +1,6 @@
 #include "Contours.h"
 #include "OpenCV.h"
+#include "TypedArrays.h"
 #include <nan.h>
 
 #include <iostream>
@@ -51,7 +52,26 @@ NAN_METHOD(Contour::New) {
 }
 
 Contour::Contour() :
-    Nan::ObjectWrap() {
+    Nan::ObjectWrap(),
+    externalBytes(0) {
+}
+
+Contour::~Contour() {
+  if (externalBytes) {
+    Nan::AdjustExternalMemory(-externalBytes);
+  }
+}
+
+void Contour::SyncExternalMemory() {
+  int64_t bytes = hierarchy.size() * sizeof(cv::Vec4i);
+  for (size_t i = 0; i < contours.size(); i++) {
+    bytes += contours[i].size() * sizeof(cv::Point);
+  }
+
+  if (bytes != externalBytes) {
+    Nan::AdjustExternalMemory(bytes - externalBytes);
+    externalBytes = bytes;
+  }
 }
 
 NAN_METHOD(Contour::Point) {
@@ -142,6 +162,7 @@ NAN_METHOD(Contour::ApproxPolyDP) {
   cv::Mat approxed;
   approxPolyDP(cv::Mat(self->contours[pos]), approxed, epsilon, isClosed);
   approxed.copyTo(self->contours[pos]);
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -157,6 +178,7 @@ NAN_METHOD(Contour::ConvexHull) {
   cv::Mat hull;
   cv::convexHull(cv::Mat(self->contours[pos]), hull, clockwise);
   hull.copyTo(self->contours[pos]);
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -289,11 +311,39 @@ NAN_METHOD(Contour::Hierarchy) {
   info.GetReturnValue().Set(res);
 }
 
+// With {typed: true} the result is {contours, offsets, hierarchy} where
+// contours is an Int32Array of x, y for every point, contour i is points
+// offsets[i] up to offsets[i + 1], and hierarchy is an Int32Array of 4 ints
+// per contour.
 NAN_METHOD(Contour::Serialize) {
   Nan::HandleScope scope;
 
   Contour *self = Nan::ObjectWrap::Unwrap<Contour>(info.This());
 
+  int argc;
+  if (TypedOutputRequested(info, argc)) {
+    std::vector<int> points;
+    std::vector<int> offsets(1, 0);
+    for (size_t i = 0; i < self->contours.size(); i++) {
+      for (size_t j = 0; j < self->contours[i].size(); j++) {
+        points.push_back(self->contours[i][j].x);
+        points.push_back(self->contours[i][j].y);
+      }
+      offsets.push_back(points.size() / 2);
+    }
+
+    const int *hierarchy = self->hierarchy.empty() ? NULL : &self->hierarchy[0][0];
+
+    Local<Object> data = Nan::New<Object>();
+    data->Set(Nan::New<String>("contours").ToLocalChecked(), NewTypedArray<Int32Array>(points));
+    data->Set(Nan::New<String>("offsets").ToLocalChecked(), NewTypedArray<Int32Array>(offsets));
+    data->Set(Nan::New<String>("hierarchy").ToLocalChecked(),
+        NewTypedArray<Int32Array>(hierarchy, self->hierarchy.size() * 4));
+
+    info.GetReturnValue().Set(data);
+    return;
+  }
+
   Local<Array> contours_data = Nan::New<Array>(self->contours.size());
 
   for (std::vector<int>::size_type i = 0; i != self->contours.size(); i++) {
@@ -335,6 +385,37 @@ NAN_METHOD(Contour::Deserialize) {
 
   Local<Object> data = Local<Object>::Cast(info[0]);
 
+  // The typed form written by serialize({typed: true})
+  if (data->Get(Nan::New<String>("contours").ToLocalChecked())->IsInt32Array()) {
+    Nan::TypedArrayContents<int> points(data->Get(Nan::New<String>("contours").ToLocalChecked()));
+    Nan::TypedArrayContents<int> offsets(data->Get(Nan::New<String>("offsets").ToLocalChecked()));
+    Nan::TypedArrayContents<int> hierarchy(data->Get(Nan::New<String>("hierarchy").ToLocalChecked()));
+
+    int count = offsets.length() > 0 ? offsets.length() - 1 : 0;
+    bool valid = (int) hierarchy.length() >= count * 4
+        && (count == 0 || (*offsets)[count] * 2 <= (int) points.length());
+    for (int i = 0; valid && i < count; i++) {
+      valid = (*offsets)[i] >= 0 && (*offsets)[i] <= (*offsets)[i + 1];
+    }
+    if (!valid) {
+      return Nan::ThrowRangeError("Invalid typed contour data");
+    }
+
+    self->contours.assign(count, std::vector<cv::Point>());
+    self->hierarchy.resize(count);
+    for (int i = 0; i < count; i++) {
+      for (int j = (*offsets)[i]; j < (*offsets)[i + 1]; j++) {
+        self->contours[i].push_back(cv::Point((*points)[j * 2], (*points)[j * 2 + 1]));
+      }
+      self->hierarchy[i] = cv::Vec4i((*hierarchy)[i * 4], (*hierarchy)[i * 4 + 1],
+          (*hierarchy)[i * 4 + 2], (*hierarchy)[i * 4 + 3]);
+    }
+    self->SyncExternalMemory();
+
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
   Local<Array> contours_data = Local<Array>::Cast(data->Get(Nan::New<String>("contours").ToLocalChecked()));
   Local<Array> hierarchy_data = Local<Array>::Cast(data->Get(Nan::New<String>("hierarchy").ToLocalChecked()));
 
@@ -370,6 +451,7 @@ NAN_METHOD(Contour::Deserialize) {
 
   self->contours = contours_res;
   self->hierarchy = hierarchy_res;
+  self->SyncExternalMemory();
 
   info.GetReturnValue().Set(Nan::Null());
 }
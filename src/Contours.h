@@ -12,6 +12,11 @@ public:
   static NAN_METHOD(New);
 
   Contour();
+  ~Contour();
+
+  // Bytes of contours and hierarchy last reported to V8
+  int64_t externalBytes;
+  void SyncExternalMemory();
 
   JSFUNC(Point)
   JSFUNC(Points)
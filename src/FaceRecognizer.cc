@@ -3,6 +3,7 @@
 #ifdef HAVE_OPENCV_FACE
 #include "FaceRecognizer.h"
 #include "Matrix.h"
+#include "Profiler.h"
 #include <nan.h>
 
 #if CV_MAJOR_VERSION >= 3
@@ -137,11 +138,60 @@ NAN_METHOD(FaceRecognizerWrap::CreateFisher) {
 }
 
 FaceRecognizerWrap::FaceRecognizerWrap(cv::Ptr<cv::FaceRecognizer> f,
-    int type) {
+    int type) :
+    externalBytes(0) {
   rec = f;
   typ = type;
 }
 
+FaceRecognizerWrap::~FaceRecognizerWrap() {
+  if (externalBytes) {
+    Nan::AdjustExternalMemory(-externalBytes);
+  }
+}
+
+static int64_t matBytes(const cv::Mat &m) {
+  return m.total() * m.elemSize();
+}
+
+static int64_t matBytes(const cv::vector<cv::Mat> &mats) {
+  int64_t bytes = 0;
+  for (size_t i = 0; i < mats.size(); i++) {
+    bytes += matBytes(mats[i]);
+  }
+  return bytes;
+}
+
+// The bulk of a model is its histograms (LBPH) or its eigenvectors and
+// projections (Eigen, Fisher)
+void FaceRecognizerWrap::SyncExternalMemory() {
+  int64_t bytes = 0;
+#if CV_MAJOR_VERSION >= 3
+  cv::face::BasicFaceRecognizer *bfr =
+    dynamic_cast<cv::face::BasicFaceRecognizer*>(rec.get());
+  cv::face::LBPHFaceRecognizer *lbph =
+    dynamic_cast<cv::face::LBPHFaceRecognizer*>(rec.get());
+  if (bfr != NULL) {
+    bytes = matBytes(bfr->getEigenVectors()) + matBytes(bfr->getMean())
+        + matBytes(bfr->getProjections());
+  } else if (lbph != NULL) {
+    bytes = matBytes(lbph->getHistograms());
+  }
+#else
+  if (typ == LBPH) {
+    bytes = matBytes(rec->getMatVector("histograms"));
+  } else {
+    bytes = matBytes(rec->getMat("eigenvectors")) + matBytes(rec->getMat("mean"))
+        + matBytes(rec->getMatVector("projections"));
+  }
+#endif
+
+  if (bytes != externalBytes) {
+    Nan::AdjustExternalMemory(bytes - externalBytes);
+    externalBytes = bytes;
+  }
+}
+
 Local<Value> UnwrapTrainingData(Nan::NAN_METHOD_ARGS_TYPE info,
     cv::vector<cv::Mat>* images, cv::vector<int>* labels) {
 
@@ -192,31 +242,45 @@ NAN_METHOD(FaceRecognizerWrap::TrainSync) {
   }
 
   self->rec->train(images, labels);
+  self->SyncExternalMemory();
 
   return;
 }
 
 class TrainASyncWorker: public Nan::AsyncWorker {
 public:
-  TrainASyncWorker(Nan::Callback *callback, cv::Ptr<cv::FaceRecognizer> rec,
+  TrainASyncWorker(Nan::Callback *callback, FaceRecognizerWrap *wrap,
       cv::vector<cv::Mat> images, cv::vector<int> labels) :
       Nan::AsyncWorker(callback),
-      rec(rec),
+      wrap(wrap),
+      rec(wrap->rec),
       images(images),
-      labels(labels) {
+      labels(labels),
+      queuedAt(Profiler::Now()) {
+    static int op = Profiler::Register("FaceRecognizer.train:worker");
+    profilerOp = op;
   }
 
   ~TrainASyncWorker() {
   }
 
   void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
     this->rec->train(this->images, this->labels);
   }
 
+  void HandleOKCallback() {
+    wrap->SyncExternalMemory();
+    Nan::AsyncWorker::HandleOKCallback();
+  }
+
 private:
+  FaceRecognizerWrap *wrap;
   cv::Ptr<cv::FaceRecognizer> rec;
   cv::vector<cv::Mat> images;
   cv::vector<int> labels;
+  uint64_t queuedAt;
+  int profilerOp;
 };
 
 NAN_METHOD(FaceRecognizerWrap::Train) {
@@ -238,7 +302,9 @@ NAN_METHOD(FaceRecognizerWrap::Train) {
   }
 
   Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
-  Nan::AsyncQueueWorker(new TrainASyncWorker(callback, self->rec, images, labels));
+  TrainASyncWorker *worker = new TrainASyncWorker(callback, self, images, labels);
+  worker->SaveToPersistent("recognizer", info.This());
+  Nan::AsyncQueueWorker(worker);
 
   return;
 }
@@ -262,6 +328,7 @@ NAN_METHOD(FaceRecognizerWrap::UpdateSync) {
   }
 
   self->rec->update(images, labels);
+  self->SyncExternalMemory();
 
   return;
 }
@@ -305,7 +372,10 @@ public:
   PredictASyncWorker(Nan::Callback *callback, cv::Ptr<cv::FaceRecognizer> rec, cv::Mat im) :
       Nan::AsyncWorker(callback),
       rec(rec),
-      im(im) {
+      im(im),
+      queuedAt(Profiler::Now()) {
+    static int op = Profiler::Register("FaceRecognizer.predict:worker");
+    profilerOp = op;
     predictedLabel = -1;
     confidence = 0.0;
   }
@@ -314,6 +384,7 @@ public:
   }
 
   void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
      this->rec->predict(this->im, this->predictedLabel, this->confidence);
 #if CV_MAJOR_VERSION >= 3
     // Older versions of OpenCV3 incorrectly returned label=0 at
@@ -350,6 +421,8 @@ private:
   cv::Mat im;
   int predictedLabel;
   double confidence;
+  uint64_t queuedAt;
+  int profilerOp;
 };
 
 NAN_METHOD(FaceRecognizerWrap::Predict) {
@@ -389,6 +462,7 @@ NAN_METHOD(FaceRecognizerWrap::LoadSync) {
   }
   std::string filename = std::string(*Nan::Utf8String(info[0]->ToString()));
   self->rec->load(filename);
+  self->SyncExternalMemory();
   return;
 }
 
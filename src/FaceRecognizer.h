@@ -21,6 +21,11 @@ public:
   static NAN_METHOD(New);
 
   FaceRecognizerWrap(cv::Ptr<cv::FaceRecognizer> f, int type);
+  ~FaceRecognizerWrap();
+
+  // Approximate size of the trained model last reported to V8
+  int64_t externalBytes;
+  void SyncExternalMemory();
 
   JSFUNC(CreateLBPH)
   JSFUNC(CreateEigen)
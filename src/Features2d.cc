@@ -3,6 +3,7 @@
 #if ((CV_MAJOR_VERSION == 2) && (CV_MINOR_VERSION >=4))
 #include "Features2d.h"
 #include "Matrix.h"
+#include "Profiler.h"
 #include <nan.h>
 #include <stdio.h>
 
@@ -18,13 +19,17 @@ public:
       Nan::AsyncWorker(callback),
       image1(image1),
       image2(image2),
-      dissimilarity(0) {
+      dissimilarity(0),
+      queuedAt(Profiler::Now()) {
+    static int op = Profiler::Register("ImageSimilarity:worker");
+    profilerOp = op;
   }
 
   ~AsyncDetectSimilarity() {
   }
 
   void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
 
     cv::Ptr<cv::FeatureDetector> detector = cv::FeatureDetector::create("ORB");
     cv::Ptr<cv::DescriptorExtractor> extractor =
@@ -95,6 +100,8 @@ private:
   cv::Mat image1;
   cv::Mat image2;
   double dissimilarity;
+  uint64_t queuedAt;
+  int profilerOp;
 };
 
 NAN_METHOD(Features::Similarity) {
@@ -0,0 +1,169 @@
+#include "ImageDecoder.h"
+#include "Matrix.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <exception>
+
+Nan::Persistent<FunctionTemplate> ImageDecoder::constructor;
+
+// expectedLength often comes from a client's Content-Length, so it only
+// reserves up to this much; a longer image still grows the buffer as it comes
+static const double kMaxReserve = 64 * 1024 * 1024;
+
+void ImageDecoder::Init(Local<Object> target) {
+  Nan::HandleScope scope;
+
+  Local<FunctionTemplate> ctor = Nan::New<FunctionTemplate>(ImageDecoder::New);
+  constructor.Reset(ctor);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("ImageDecoder").ToLocalChecked());
+
+  Nan::SetPrototypeMethod(ctor, "push", Push);
+  Nan::SetPrototypeMethod(ctor, "decode", Decode);
+  Nan::SetPrototypeMethod(ctor, "length", Length);
+
+  target->Set(Nan::New("ImageDecoder").ToLocalChecked(), ctor->GetFunction());
+}
+
+// new cv.ImageDecoder([expectedLength])
+// expectedLength, such as a Content-Length, reserves the buffer up front so it
+// never has to grow. It is a hint, capped at kMaxReserve.
+NAN_METHOD(ImageDecoder::New) {
+  Nan::HandleScope scope;
+
+  if (info.This()->InternalFieldCount() == 0) {
+    return Nan::ThrowTypeError("Cannot Instantiate without new");
+  }
+
+  double expectedLength = 0;
+  DOUBLE_FROM_ARGS(expectedLength, 0)
+  if (!(expectedLength >= 0)) {
+    return Nan::ThrowTypeError("expectedLength must not be negative");
+  }
+
+  ImageDecoder *decoder;
+  try {
+    decoder = new ImageDecoder((size_t) std::min(expectedLength, kMaxReserve));
+  } catch (std::exception &e) {
+    return Nan::ThrowError("Could not allocate the ImageDecoder buffer");
+  }
+  decoder->Wrap(info.This());
+
+  info.GetReturnValue().Set(info.This());
+}
+
+ImageDecoder::ImageDecoder(size_t expectedLength) :
+    length(0),
+    decoding(false) {
+  data.reserve(expectedLength);
+}
+
+// decoder.push(buffer), returns the number of bytes pushed so far
+NAN_METHOD(ImageDecoder::Push) {
+  SETUP_FUNCTION(ImageDecoder)
+
+  if (info.Length() < 1 || !Buffer::HasInstance(info[0])) {
+    return Nan::ThrowTypeError("Argument 1 must be a Buffer");
+  }
+  if (self->decoding) {
+    return Nan::ThrowError("Cannot push after decode()");
+  }
+
+  Local<Object> buf = info[0]->ToObject();
+  uchar *chunk = (uchar *)Buffer::Data(buf);
+  try {
+    self->data.insert(self->data.end(), chunk, chunk + Buffer::Length(buf));
+  } catch (std::exception &e) {
+    return Nan::ThrowError("Could not grow the ImageDecoder buffer");
+  }
+  self->length = self->data.size();
+
+  info.GetReturnValue().Set(Nan::New<Number>(self->length));
+}
+
+class AsyncDecodeWorker: public Nan::AsyncWorker {
+public:
+  AsyncDecodeWorker(Nan::Callback *callback, ImageDecoder *decoder) :
+      Nan::AsyncWorker(callback),
+      decoder(decoder),
+      queuedAt(Profiler::Now()) {
+    static int op = Profiler::Register("ImageDecoder.decode:worker");
+    profilerOp = op;
+  }
+
+  void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
+    std::vector<uchar> &data = decoder->data;
+    timer.bytes = data.size();
+
+    if (data.empty()) {
+      SetErrorMessage("No image data was pushed");
+      return;
+    }
+
+    try {
+      // A header over the collected bytes, imdecode reads them in place
+      cv::Mat buf(1, data.size(), CV_8UC1, &data[0]);
+      mat = cv::imdecode(buf, cv::IMREAD_COLOR);
+    } catch (cv::Exception &e) {
+      SetErrorMessage(e.what());
+    }
+
+    // The encoded image is no longer needed
+    std::vector<uchar>().swap(data);
+
+    if (mat.empty() && !ErrorMessage()) {
+      SetErrorMessage("Could not decode the image");
+    }
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    Local<Object> im = Matrix::NewInstance();
+    Nan::ObjectWrap::Unwrap<Matrix>(im)->mat = mat;
+
+    Local<Value> argv[] = {
+      Nan::Null(),
+      im
+    };
+
+    Nan::TryCatch try_catch;
+    callback->Call(2, argv);
+    if (try_catch.HasCaught()) {
+      Nan::FatalException(try_catch);
+    }
+  }
+
+private:
+  ImageDecoder *decoder;
+  cv::Mat mat;
+  uint64_t queuedAt;
+  int profilerOp;
+};
+
+// decoder.decode(function(err, im) {})
+// Decodes everything pushed so far on the thread pool, then frees it. A
+// decoder can only be decoded once.
+NAN_METHOD(ImageDecoder::Decode) {
+  SETUP_FUNCTION(ImageDecoder)
+
+  REQ_FUN_ARG(0, cb);
+
+  if (self->decoding) {
+    return Nan::ThrowError("ImageDecoder has already been decoded");
+  }
+  self->decoding = true;
+
+  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
+  AsyncDecodeWorker *worker = new AsyncDecodeWorker(callback, self);
+  worker->SaveToPersistent("decoder", info.This());
+  Nan::AsyncQueueWorker(worker);
+}
+
+NAN_METHOD(ImageDecoder::Length) {
+  SETUP_FUNCTION(ImageDecoder)
+
+  info.GetReturnValue().Set(Nan::New<Number>(self->length));
+}
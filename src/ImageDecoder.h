@@ -0,0 +1,32 @@
+#ifndef __NODE_IMAGEDECODER_H
+#define __NODE_IMAGEDECODER_H
+
+#include "OpenCV.h"
+
+/**
+ * cv.ImageDecoder, collects an encoded image chunk by chunk into a single
+ * native buffer, which imdecode then reads in place.
+ *
+ * Each chunk is copied once as it arrives, so there is no concatenation step
+ * at the end and only one copy of the encoded image is held at any time.
+ */
+class ImageDecoder: public Nan::ObjectWrap {
+public:
+  static Nan::Persistent<FunctionTemplate> constructor;
+  static void Init(Local<Object> target);
+  static NAN_METHOD(New);
+
+  ImageDecoder(size_t expectedLength);
+
+  static NAN_METHOD(Push);
+  static NAN_METHOD(Decode);
+  static NAN_METHOD(Length);
+
+  std::vector<uchar> data;
+  // Bytes pushed, as data is freed by the worker once decoded
+  size_t length;
+  // Set once decode() has been called, after which data belongs to the worker
+  bool decoding;
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "ImageHeader.h"
+
+#include <cstdlib>
+#include <fstream>
+
+namespace {
+
+// Where the header bytes come from, so a file is only read where needed
+class Source {
+public:
+  virtual ~Source() {}
+  // Copies n bytes at offset into out, or returns false if there are not
+  // that many
+  virtual bool Read(uint64_t offset, uchar *out, size_t n) = 0;
+};
+
+class MemorySource: public Source {
+public:
+  MemorySource(const uchar *data, size_t length) : data(data), length(length) {}
+
+  bool Read(uint64_t offset, uchar *out, size_t n) {
+    if (offset > length || n > length - offset) {
+      return false;
+    }
+    memcpy(out, data + offset, n);
+    return true;
+  }
+
+private:
+  const uchar *data;
+  size_t length;
+};
+
+class FileSource: public Source {
+public:
+  FileSource(const std::string &path) : in(path.c_str(), std::ios::binary) {}
+
+  bool IsOpen() {
+    return in.is_open();
+  }
+
+  bool Read(uint64_t offset, uchar *out, size_t n) {
+    in.clear();
+    in.seekg(offset);
+    in.read(reinterpret_cast<char *>(out), n);
+    return (size_t)in.gcount() == n;
+  }
+
+private:
+  std::ifstream in;
+};
+
+}  // namespace
+
+static int BE16(const uchar *p) {
+  return p[0] << 8 | p[1];
+}
+
+static uint32_t BE32(const uchar *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static int LE16(const uchar *p) {
+  return p[0] | p[1] << 8;
+}
+
+static uint32_t LE32(const uchar *p) {
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void Need(Source &src, uint64_t offset, uchar *out, size_t n) {
+  if (!src.Read(offset, out, n)) {
+    throw "Truncated image header";
+  }
+}
+
+static void ReadPng(Source &src, ImageHeader &header) {
+  // Signature, then the IHDR chunk: length, type, width, height, bit depth,
+  // color type
+  uchar b[26];
+  Need(src, 0, b, sizeof(b));
+  if (memcmp(b + 12, "IHDR", 4)) {
+    throw "Invalid PNG header";
+  }
+
+  header.format = "png";
+  header.width = BE32(b + 16);
+  header.height = BE32(b + 20);
+  header.depth = b[24] == 16 ? CV_16U : CV_8U;
+  switch (b[25]) {
+    case 0: header.channels = 1; break;  // gray
+    case 2: header.channels = 3; break;  // RGB
+    case 3: header.channels = 3; break;  // palette
+    case 4: header.channels = 2; break;  // gray and alpha
+    case 6: header.channels = 4; break;  // RGBA
+    default: throw "Invalid PNG header";
+  }
+}
+
+// Walks the segments up to the first frame header (SOFn), seeking past the
+// others, so a large EXIF block costs nothing
+static void ReadJpeg(Source &src, ImageHeader &header) {
+  uint64_t offset = 2;
+  uchar b[6];
+  while (true) {
+    Need(src, offset, b, 2);
+    if (b[0] != 0xFF) {
+      throw "Invalid JPEG header";
+    }
+    int marker = b[1];
+    if (marker == 0xFF) {
+      // Fill byte
+      offset++;
+      continue;
+    }
+    offset += 2;
+
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+      // No length
+      continue;
+    }
+    if (marker == 0xD9 || marker == 0xDA) {
+      // End of image, or image data, before any frame header
+      throw "Invalid JPEG header";
+    }
+
+    Need(src, offset, b, 2);
+    int length = BE16(b);
+    if (length < 2) {
+      throw "Invalid JPEG header";
+    }
+
+    bool frame = marker >= 0xC0 && marker <= 0xCF &&
+        marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+    if (frame) {
+      // Precision, height, width, number of components
+      Need(src, offset + 2, b, 6);
+      header.format = "jpeg";
+      header.depth = b[0] > 8 ? CV_16U : CV_8U;
+      header.height = BE16(b + 1);
+      header.width = BE16(b + 3);
+      header.channels = b[5];
+      return;
+    }
+    offset += length;
+  }
+}
+
+static void ReadGif(Source &src, ImageHeader &header) {
+  uchar b[10];
+  Need(src, 0, b, sizeof(b));
+  if (memcmp(b, "GIF87a", 6) && memcmp(b, "GIF89a", 6)) {
+    throw "Invalid GIF header";
+  }
+
+  header.format = "gif";
+  header.width = LE16(b + 6);
+  header.height = LE16(b + 8);
+  header.channels = 3;
+}
+
+static void ReadBmp(Source &src, ImageHeader &header) {
+  uchar b[30];
+  Need(src, 0, b, 18);
+  uint32_t dibSize = LE32(b + 14);
+
+  int bitCount;
+  if (dibSize == 12) {
+    // OS/2 BITMAPCOREHEADER, 16 bit sizes
+    Need(src, 18, b + 18, 8);
+    header.width = LE16(b + 18);
+    header.height = LE16(b + 20);
+    bitCount = LE16(b + 24);
+  } else if (dibSize >= 40) {
+    // A negative height means the rows are stored top down
+    Need(src, 18, b + 18, 12);
+    header.width = (int32_t)LE32(b + 18);
+    header.height = std::abs((int32_t)LE32(b + 22));
+    bitCount = LE16(b + 28);
+  } else {
+    throw "Invalid BMP header";
+  }
+
+  header.format = "bmp";
+  header.channels = bitCount == 32 ? 4 : 3;
+}
+
+static void ReadWebp(Source &src, ImageHeader &header) {
+  // RIFF header, then the first chunk's type and size
+  uchar b[30];
+  Need(src, 0, b, 21);
+  if (memcmp(b + 8, "WEBP", 4)) {
+    throw "Invalid WebP header";
+  }
+
+  header.format = "webp";
+  if (!memcmp(b + 12, "VP8 ", 4)) {
+    // Lossy: frame tag, start code, then 14 bit width and height
+    Need(src, 21, b + 21, 9);
+    if (b[23] != 0x9d || b[24] != 0x01 || b[25] != 0x2a) {
+      throw "Invalid WebP header";
+    }
+    header.width = LE16(b + 26) & 0x3fff;
+    header.height = LE16(b + 28) & 0x3fff;
+    header.channels = 3;
+  } else if (!memcmp(b + 12, "VP8L", 4)) {
+    // Lossless: signature, then 14 bit width - 1, height - 1 and alpha hint
+    Need(src, 21, b + 21, 4);
+    if (b[20] != 0x2f) {
+      throw "Invalid WebP header";
+    }
+    header.width = 1 + (b[21] | (b[22] & 0x3f) << 8);
+    header.height = 1 + (b[22] >> 6 | b[23] << 2 | (b[24] & 0x0f) << 10);
+    header.channels = (b[24] & 0x10) ? 4 : 3;
+  } else if (!memcmp(b + 12, "VP8X", 4)) {
+    // Extended: flags, then 24 bit width - 1 and height - 1
+    Need(src, 21, b + 21, 9);
+    header.width = 1 + (b[24] | b[25] << 8 | b[26] << 16);
+    header.height = 1 + (b[27] | b[28] << 8 | b[29] << 16);
+    header.channels = (b[20] & 0x10) ? 4 : 3;
+  } else {
+    throw "Invalid WebP header";
+  }
+}
+
+// Reads the tags of the first image file directory, wherever it is
+static void ReadTiff(Source &src, ImageHeader &header) {
+  uchar b[12];
+  Need(src, 0, b, 8);
+  bool little = b[0] == 'I';
+  uint32_t ifd = little ? LE32(b + 4) : BE32(b + 4);
+
+  Need(src, ifd, b, 2);
+  int count = little ? LE16(b) : BE16(b);
+  if (count > 4096) {
+    throw "Invalid TIFF header";
+  }
+
+  int samples = 1;
+  int bits = 1;
+  for (int i = 0; i < count; i++) {
+    Need(src, ifd + 2 + 12 * i, b, 12);
+    int tag = little ? LE16(b) : BE16(b);
+    int type = little ? LE16(b + 2) : BE16(b + 2);
+    uint32_t n = little ? LE32(b + 4) : BE32(b + 4);
+    // SHORT or LONG values that fit in the entry
+    uint32_t value = type == 3 ? (little ? LE16(b + 8) : BE16(b + 8)) :
+        (little ? LE32(b + 8) : BE32(b + 8));
+
+    switch (tag) {
+      case 256: header.width = value; break;
+      case 257: header.height = value; break;
+      case 277: samples = value; break;
+      case 258:
+        if (type == 3 && n > 2) {
+          // One per sample, stored elsewhere when they do not fit
+          uchar s[2];
+          Need(src, value, s, 2);
+          bits = little ? LE16(s) : BE16(s);
+        } else {
+          bits = value;
+        }
+        break;
+    }
+  }
+
+  header.format = "tiff";
+  header.channels = samples;
+  header.depth = bits == 32 ? CV_32F : bits == 16 ? CV_16U : CV_8U;
+}
+
+static void ReadHeader(Source &src, ImageHeader &header) {
+  uchar b[8];
+  if (!src.Read(0, b, sizeof(b))) {
+    throw "Unknown image format";
+  }
+
+  if (b[0] == 0xFF && b[1] == 0xD8) {
+    ReadJpeg(src, header);
+  } else if (!memcmp(b, "\x89PNG\r\n\x1a\n", 8)) {
+    ReadPng(src, header);
+  } else if (!memcmp(b, "GIF8", 4)) {
+    ReadGif(src, header);
+  } else if (b[0] == 'B' && b[1] == 'M') {
+    ReadBmp(src, header);
+  } else if (!memcmp(b, "RIFF", 4)) {
+    ReadWebp(src, header);
+  } else if (!memcmp(b, "II*\0", 4) || !memcmp(b, "MM\0*", 4)) {
+    ReadTiff(src, header);
+  } else {
+    throw "Unknown image format";
+  }
+
+  if (header.width <= 0 || header.height <= 0 || header.channels <= 0) {
+    throw "Invalid image header";
+  }
+}
+
+void ReadImageHeader(const uchar *data, size_t length, ImageHeader &header) {
+  MemorySource src(data, length);
+  ReadHeader(src, header);
+}
+
+void ReadImageHeader(const std::string &path, ImageHeader &header) {
+  FileSource src(path);
+  if (!src.IsOpen()) {
+    throw "Could not open or find the image";
+  }
+  ReadHeader(src, header);
+}
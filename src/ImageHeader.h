@@ -0,0 +1,27 @@
+#ifndef __NODE_IMAGEHEADER_H
+#define __NODE_IMAGEHEADER_H
+
+#include "OpenCV.h"
+
+/**
+ * What an image file's header says about it, read without decoding.
+ *
+ * Covers JPEG, PNG, GIF, BMP, WebP and TIFF. width and height are as stored,
+ * before any EXIF orientation is applied. channels is the number in the file,
+ * so 3 for palette images, and depth is CV_8U, CV_16U or CV_32F.
+ */
+struct ImageHeader {
+  std::string format;
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  int depth = CV_8U;
+};
+
+// Parse the header of an encoded image in memory, or of a file, reading only
+// the bytes the header needs. Both throw a const char* when the data is not
+// an image format listed above, or the header is cut short.
+void ReadImageHeader(const uchar *data, size_t length, ImageHeader &header);
+void ReadImageHeader(const std::string &path, ImageHeader &header);
+
+#endif
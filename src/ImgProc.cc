@@ -172,16 +172,21 @@ NAN_METHOD(ImgProc::Remap) {
 
     // Args 4, 5 border settings, skipping for now
 
-    // Output image
-    cv::Mat outputImage;
+    // Optional destination as the last argument, reused when it fits
+    Local<Object> outMatrixWrap;
+    try {
+      outMatrixWrap = Matrix::DstArgument(info, 4, inputImage);
+    } catch (const char *msg) {
+      return Nan::ThrowTypeError(msg);
+    }
+    if (outMatrixWrap.IsEmpty()) {
+      outMatrixWrap = Matrix::NewInstance();
+    }
+    Matrix *outMatrix = Nan::ObjectWrap::Unwrap<Matrix>(outMatrixWrap);
 
     // Remap
-    cv::remap(inputImage, outputImage, map1, map2, interpolation);
-
-    // Wrap the output image
-    Local<Object> outMatrixWrap = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
-    Matrix *outMatrix = Nan::ObjectWrap::Unwrap<Matrix>(outMatrixWrap);
-    outMatrix->mat = outputImage;
+    cv::remap(inputImage, outMatrix->mat, map1, map2, interpolation);
+    Matrix::MemoryChanged(outMatrix);
 
     // Return the image
     info.GetReturnValue().Set(outMatrixWrap);
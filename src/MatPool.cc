@@ -0,0 +1,196 @@
+#include "MatPool.h"
+
+#if CV_MAJOR_VERSION >= 3
+
+// Mats allocated through the pool keep pointing at it after it is disabled,
+// so it is never destroyed.
+static PooledMatAllocator *pool = new PooledMatAllocator();
+static cv::MatAllocator *previousAllocator = NULL;
+
+PooledMatAllocator::PooledMatAllocator() :
+    enabled(false),
+    maxBytes(0),
+    pooledBytes(0),
+    pooledBuffers(0),
+    hits(0),
+    misses(0) {
+}
+
+// Same layout as OpenCV's own StdMatAllocator
+cv::UMatData *PooledMatAllocator::allocate(int dims, const int *sizes, int type,
+    void *data0, size_t *step, int flags, cv::UMatUsageFlags usageFlags) const {
+  size_t total = CV_ELEM_SIZE(type);
+  for (int i = dims - 1; i >= 0; i--) {
+    if (step) {
+      if (data0 && step[i] != cv::Mat::AUTO_STEP) {
+        CV_Assert(total <= step[i]);
+        total = step[i];
+      } else {
+        step[i] = total;
+      }
+    }
+    total *= sizes[i];
+  }
+
+  uchar *data = (uchar *) data0;
+  if (!data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unordered_map<size_t, std::vector<uchar *> >::iterator it = buckets.find(total);
+    if (it != buckets.end() && !it->second.empty()) {
+      data = it->second.back();
+      it->second.pop_back();
+      pooledBytes -= total;
+      pooledBuffers--;
+      hits++;
+    } else {
+      misses++;
+    }
+  }
+  if (!data) {
+    data = (uchar *) cv::fastMalloc(total);
+  }
+
+  cv::UMatData *u = new cv::UMatData(this);
+  u->data = u->origdata = data;
+  u->size = total;
+  if (data0) {
+    u->flags |= cv::UMatData::USER_ALLOCATED;
+  }
+
+  return u;
+}
+
+bool PooledMatAllocator::allocate(cv::UMatData *u, int accessFlags,
+    cv::UMatUsageFlags usageFlags) const {
+  return u != NULL;
+}
+
+void PooledMatAllocator::deallocate(cv::UMatData *u) const {
+  if (!u) {
+    return;
+  }
+
+  CV_Assert(u->urefcount == 0);
+  CV_Assert(u->refcount == 0);
+
+  if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+    bool pooled = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (enabled && pooledBytes + u->size <= maxBytes) {
+        buckets[u->size].push_back(u->origdata);
+        pooledBytes += u->size;
+        pooledBuffers++;
+        pooled = true;
+      }
+    }
+    if (!pooled) {
+      cv::fastFree(u->origdata);
+    }
+    u->origdata = 0;
+  }
+
+  delete u;
+}
+
+void PooledMatAllocator::SetPooling(bool enabled, size_t maxBytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->enabled = enabled;
+    this->maxBytes = maxBytes;
+  }
+  if (!enabled) {
+    Flush();
+  }
+}
+
+void PooledMatAllocator::Flush() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::unordered_map<size_t, std::vector<uchar *> >::iterator it;
+  for (it = buckets.begin(); it != buckets.end(); ++it) {
+    for (size_t i = 0; i < it->second.size(); i++) {
+      cv::fastFree(it->second[i]);
+    }
+  }
+  buckets.clear();
+  pooledBytes = 0;
+  pooledBuffers = 0;
+}
+
+#endif
+
+void MatPool::Init(Local<Object> target) {
+  Nan::Persistent<Object> inner;
+  Local<Object> obj = Nan::New<Object>();
+  inner.Reset(obj);
+
+  Nan::SetMethod(obj, "enable", Enable);
+  Nan::SetMethod(obj, "disable", Disable);
+  Nan::SetMethod(obj, "stats", Stats);
+
+  target->Set(Nan::New("matPool").ToLocalChecked(), obj);
+}
+
+// cv.matPool.enable([{maxBytes: 256 * 1024 * 1024}])
+// Installs the pooled allocator for every Mat created from now on. maxBytes
+// caps the memory kept in the pool, calling enable again updates it.
+NAN_METHOD(MatPool::Enable) {
+  Nan::HandleScope scope;
+
+#if CV_MAJOR_VERSION >= 3
+  double maxBytes = 256 * 1024 * 1024;
+  if (info.Length() > 0 && info[0]->IsObject()) {
+    Local<Value> v = info[0]->ToObject()->Get(Nan::New("maxBytes").ToLocalChecked());
+    if (v->IsNumber()) {
+      maxBytes = v->NumberValue();
+    }
+  }
+  if (maxBytes < 0) {
+    return Nan::ThrowRangeError("maxBytes must not be negative");
+  }
+
+  pool->SetPooling(true, maxBytes);
+  if (cv::Mat::getDefaultAllocator() != pool) {
+    previousAllocator = cv::Mat::getDefaultAllocator();
+    cv::Mat::setDefaultAllocator(pool);
+  }
+#else
+  return Nan::ThrowError("cv.matPool requires OpenCV 3 or later");
+#endif
+}
+
+// Goes back to OpenCV's allocator and frees the pooled buffers
+NAN_METHOD(MatPool::Disable) {
+  Nan::HandleScope scope;
+
+#if CV_MAJOR_VERSION >= 3
+  if (cv::Mat::getDefaultAllocator() == pool) {
+    cv::Mat::setDefaultAllocator(previousAllocator);
+  }
+  pool->SetPooling(false, 0);
+#endif
+}
+
+// Returns {supported, enabled, maxBytes, pooledBytes, pooledBuffers, hits,
+// misses}, where hits and misses count allocations made while enabled.
+NAN_METHOD(MatPool::Stats) {
+  Nan::HandleScope scope;
+
+  Local<Object> stats = Nan::New<Object>();
+
+#if CV_MAJOR_VERSION >= 3
+  std::lock_guard<std::mutex> lock(pool->mutex);
+  stats->Set(Nan::New("supported").ToLocalChecked(), Nan::True());
+  stats->Set(Nan::New("enabled").ToLocalChecked(), Nan::New<Boolean>(pool->enabled));
+  stats->Set(Nan::New("maxBytes").ToLocalChecked(), Nan::New<Number>(pool->maxBytes));
+  stats->Set(Nan::New("pooledBytes").ToLocalChecked(), Nan::New<Number>(pool->pooledBytes));
+  stats->Set(Nan::New("pooledBuffers").ToLocalChecked(), Nan::New<Number>(pool->pooledBuffers));
+  stats->Set(Nan::New("hits").ToLocalChecked(), Nan::New<Number>(pool->hits));
+  stats->Set(Nan::New("misses").ToLocalChecked(), Nan::New<Number>(pool->misses));
+#else
+  stats->Set(Nan::New("supported").ToLocalChecked(), Nan::False());
+  stats->Set(Nan::New("enabled").ToLocalChecked(), Nan::False());
+#endif
+
+  info.GetReturnValue().Set(stats);
+}
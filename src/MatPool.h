@@ -0,0 +1,51 @@
+#ifndef __NODE_MATPOOL_H
+#define __NODE_MATPOOL_H
+
+#include "OpenCV.h"
+
+#if CV_MAJOR_VERSION >= 3
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * A cv::MatAllocator that keeps freed pixel buffers and hands them out again
+ * for the next allocation of the same byte size, so a video loop that keeps
+ * creating the same frames stops going through malloc/free.
+ */
+class PooledMatAllocator: public cv::MatAllocator {
+public:
+  PooledMatAllocator();
+
+  cv::UMatData *allocate(int dims, const int *sizes, int type, void *data,
+      size_t *step, int flags, cv::UMatUsageFlags usageFlags) const override;
+  bool allocate(cv::UMatData *data, int accessflags,
+      cv::UMatUsageFlags usageFlags) const override;
+  void deallocate(cv::UMatData *data) const override;
+
+  // Buffers are only kept while pooling is enabled, up to maxBytes in total
+  void SetPooling(bool enabled, size_t maxBytes);
+  void Flush() const;
+
+  mutable std::mutex mutex;
+  mutable std::unordered_map<size_t, std::vector<uchar *> > buckets;
+  bool enabled;
+  size_t maxBytes;
+  mutable size_t pooledBytes;
+  mutable size_t pooledBuffers;
+  mutable double hits;
+  mutable double misses;
+};
+#endif
+
+/**
+ * cv.matPool, to switch the pooled allocator on and off
+ */
+class MatPool: public Nan::ObjectWrap {
+public:
+  static void Init(Local<Object> target);
+  static NAN_METHOD(Enable);
+  static NAN_METHOD(Disable);
+  static NAN_METHOD(Stats);
+};
+
+#endif
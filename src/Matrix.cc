@@ -1,11 +1,20 @@
 #include "Contours.h"
 #include "Matrix.h"
+#include "MatrixOp.h"
 #include "Point.h"
 #include "Size.h"
 #include "Rect.h"
 #include "Scalar.h"
+#include "TypedArrays.h"
+#include "Profiler.h"
 #include "OpenCV.h"
 #include <string.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include <nan.h>
 
 Nan::Persistent<FunctionTemplate> Matrix::constructor;
@@ -14,9 +23,63 @@ cv::Scalar setColor(Local<Object> objColor);
 cv::Point setPoint(Local<Object> objPoint);
 cv::Rect* setRect(Local<Object> objRect, cv::Rect &result);
 
+// Matrices whose size may have changed since they were last reported to V8,
+// each at most once thanks to Matrix::syncPending. Cleared without giving
+// back its capacity, so tracking a method call does not allocate
+static std::vector<Matrix *> pendingSync;
+static uv_check_t syncCheck;
+
+// The matrix that reports each pixel buffer to V8, so a buffer shared by
+// several matrices (a roi(), a crop, an alias) is only counted once
+static std::unordered_map<cv::UMatData *, Matrix *> bufferOwners;
+
+// Reports the pending matrices to V8, returning how many bytes they grew by
+static int64_t SyncPending() {
+  int64_t grown = 0;
+  for (size_t i = 0; i < pendingSync.size(); i++) {
+    Matrix *m = pendingSync[i];
+    m->syncPending = false;
+    int64_t delta = m->SyncExternalMemory();
+    if (delta > 0) {
+      grown += delta;
+    }
+  }
+  pendingSync.clear();
+  return grown;
+}
+
+// Reports the matrices created or changed outside of a Matrix method, such
+// as in async callbacks, once per loop iteration
+static void SyncPendingCheck(uv_check_t *handle) {
+  SyncPending();
+}
+
+struct TrackedMethodEntry {
+  Nan::FunctionCallback fn;
+  int profilerOp;
+};
+
+// Registers a prototype method that reports any change in the size of the
+// matrices it touched (this, Matrix arguments and new matrices) to V8 once it
+// returns, and times it for cv.stats(). Accessors that only read the matrix
+// are registered plainly to keep them cheap
+static void SetTrackedMethod(Local<FunctionTemplate> ctor, const char *name,
+    Nan::FunctionCallback fn) {
+  TrackedMethodEntry *entry = new TrackedMethodEntry();
+  entry->fn = fn;
+  entry->profilerOp = Profiler::Register(std::string("Matrix.") + name);
+  Nan::SetPrototypeMethod(ctor, name, Matrix::TrackedMethod,
+      Nan::New<External>(entry));
+}
+
 void Matrix::Init(Local<Object> target) {
   Nan::HandleScope scope;
 
+  pendingSync.reserve(64);
+  uv_check_init(uv_default_loop(), &syncCheck);
+  uv_check_start(&syncCheck, SyncPendingCheck);
+  uv_unref(reinterpret_cast<uv_handle_t *>(&syncCheck));
+
   //Class
   Local<FunctionTemplate> ctor = Nan::New<FunctionTemplate>(Matrix::New);
   constructor.Reset(ctor);
@@ -24,103 +87,112 @@ void Matrix::Init(Local<Object> target) {
   ctor->SetClassName(Nan::New("Matrix").ToLocalChecked());
 
   // Prototype
-  Nan::SetPrototypeMethod(ctor, "setTo", SetTo);
+  SetTrackedMethod(ctor, "setTo", SetTo);
 
-  Nan::SetPrototypeMethod(ctor, "row", Row);
-  Nan::SetPrototypeMethod(ctor, "col", Col);
-  Nan::SetPrototypeMethod(ctor, "pixelRow", PixelRow);
-  Nan::SetPrototypeMethod(ctor, "pixelCol", PixelCol);
+  SetTrackedMethod(ctor, "row", Row);
+  SetTrackedMethod(ctor, "col", Col);
+  SetTrackedMethod(ctor, "pixelRow", PixelRow);
+  SetTrackedMethod(ctor, "pixelCol", PixelCol);
   Nan::SetPrototypeMethod(ctor, "empty", Empty);
   Nan::SetPrototypeMethod(ctor, "get", Get);
-  Nan::SetPrototypeMethod(ctor, "set", Set);
-  Nan::SetPrototypeMethod(ctor, "put", Put);
-  Nan::SetPrototypeMethod(ctor, "brightness", Brightness);
-  Nan::SetPrototypeMethod(ctor, "normalize", Normalize);
-  Nan::SetPrototypeMethod(ctor, "norm", Norm);
-  Nan::SetPrototypeMethod(ctor, "getData", GetData);
+  SetTrackedMethod(ctor, "set", Set);
+  SetTrackedMethod(ctor, "put", Put);
+  SetTrackedMethod(ctor, "brightness", Brightness);
+  SetTrackedMethod(ctor, "normalize", Normalize);
+  SetTrackedMethod(ctor, "norm", Norm);
+  SetTrackedMethod(ctor, "getData", GetData);
+  SetTrackedMethod(ctor, "getDataView", GetDataView);
+  SetTrackedMethod(ctor, "readRegion", ReadRegion);
+  SetTrackedMethod(ctor, "writeRegion", WriteRegion);
   Nan::SetPrototypeMethod(ctor, "pixel", Pixel);
   Nan::SetPrototypeMethod(ctor, "width", Width);
   Nan::SetPrototypeMethod(ctor, "height", Height);
   Nan::SetPrototypeMethod(ctor, "type", Type);
   Nan::SetPrototypeMethod(ctor, "size", Size);
-  Nan::SetPrototypeMethod(ctor, "clone", Clone);
-  Nan::SetPrototypeMethod(ctor, "crop", Crop);
-  Nan::SetPrototypeMethod(ctor, "toBuffer", ToBuffer);
-  Nan::SetPrototypeMethod(ctor, "toBufferAsync", ToBufferAsync);
-  Nan::SetPrototypeMethod(ctor, "ellipse", Ellipse);
-  Nan::SetPrototypeMethod(ctor, "rectangle", Rectangle);
-  Nan::SetPrototypeMethod(ctor, "line", Line);
-  Nan::SetPrototypeMethod(ctor, "fillPoly", FillPoly);
-  Nan::SetPrototypeMethod(ctor, "save", Save);
-  Nan::SetPrototypeMethod(ctor, "saveAsync", SaveAsync);
-  Nan::SetPrototypeMethod(ctor, "resize", Resize);
-  Nan::SetPrototypeMethod(ctor, "rotate", Rotate);
-  Nan::SetPrototypeMethod(ctor, "warpAffine", WarpAffine);
-  Nan::SetPrototypeMethod(ctor, "copyTo", CopyTo);
-  Nan::SetPrototypeMethod(ctor, "convertTo", ConvertTo);
-  Nan::SetPrototypeMethod(ctor, "pyrDown", PyrDown);
-  Nan::SetPrototypeMethod(ctor, "pyrUp", PyrUp);
+  SetTrackedMethod(ctor, "clone", Clone);
+  SetTrackedMethod(ctor, "crop", Crop);
+  SetTrackedMethod(ctor, "toBuffer", ToBuffer);
+  SetTrackedMethod(ctor, "toBufferAsync", ToBufferAsync);
+  SetTrackedMethod(ctor, "encodeRenditions", EncodeRenditions);
+  SetTrackedMethod(ctor, "ellipse", Ellipse);
+  SetTrackedMethod(ctor, "rectangle", Rectangle);
+  SetTrackedMethod(ctor, "line", Line);
+  SetTrackedMethod(ctor, "fillPoly", FillPoly);
+  SetTrackedMethod(ctor, "save", Save);
+  SetTrackedMethod(ctor, "saveAsync", SaveAsync);
+  SetTrackedMethod(ctor, "resize", Resize);
+  SetTrackedMethod(ctor, "rotate", Rotate);
+  SetTrackedMethod(ctor, "warpAffine", WarpAffine);
+  SetTrackedMethod(ctor, "copyTo", CopyTo);
+  SetTrackedMethod(ctor, "convertTo", ConvertTo);
+  SetTrackedMethod(ctor, "pyrDown", PyrDown);
+  SetTrackedMethod(ctor, "pyrUp", PyrUp);
   Nan::SetPrototypeMethod(ctor, "channels", Channels);
-  Nan::SetPrototypeMethod(ctor, "convertGrayscale", ConvertGrayscale);
-  Nan::SetPrototypeMethod(ctor, "convertHSVscale", ConvertHSVscale);
-  Nan::SetPrototypeMethod(ctor, "gaussianBlur", GaussianBlur);
-  Nan::SetPrototypeMethod(ctor, "medianBlur", MedianBlur);
-  Nan::SetPrototypeMethod(ctor, "bilateralFilter", BilateralFilter);
-  Nan::SetPrototypeMethod(ctor, "sobel", Sobel);
-  Nan::SetPrototypeMethod(ctor, "copy", Copy);
-  Nan::SetPrototypeMethod(ctor, "flip", Flip);
-  Nan::SetPrototypeMethod(ctor, "roi", ROI);
-  Nan::SetPrototypeMethod(ctor, "ptr", Ptr);
-  Nan::SetPrototypeMethod(ctor, "absDiff", AbsDiff);
-  Nan::SetPrototypeMethod(ctor, "dct", Dct);
-  Nan::SetPrototypeMethod(ctor, "idct", Idct);
-  Nan::SetPrototypeMethod(ctor, "addWeighted", AddWeighted);
-  Nan::SetPrototypeMethod(ctor, "add", Add);  
-  Nan::SetPrototypeMethod(ctor, "bitwiseXor", BitwiseXor);
-  Nan::SetPrototypeMethod(ctor, "bitwiseNot", BitwiseNot);
-  Nan::SetPrototypeMethod(ctor, "bitwiseAnd", BitwiseAnd);
-  Nan::SetPrototypeMethod(ctor, "countNonZero", CountNonZero);
-  Nan::SetPrototypeMethod(ctor, "moments", Moments);
-  Nan::SetPrototypeMethod(ctor, "canny", Canny);
-  Nan::SetPrototypeMethod(ctor, "dilate", Dilate);
-  Nan::SetPrototypeMethod(ctor, "erode", Erode);
-  Nan::SetPrototypeMethod(ctor, "findContours", FindContours);
-  Nan::SetPrototypeMethod(ctor, "drawContour", DrawContour);
-  Nan::SetPrototypeMethod(ctor, "drawAllContours", DrawAllContours);
-  Nan::SetPrototypeMethod(ctor, "goodFeaturesToTrack", GoodFeaturesToTrack);
-  Nan::SetPrototypeMethod(ctor, "calcOpticalFlowPyrLK", CalcOpticalFlowPyrLK);
-  Nan::SetPrototypeMethod(ctor, "houghLinesP", HoughLinesP);
-  Nan::SetPrototypeMethod(ctor, "houghCircles", HoughCircles);
-  Nan::SetPrototypeMethod(ctor, "inRange", inRange);
-  Nan::SetPrototypeMethod(ctor, "adjustROI", AdjustROI);
-  Nan::SetPrototypeMethod(ctor, "locateROI", LocateROI);
-  Nan::SetPrototypeMethod(ctor, "threshold", Threshold);
-  Nan::SetPrototypeMethod(ctor, "adaptiveThreshold", AdaptiveThreshold);
-  Nan::SetPrototypeMethod(ctor, "meanStdDev", MeanStdDev);
-  Nan::SetPrototypeMethod(ctor, "cvtColor", CvtColor);
-  Nan::SetPrototypeMethod(ctor, "split", Split);
-  Nan::SetPrototypeMethod(ctor, "merge", Merge);
-  Nan::SetPrototypeMethod(ctor, "equalizeHist", EqualizeHist);
-  Nan::SetPrototypeMethod(ctor, "floodFill", FloodFill);
-  Nan::SetPrototypeMethod(ctor, "matchTemplate", MatchTemplate);
-  Nan::SetPrototypeMethod(ctor, "templateMatches", TemplateMatches);
-  Nan::SetPrototypeMethod(ctor, "minMaxLoc", MinMaxLoc);
-  Nan::SetPrototypeMethod(ctor, "pushBack", PushBack);
-  Nan::SetPrototypeMethod(ctor, "putText", PutText);
-  Nan::SetPrototypeMethod(ctor, "getPerspectiveTransform", GetPerspectiveTransform);
-  Nan::SetPrototypeMethod(ctor, "warpPerspective", WarpPerspective);
+  SetTrackedMethod(ctor, "convertGrayscale", ConvertGrayscale);
+  SetTrackedMethod(ctor, "convertHSVscale", ConvertHSVscale);
+  SetTrackedMethod(ctor, "gaussianBlur", GaussianBlur);
+  SetTrackedMethod(ctor, "medianBlur", MedianBlur);
+  SetTrackedMethod(ctor, "bilateralFilter", BilateralFilter);
+  SetTrackedMethod(ctor, "sobel", Sobel);
+  SetTrackedMethod(ctor, "copy", Copy);
+  SetTrackedMethod(ctor, "flip", Flip);
+  SetTrackedMethod(ctor, "roi", ROI);
+  SetTrackedMethod(ctor, "ptr", Ptr);
+  SetTrackedMethod(ctor, "absDiff", AbsDiff);
+  SetTrackedMethod(ctor, "dct", Dct);
+  SetTrackedMethod(ctor, "idct", Idct);
+  SetTrackedMethod(ctor, "addWeighted", AddWeighted);
+  SetTrackedMethod(ctor, "add", Add);  
+  SetTrackedMethod(ctor, "bitwiseXor", BitwiseXor);
+  SetTrackedMethod(ctor, "bitwiseNot", BitwiseNot);
+  SetTrackedMethod(ctor, "bitwiseAnd", BitwiseAnd);
+  SetTrackedMethod(ctor, "countNonZero", CountNonZero);
+  SetTrackedMethod(ctor, "moments", Moments);
+  SetTrackedMethod(ctor, "canny", Canny);
+  SetTrackedMethod(ctor, "dilate", Dilate);
+  SetTrackedMethod(ctor, "erode", Erode);
+  SetTrackedMethod(ctor, "findContours", FindContours);
+  SetTrackedMethod(ctor, "drawContour", DrawContour);
+  SetTrackedMethod(ctor, "drawAllContours", DrawAllContours);
+  SetTrackedMethod(ctor, "goodFeaturesToTrack", GoodFeaturesToTrack);
+  SetTrackedMethod(ctor, "calcOpticalFlowPyrLK", CalcOpticalFlowPyrLK);
+  SetTrackedMethod(ctor, "houghLinesP", HoughLinesP);
+  SetTrackedMethod(ctor, "houghCircles", HoughCircles);
+  SetTrackedMethod(ctor, "inRange", inRange);
+  SetTrackedMethod(ctor, "adjustROI", AdjustROI);
+  SetTrackedMethod(ctor, "locateROI", LocateROI);
+  SetTrackedMethod(ctor, "threshold", Threshold);
+  SetTrackedMethod(ctor, "adaptiveThreshold", AdaptiveThreshold);
+  SetTrackedMethod(ctor, "meanStdDev", MeanStdDev);
+  SetTrackedMethod(ctor, "cvtColor", CvtColor);
+  SetTrackedMethod(ctor, "split", Split);
+  SetTrackedMethod(ctor, "merge", Merge);
+  SetTrackedMethod(ctor, "equalizeHist", EqualizeHist);
+  SetTrackedMethod(ctor, "floodFill", FloodFill);
+  SetTrackedMethod(ctor, "matchTemplate", MatchTemplate);
+  SetTrackedMethod(ctor, "templateMatches", TemplateMatches);
+  SetTrackedMethod(ctor, "minMaxLoc", MinMaxLoc);
+  SetTrackedMethod(ctor, "pushBack", PushBack);
+  SetTrackedMethod(ctor, "putText", PutText);
+  SetTrackedMethod(ctor, "getPerspectiveTransform", GetPerspectiveTransform);
+  SetTrackedMethod(ctor, "warpPerspective", WarpPerspective);
+
+  // Asynchronous variants, e.g. gaussianBlurAsync
+  MatrixOp::Init(ctor);
+
   Nan::SetMethod(ctor, "Zeros", Zeros);
   Nan::SetMethod(ctor, "Ones", Ones);
   Nan::SetMethod(ctor, "Eye", Eye);
+  Nan::SetMethod(ctor, "fromBuffer", FromBuffer);
   Nan::SetMethod(ctor, "getRotationMatrix2D", GetRotationMatrix2D);
-  Nan::SetPrototypeMethod(ctor, "copyWithMask", CopyWithMask);
-  Nan::SetPrototypeMethod(ctor, "mean", Mean);
-  Nan::SetPrototypeMethod(ctor, "shift", Shift);
-  Nan::SetPrototypeMethod(ctor, "reshape", Reshape);
-  Nan::SetPrototypeMethod(ctor, "release", Release);
-  Nan::SetPrototypeMethod(ctor, "subtract", Subtract);
+  SetTrackedMethod(ctor, "copyWithMask", CopyWithMask);
+  SetTrackedMethod(ctor, "mean", Mean);
+  SetTrackedMethod(ctor, "shift", Shift);
+  SetTrackedMethod(ctor, "reshape", Reshape);
+  SetTrackedMethod(ctor, "release", Release);
+  SetTrackedMethod(ctor, "subtract", Subtract);
 
-  Nan::SetPrototypeMethod(ctor, "toString", ToString);
+  SetTrackedMethod(ctor, "toString", ToString);
 
   target->Set(Nan::New("Matrix").ToLocalChecked(), ctor->GetFunction());
 };
@@ -155,9 +227,74 @@ NAN_METHOD(Matrix::New) {
   }
 
   mat->Wrap(info.Holder());
+  // Counted right away so a loop creating matrices is seen by the GC, and
+  // again later for the callers that assign mat after NewInstance()
+  mat->SyncExternalMemory();
+  MemoryChanged(mat);
   info.GetReturnValue().Set(info.Holder());
 }
 
+NAN_METHOD(Matrix::TrackedMethod) {
+  TrackedMethodEntry *entry = static_cast<TrackedMethodEntry *>(info.Data().As<External>()->Value());
+  Profiler::Timer timer(entry->profilerOp);
+  entry->fn(info);
+
+  if (HasInstance(info.This())) {
+    MemoryChanged(Nan::ObjectWrap::Unwrap<Matrix>(info.This()));
+  }
+  for (int i = 0; i < info.Length(); i++) {
+    if (HasInstance(info[i])) {
+      MemoryChanged(Nan::ObjectWrap::Unwrap<Matrix>(info[i]->ToObject()));
+    }
+  }
+
+  timer.bytes = SyncPending();
+}
+
+void Matrix::MemoryChanged(Matrix *m) {
+  if (!m->syncPending) {
+    m->syncPending = true;
+    pendingSync.push_back(m);
+  }
+}
+
+void Matrix::ReleaseCountedData() {
+  if (countedData) {
+    std::unordered_map<cv::UMatData *, Matrix *>::iterator it = bufferOwners.find(countedData);
+    if (it != bufferOwners.end() && it->second == this) {
+      bufferOwners.erase(it);
+    }
+    countedData = NULL;
+  }
+}
+
+int64_t Matrix::SyncExternalMemory() {
+  // Memory owned by a fromBuffer() Buffer or other user memory is already
+  // known to V8 or not ours to report
+  cv::UMatData *u = buffer.IsEmpty() ? mat.u : NULL;
+  if (u && (u->flags & cv::UMatData::USER_ALLOCATED)) {
+    u = NULL;
+  }
+
+  // A buffer already reported by another matrix, such as the parent of a
+  // roi(), counts as 0 here
+  if (u != countedData) {
+    ReleaseCountedData();
+    if (u && bufferOwners.find(u) == bufferOwners.end()) {
+      bufferOwners[u] = this;
+      countedData = u;
+    }
+  }
+  int64_t bytes = countedData ? countedData->size : 0;
+
+  int64_t delta = bytes - externalBytes;
+  if (delta) {
+    Nan::AdjustExternalMemory(delta);
+    externalBytes = bytes;
+  }
+  return delta;
+}
+
 Local<Object> Matrix::NewInstance() {
   return Nan::NewInstance(Nan::GetFunction(Nan::New(constructor)).ToLocalChecked()).ToLocalChecked();
 }
@@ -166,27 +303,103 @@ bool Matrix::HasInstance(Local<Value> object) {
   return Nan::New(constructor)->HasInstance(object);
 }
 
+// Transforms take an optional destination Matrix as their last argument,
+// after at least minArgs others, and write their result into its mat instead
+// of allocating one. OpenCV's create() keeps dst's memory when the size and
+// type already match, so a loop passing the same dst every frame stops
+// allocating. Returns an empty handle when there is no dst, and throws a
+// const char* if dst overlaps src, which most OpenCV functions cannot handle.
+// Whether the pixels of a and b overlap. datastart/dataend span a ROI's
+// whole parent, so the byte ranges actually used are compared, and when
+// those interleave, as for side by side ROIs of one frame, the rectangles.
+static bool SharesPixels(const cv::Mat &a, const cv::Mat &b) {
+  if (a.empty() || b.empty()) {
+    return false;
+  }
+  const uchar *aEnd = a.data + (a.rows - 1) * a.step[0] + a.cols * a.elemSize();
+  const uchar *bEnd = b.data + (b.rows - 1) * b.step[0] + b.cols * b.elemSize();
+  if (a.data >= bEnd || b.data >= aEnd) {
+    return false;
+  }
+  if (a.dims > 2 || b.dims > 2 || a.step[0] != b.step[0]) {
+    return true;
+  }
+
+  // Same row stride, so both are windows on one layout: compare rows and
+  // the bytes used within a row
+  size_t step = a.step[0];
+  const uchar *base = std::min(a.data, b.data);
+  size_t aOffset = a.data - base;
+  size_t bOffset = b.data - base;
+  size_t aRow = aOffset / step, aCol = aOffset % step;
+  size_t bRow = bOffset / step, bCol = bOffset % step;
+  return aRow < bRow + b.rows && bRow < aRow + a.rows &&
+      aCol < bCol + b.cols * b.elemSize() && bCol < aCol + a.cols * a.elemSize();
+}
+
+Local<Object> Matrix::DstArgument(Nan::NAN_METHOD_ARGS_TYPE info, int minArgs,
+    const cv::Mat &src) {
+  int last = info.Length() - 1;
+  if (last < minArgs || !HasInstance(info[last])) {
+    return Local<Object>();
+  }
+
+  Local<Object> dst = info[last]->ToObject();
+  const cv::Mat &mat = Nan::ObjectWrap::Unwrap<Matrix>(dst)->mat;
+  if (SharesPixels(mat, src)) {
+    throw "dst must not share memory with the source matrix";
+  }
+  return dst;
+}
+
 Matrix::Matrix() :
-    node_opencv::Matrix() {
+    node_opencv::Matrix(),
+    externalBytes(0),
+    countedData(NULL),
+    syncPending(false) {
   mat = cv::Mat();
 }
 
 Matrix::Matrix(int rows, int cols) :
-    node_opencv::Matrix() {
+    node_opencv::Matrix(),
+    externalBytes(0),
+    countedData(NULL),
+    syncPending(false) {
   mat = cv::Mat(rows, cols, CV_32FC3);
 }
 
 Matrix::Matrix(int rows, int cols, int type) :
-    node_opencv::Matrix() {
+    node_opencv::Matrix(),
+    externalBytes(0),
+    countedData(NULL),
+    syncPending(false) {
   mat = cv::Mat(rows, cols, type);
 }
 
 Matrix::Matrix(cv::Mat m, cv::Rect roi) :
-    node_opencv::Matrix() {
+    node_opencv::Matrix(),
+    externalBytes(0),
+    countedData(NULL),
+    syncPending(false) {
   mat = cv::Mat(m, roi);
 }
 
-Matrix::Matrix(int rows, int cols, int type, Local<Object> scalarObj) {
+Matrix::~Matrix() {
+  buffer.Reset();
+
+  if (syncPending) {
+    pendingSync.erase(std::find(pendingSync.begin(), pendingSync.end(), this));
+  }
+  ReleaseCountedData();
+  if (externalBytes) {
+    Nan::AdjustExternalMemory(-externalBytes);
+  }
+}
+
+Matrix::Matrix(int rows, int cols, int type, Local<Object> scalarObj) :
+    externalBytes(0),
+    countedData(NULL),
+    syncPending(false) {
   mat = cv::Mat(rows, cols, type);
   if (mat.channels() == 3) {
     mat.setTo(cv::Scalar(scalarObj->Get(0)->IntegerValue(),
@@ -379,53 +592,178 @@ NAN_METHOD(Matrix::GetData) {
   info.GetReturnValue().Set(actualBuffer);
 }
 
-NAN_METHOD(Matrix::Brightness) {
-  Nan::HandleScope scope;
-  Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
+// Drops the cv::Mat reference held by a getDataView() buffer once V8 has
+// collected the buffer.
+static void FreeDataView(char *data, void *hint) {
+  cv::Mat *mat = static_cast<cv::Mat *>(hint);
+  Nan::AdjustExternalMemory(-(int64_t) (mat->total() * mat->elemSize()));
+  delete mat;
+}
 
-  if (info.Length() == 2) {
-    cv::Mat image;
+// getDataView returns a Buffer backed by the matrix pixels themselves rather
+// than a copy. The buffer holds its own reference on the cv::Mat, so the
+// pixels stay alive until the buffer is garbage collected, and writes through
+// the buffer are visible in the matrix. Matrices whose rows are not one
+// contiguous block (a ROI, padded rows) throw; clone() them first.
+// var buf = img.getDataView();
+NAN_METHOD(Matrix::GetDataView) {
+  SETUP_FUNCTION(Matrix)
 
-    if (self->mat.channels() == 3) {
-      image = self->mat;
-    } else if (self->mat.channels() == 1) {
-      cv::Mat myimg = self->mat;
-      cv::cvtColor(myimg, image, CV_GRAY2RGB);
-    } else {
-      Nan::ThrowError("those channels are not supported");
-    }
+  if (self->mat.empty()) {
+    info.GetReturnValue().Set(Nan::NewBuffer(0).ToLocalChecked());
+    return;
+  }
+  if (!self->mat.isContinuous()) {
+    return Nan::ThrowError("getDataView needs a continuous matrix, clone() it first");
+  }
 
-    cv::Mat new_image = cv::Mat::zeros( image.size(), image.type() );
-    double alpha = info[0]->NumberValue();
-    int beta = info[1]->IntegerValue();
+  // The view pins the pixels for as long as it lives, even after the matrix
+  // is released or reassigned, so it reports them to V8 itself
+  cv::Mat *mat = new cv::Mat(self->mat);
+  size_t size = mat->total() * mat->elemSize();
 
-    // Do the operation new_image(i,j) = alpha*image(i,j) + beta
-    for (int y = 0; y < image.rows; y++ ) {
-      for (int x = 0; x < image.cols; x++ ) {
-        for (int c = 0; c < 3; c++ ) {
-          new_image.at<cv::Vec3b>(y,x)[c] =
-              cv::saturate_cast<uchar>(alpha*( image.at<cv::Vec3b>(y,x)[c] ) + beta);
-        }
-      }
-    }
+  Local<Object> buf = Nan::NewBuffer((char *) mat->data, size, FreeDataView, mat).ToLocalChecked();
+  Nan::AdjustExternalMemory((int64_t) size);
 
-    if (self->mat.channels() == 3) {
-      new_image.copyTo(self->mat);
-    } else if (self->mat.channels() == 1) {
-      cv::Mat gray;
-      cv::cvtColor(new_image, gray, CV_BGR2GRAY);
-      gray.copyTo(self->mat);
+  info.GetReturnValue().Set(buf);
+}
+
+// Checks the arguments shared by readRegion and writeRegion. Returns the
+// region of mat, and the typed array argument as a Mat header of the same
+// size and channels over the array's memory (left empty when not given).
+static cv::Mat RegionArguments(Nan::NAN_METHOD_ARGS_TYPE info, const cv::Mat &mat,
+    bool required, cv::Mat &array) {
+  if (mat.empty()) {
+    throw "Matrix is empty";
+  }
+  if (mat.depth() > CV_64F) {
+    throw "Matrix depth is not supported";
+  }
+  if (info.Length() < 1) {
+    throw "Argument 1 must be a rect";
+  }
+
+  Local<Value> rectArg = info[0];
+  cv::Rect rect = Rect::RawRect(1, &rectArg);
+  if (rect.area() <= 0 || (rect & cv::Rect(0, 0, mat.cols, mat.rows)) != rect) {
+    throw "Rect must be inside the matrix";
+  }
+
+  if (info.Length() < 2 || info[1]->IsUndefined()) {
+    if (required) {
+      throw "Argument 2 must be a typed array";
     }
+    return mat(rect);
+  }
+
+  if (!info[1]->IsTypedArray()) {
+    throw "Argument 2 must be a typed array";
+  }
+  Local<TypedArray> typed = info[1].As<TypedArray>();
+  int depth = TypedArrayDepth(typed);
+  if (depth < 0) {
+    throw "Typed array type is not supported";
+  }
+  if (typed->Length() < rect.area() * (size_t) mat.channels()) {
+    throw "Typed array is too small for the rect";
+  }
+
+  array = cv::Mat(rect.height, rect.width, CV_MAKETYPE(depth, mat.channels()),
+      TypedArrayData(typed));
+  return mat(rect);
+}
+
+// mat.readRegion(rect, [out])
+// Copies the pixels of rect ({x, y, width, height} or a cv.Rect) into a typed
+// array, row by row with the channels interleaved. out can be any typed array
+// with room for width * height * channels values, and is converted to with
+// saturation; otherwise a new typed array matching the matrix depth is
+// returned.
+NAN_METHOD(Matrix::ReadRegion) {
+  SETUP_FUNCTION(Matrix)
+
+  cv::Mat region, out;
+  try {
+    region = RegionArguments(info, self->mat, false, out);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+
+  Local<TypedArray> result;
+  if (out.empty()) {
+    result = NewTypedArrayForDepth(region.depth(), region.total() * region.channels());
+    out = cv::Mat(region.rows, region.cols, region.type(), TypedArrayData(result));
   } else {
-    if (info.Length() == 1) {
-      int diff = info[0]->IntegerValue();
-      cv::Mat img = self->mat + diff;
-      img.copyTo(self->mat);
-    } else {
-      info.GetReturnValue().Set(Nan::New("Insufficient or wrong arguments").ToLocalChecked());
+    result = info[1].As<TypedArray>();
+  }
+
+  // out already has the right size and type, so neither call reallocates it
+  if (out.depth() == region.depth()) {
+    region.copyTo(out);
+  } else {
+    region.convertTo(out, out.depth());
+  }
+
+  info.GetReturnValue().Set(result);
+}
+
+// mat.writeRegion(rect, data)
+// The reverse of readRegion: copies a typed array of width * height *
+// channels values into rect, converting with saturation.
+NAN_METHOD(Matrix::WriteRegion) {
+  SETUP_FUNCTION(Matrix)
+
+  cv::Mat region, data;
+  try {
+    region = RegionArguments(info, self->mat, true, data);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+
+  // region is a view of self->mat, so the copy lands in place
+  if (data.depth() == region.depth()) {
+    data.copyTo(region);
+  } else {
+    data.convertTo(region, region.depth());
+  }
+
+  info.GetReturnValue().Set(info.This());
+}
+
+// dst = saturate(alpha * src + beta), on every channel. 8-bit images go
+// through a 256 entry lookup table, everything else through convertTo; both
+// are vectorised by OpenCV and can run with dst == src.
+void adjustBrightness(const cv::Mat &src, cv::Mat &dst, double alpha, double beta) {
+  if (src.depth() == CV_8U) {
+    cv::Mat lut(1, 256, CV_8U);
+    uchar *table = lut.ptr();
+    for (int i = 0; i < 256; i++) {
+      table[i] = cv::saturate_cast<uchar>(alpha * i + beta);
     }
+    cv::LUT(src, lut, dst);
+  } else {
+    src.convertTo(dst, -1, alpha, beta);
   }
+}
 
+// mat.brightness(alpha, beta) or mat.brightness(diff)
+// Applies pixel = alpha * pixel + beta (diff is alpha 1, beta diff) in place,
+// to every channel.
+NAN_METHOD(Matrix::Brightness) {
+  SETUP_FUNCTION(Matrix)
+
+  double alpha = 1;
+  double beta = 0;
+  if (info.Length() == 2 && info[0]->IsNumber() && info[1]->IsNumber()) {
+    alpha = info[0]->NumberValue();
+    beta = info[1]->NumberValue();
+  } else if (info.Length() == 1 && info[0]->IsNumber()) {
+    beta = info[0]->NumberValue();
+  } else {
+    return Nan::ThrowTypeError("Matrix.brightness takes (alpha, beta) or (diff)");
+  }
+
+  adjustBrightness(self->mat, self->mat, alpha, beta);
   info.GetReturnValue().Set(Nan::Null());
 }
 
@@ -673,12 +1011,22 @@ NAN_METHOD(Matrix::Channels) {
   info.GetReturnValue().Set(Nan::New<Number>(self->mat.channels()));
 }
 
-NAN_METHOD(Matrix::ToBuffer) {
-  SETUP_FUNCTION(Matrix)
+// Options shared by toBuffer() and toBufferAsync()
+struct EncodeOptions {
+  std::string ext = ".jpg";
+  std::vector<int> params;
+  // When set, the image is encoded into this Buffer rather than a new one
+  Local<Object> buffer;
+  // When set, the JPEG quality is searched for, up to maxQuality, so the
+  // image fits in this many bytes
+  size_t maxBytes = 0;
+  int maxQuality = 95;
+};
 
-  if ((info.Length() > 0) && (info[0]->IsFunction())) {
-    return Matrix::ToBufferAsync(info);
-  }
+// Parses {ext, jpegQuality, pngCompression, buffer, maxBytes}. Throws a
+// const char* when invalid.
+static EncodeOptions ParseEncodeOptions(Local<Object> options) {
+  EncodeOptions result;
 
   // SergeMv changes
   // img.toBuffer({ext: ".png", pngCompression: 9}); // default png compression is 3
@@ -686,54 +1034,246 @@ NAN_METHOD(Matrix::ToBuffer) {
   // img.toBuffer(); // creates Jpeg with quality of 95 (Opencv default quality)
   // via the ext you can do other image formats too (like tiff), see
   // http://docs.opencv.org/modules/highgui/doc/reading_and_writing_images_and_video.html#imencode
-  //---------------------------
-  // Provide default value
-  const char *ext = ".jpg";
-  std::string optExt;
-  std::vector<int> params;
+  if (options->Has(Nan::New<String>("ext").ToLocalChecked())) {
+    v8::String::Utf8Value str(
+        options->Get(Nan::New<String>("ext").ToLocalChecked())->ToString());
+    result.ext = *str;
+  }
+  if (options->Has(Nan::New<String>("jpegQuality").ToLocalChecked())) {
+    int compression =
+        options->Get(Nan::New<String>("jpegQuality").ToLocalChecked())->IntegerValue();
+    result.params.push_back(CV_IMWRITE_JPEG_QUALITY);
+    result.params.push_back(compression);
+    result.maxQuality = std::min(std::max(compression, 1), 100);
+  }
+  if (options->Has(Nan::New<String>("pngCompression").ToLocalChecked())) {
+    int compression =
+        options->Get(Nan::New<String>("pngCompression").ToLocalChecked())->IntegerValue();
+    result.params.push_back(CV_IMWRITE_PNG_COMPRESSION);
+    result.params.push_back(compression);
+  }
+
+  Local<Value> maxBytes = options->Get(Nan::New<String>("maxBytes").ToLocalChecked());
+  if (!maxBytes->IsUndefined()) {
+    if (!maxBytes->IsNumber() || maxBytes->NumberValue() < 1) {
+      throw "maxBytes must be a positive number";
+    }
+    std::string ext = result.ext;
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext != ".jpg" && ext != ".jpeg" && ext != "jpg" && ext != "jpeg") {
+      throw "maxBytes needs ext '.jpg'";
+    }
+    result.maxBytes = (size_t) maxBytes->NumberValue();
+  }
 
-  // See if the options argument is passed
-  if ((info.Length() > 0) && (info[0]->IsObject())) {
-    // Get this options argument
-    v8::Handle < v8::Object > options = v8::Local<v8::Object>::Cast(info[0]);
-    // If the extension (image format) is provided
-    if (options->Has(Nan::New<String>("ext").ToLocalChecked())) {
-      v8::String::Utf8Value str(
-          options->Get(Nan::New<String>("ext").ToLocalChecked())->ToString());
-      optExt = *str;
-      ext = (const char *) optExt.c_str();
+  Local<Value> buffer = options->Get(Nan::New<String>("buffer").ToLocalChecked());
+  if (!buffer->IsUndefined()) {
+    if (!Buffer::HasInstance(buffer)) {
+      throw "buffer must be a Buffer";
+    }
+    result.buffer = buffer->ToObject();
+  }
+
+  return result;
+}
+
+// Frees the encoded bytes behind a toBuffer() result once V8 has collected
+// the buffer.
+static void FreeEncoded(char *data, void *hint) {
+  std::vector<uchar> *vec = static_cast<std::vector<uchar> *>(hint);
+  Nan::AdjustExternalMemory(-(int) vec->capacity());
+  delete vec;
+}
+
+// A Buffer that takes over the storage of vec, and vec itself, instead of
+// copying the encoded bytes out of it.
+static Local<Object> EncodedBuffer(std::vector<uchar> *vec) {
+  if (vec->empty()) {
+    delete vec;
+    return Nan::NewBuffer(0).ToLocalChecked();
+  }
+  Nan::AdjustExternalMemory((int) vec->capacity());
+  return Nan::NewBuffer((char *) vec->data(), vec->size(), FreeEncoded, vec).ToLocalChecked();
+}
+
+// imencode always writes to a vector, so encoding into a caller's Buffer goes
+// through this one, kept per thread so its memory is reused for every frame.
+static std::vector<uchar> &EncodeScratch() {
+  thread_local std::vector<uchar> scratch;
+  return scratch;
+}
+
+// Copies the scratch encode into out, or returns false if it does not fit
+static bool CopyEncoded(const std::vector<uchar> &vec, char *out, size_t outLength) {
+  if (vec.size() > outLength) {
+    return false;
+  }
+  memcpy(out, vec.data(), vec.size());
+  return true;
+}
+
+// Encodes as JPEG with the quality as a parameter, into vec
+static size_t EncodeJpeg(const cv::Mat &mat, int quality, std::vector<uchar> &vec) {
+  std::vector<int> params(2);
+  params[0] = CV_IMWRITE_JPEG_QUALITY;
+  params[1] = quality;
+  cv::imencode(".jpg", mat, vec, params);
+  return vec.size();
+}
+
+// Finds the highest JPEG quality whose encode fits in a byte budget. The
+// search runs on a copy scaled down to about kProbeArea pixels, then a few
+// full size encodes calibrate and confirm it, so a large image is encoded
+// at full size 3 or 4 times rather than the 7 of a plain binary search.
+class JpegQualitySearch {
+public:
+  static const int kProbeArea = 320 * 240;
+
+  JpegQualitySearch(const cv::Mat &mat, size_t maxBytes, int maxQuality) :
+      mat(mat),
+      maxBytes(maxBytes),
+      maxQuality(maxQuality),
+      fit(0),
+      noFit(maxQuality + 1) {
+  }
+
+  // Returns the quality, with its encode in out, or 0 when even quality 1
+  // is over the budget
+  int Run(std::vector<uchar> &out) {
+    double area = (double) mat.total();
+    int guess = 1;
+    if (area > 4 * kProbeArea) {
+      double scale = std::sqrt(kProbeArea / area);
+      cv::Mat probe;
+      cv::resize(mat, probe, cv::Size(), scale, scale, cv::INTER_AREA);
+
+      // First guess with the bytes in proportion to the pixels, then again
+      // with the ratio the full size encode of that guess actually had
+      int first = ProbeSearch(probe, maxBytes * scale * scale);
+      size_t fullBytes = TryFull(first, out);
+      double ratio = (double) fullBytes / EncodeJpeg(probe, first, vec);
+      guess = ProbeSearch(probe, maxBytes / ratio);
+      TryFull(guess, out);
     }
-    if (options->Has(Nan::New<String>("jpegQuality").ToLocalChecked())) {
-      int compression =
-          options->Get(Nan::New<String>("jpegQuality").ToLocalChecked())->IntegerValue();
-      params.push_back(CV_IMWRITE_JPEG_QUALITY);
-      params.push_back(compression);
+
+    // Settle the last steps at full size, near the guess unless nothing
+    // has fitted yet. When even the top of that window fits, the answer is
+    // above it, so search the rest of the range too.
+    int hi = noFit - 1;
+    if (fit > 0) {
+      hi = std::min(hi, std::max(fit, guess) + 4);
     }
-    if (options->Has(Nan::New<String>("pngCompression").ToLocalChecked())) {
-      int compression =
-          options->Get(Nan::New<String>("pngCompression").ToLocalChecked())->IntegerValue();
-      params.push_back(CV_IMWRITE_PNG_COMPRESSION);
-      params.push_back(compression);
+    FullSearch(hi, out);
+    if (fit + 1 < noFit) {
+      FullSearch(noFit - 1, out);
     }
+    return fit;
   }
 
-  //---------------------------
-  std::vector<uchar> vec(0);
+private:
+  // Binary search at full size between the best fit so far and hi
+  void FullSearch(int hi, std::vector<uchar> &out) {
+    int lo = fit + 1;
+    while (lo <= hi) {
+      int q = (lo + hi) / 2;
+      if (TryFull(q, out) <= maxBytes) {
+        lo = q + 1;
+      } else {
+        hi = q - 1;
+      }
+    }
+  }
 
-  cv::imencode(ext, self->mat, vec, params);
+  // Encodes at full size unless the answer is already known, keeping the
+  // best encode that fits in out. Returns the size.
+  size_t TryFull(int q, std::vector<uchar> &out) {
+    if (q <= fit) {
+      return 0;
+    }
+    if (q >= noFit) {
+      return maxBytes + 1;
+    }
+    size_t bytes = EncodeJpeg(mat, q, vec);
+    if (bytes <= maxBytes) {
+      fit = q;
+      out.swap(vec);
+    } else {
+      noFit = q;
+    }
+    return bytes;
+  }
+
+  // Binary search on the probe, returns the highest quality within budget,
+  // or 1
+  int ProbeSearch(const cv::Mat &probe, double budget) {
+    int lo = 1;
+    int hi = maxQuality;
+    int best = 1;
+    while (lo <= hi) {
+      int q = (lo + hi) / 2;
+      if (EncodeJpeg(probe, q, vec) <= budget) {
+        best = q;
+        lo = q + 1;
+      } else {
+        hi = q - 1;
+      }
+    }
+    return best;
+  }
 
-  Local < Object > buf = Nan::NewBuffer(vec.size()).ToLocalChecked();
-  uchar* data = (uchar*) Buffer::Data(buf);
-  memcpy(data, &vec[0], vec.size());
+  const cv::Mat &mat;
+  size_t maxBytes;
+  int maxQuality;
+  // Highest quality known to fit, and lowest known not to
+  int fit;
+  int noFit;
+  std::vector<uchar> vec;
+};
+
+// img.toBuffer([options]) returns a new Buffer with the encoded image.
+// img.toBuffer({buffer: buf, ...}) encodes into buf instead, and returns the
+// number of bytes written, so a video loop can reuse one output Buffer.
+NAN_METHOD(Matrix::ToBuffer) {
+  SETUP_FUNCTION(Matrix)
 
-  v8::Local < v8::Object > globalObj = Nan::GetCurrentContext()->Global();
-  v8::Local < v8::Function > bufferConstructor = v8::Local < v8::Function
-      > ::Cast(globalObj->Get(Nan::New<String>("Buffer").ToLocalChecked()));
-  v8::Local<v8::Value> constructorArgs[3] =
-      {buf, Nan::New<v8::Integer>((unsigned)vec.size()), Nan::New<v8::Integer>(0)};
-  v8::Local < v8::Object > actualBuffer = Nan::NewInstance(bufferConstructor, 3, constructorArgs).ToLocalChecked();
+  if ((info.Length() > 0) && (info[0]->IsFunction())) {
+    return Matrix::ToBufferAsync(info);
+  }
 
-  info.GetReturnValue().Set(actualBuffer);
+  EncodeOptions options;
+  try {
+    if ((info.Length() > 0) && (info[0]->IsObject())) {
+      options = ParseEncodeOptions(info[0]->ToObject());
+    }
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (options.maxBytes) {
+    return Nan::ThrowTypeError("maxBytes needs a callback, see toBufferAsync");
+  }
+
+  if (options.buffer.IsEmpty()) {
+    std::vector<uchar> *vec = new std::vector<uchar>();
+    try {
+      cv::imencode(options.ext, self->mat, *vec, options.params);
+    } catch (cv::Exception &e) {
+      delete vec;
+      return Nan::ThrowError(e.what());
+    }
+    info.GetReturnValue().Set(EncodedBuffer(vec));
+    return;
+  }
+
+  std::vector<uchar> &vec = EncodeScratch();
+  try {
+    cv::imencode(options.ext, self->mat, vec, options.params);
+  } catch (cv::Exception &e) {
+    return Nan::ThrowError(e.what());
+  }
+  if (!CopyEncoded(vec, Buffer::Data(options.buffer), Buffer::Length(options.buffer))) {
+    return Nan::ThrowRangeError("Encoded image does not fit in buffer");
+  }
+  info.GetReturnValue().Set(Nan::New<Number>(vec.size()));
 }
 
 class AsyncToBufferWorker: public Nan::AsyncWorker {
@@ -743,38 +1283,92 @@ public:
       Nan::AsyncWorker(callback),
       matrix(matrix),
       ext(ext),
-      params(params) {
+      params(params),
+      res(nullptr),
+      out(nullptr),
+      outLength(0),
+      written(0),
+      maxBytes(0),
+      maxQuality(0),
+      quality(0),
+      queuedAt(Profiler::Now()) {
+    static int op = Profiler::Register("Matrix.toBufferAsync:worker");
+    profilerOp = op;
   }
 
   ~AsyncToBufferWorker() {
+    delete res;
+  }
+
+  // Encode into buffer rather than a new Buffer; it is kept alive until the
+  // callback.
+  void SetOutput(Local<Object> buffer) {
+    SaveToPersistent("buffer", buffer);
+    out = Buffer::Data(buffer);
+    outLength = Buffer::Length(buffer);
+  }
+
+  // Search for the highest quality up to maxQuality that fits in maxBytes,
+  // see JpegQualitySearch
+  void SetMaxBytes(size_t maxBytes, int maxQuality) {
+    this->maxBytes = maxBytes;
+    this->maxQuality = maxQuality;
   }
 
   void Execute() {
-    std::vector<uchar> vec(0);
-    // std::vector<int> params(0);//CV_IMWRITE_JPEG_QUALITY 90
-    cv::imencode(ext, this->matrix->mat, vec, this->params);
-    res = vec;
+    Profiler::Timer timer(profilerOp, queuedAt);
+    try {
+      if (maxBytes) {
+        if (out == nullptr) {
+          res = new std::vector<uchar>();
+        }
+        std::vector<uchar> &vec = out == nullptr ? *res : EncodeScratch();
+        quality = JpegQualitySearch(this->matrix->mat, maxBytes, maxQuality).Run(vec);
+        if (!quality) {
+          return SetErrorMessage("Encoded image does not fit in maxBytes at any quality");
+        }
+        if (out != nullptr && !CopyEncoded(vec, out, outLength)) {
+          return SetErrorMessage("Encoded image does not fit in buffer");
+        }
+        written = vec.size();
+        timer.bytes = written;
+      } else if (out == nullptr) {
+        res = new std::vector<uchar>();
+        cv::imencode(ext, this->matrix->mat, *res, this->params);
+        timer.bytes = res->size();
+      } else {
+        std::vector<uchar> &vec = EncodeScratch();
+        cv::imencode(ext, this->matrix->mat, vec, this->params);
+        if (!CopyEncoded(vec, out, outLength)) {
+          return SetErrorMessage("Encoded image does not fit in buffer");
+        }
+        written = vec.size();
+        timer.bytes = written;
+      }
+    } catch (cv::Exception &e) {
+      SetErrorMessage(e.what());
+    }
   }
 
   void HandleOKCallback() {
     Nan::HandleScope scope;
 
-    Local<Object> buf = Nan::NewBuffer(res.size()).ToLocalChecked();
-    uchar* data = (uchar*) Buffer::Data(buf);
-    memcpy(data, &res[0], res.size());
-
-    v8::Local<v8::Object> globalObj = Nan::GetCurrentContext()->Global();
-    v8::Local<v8::Function> bufferConstructor = v8::Local<v8::Function>::Cast(globalObj->Get(Nan::New<String>("Buffer").ToLocalChecked()));
-    v8::Local<v8::Value> constructorArgs[3] = {buf, Nan::New<v8::Integer>((unsigned)res.size()), Nan::New<v8::Integer>(0)};
-    v8::Local<v8::Object> actualBuffer = Nan::NewInstance(bufferConstructor, 3, constructorArgs).ToLocalChecked();;
+    Local<Value> result;
+    if (out == nullptr) {
+      result = EncodedBuffer(res);
+      res = nullptr;
+    } else {
+      result = Nan::New<Number>(written);
+    }
 
     Local<Value> argv[] = {
       Nan::Null(),
-      actualBuffer
+      result,
+      Nan::New<Number>(quality)
     };
 
     Nan::TryCatch try_catch;
-    callback->Call(Nan::GetCurrentContext()->Global(), 2, argv);
+    callback->Call(Nan::GetCurrentContext()->Global(), maxBytes ? 3 : 2, argv);
     if (try_catch.HasCaught()) {
       Nan::FatalException(try_catch);
     }
@@ -785,7 +1379,16 @@ private:
   Matrix* matrix;
   std::string ext;
   std::vector<int> params;
-  std::vector<uchar> res;
+  std::vector<uchar> *res;
+  char *out;
+  size_t outLength;
+  size_t written;
+  size_t maxBytes;
+  int maxQuality;
+  // The quality picked for maxBytes
+  int quality;
+  uint64_t queuedAt;
+  int profilerOp;
 };
 
 NAN_METHOD(Matrix::ToBufferAsync) {
@@ -793,38 +1396,263 @@ NAN_METHOD(Matrix::ToBufferAsync) {
 
   REQ_FUN_ARG(0, cb);
 
-  std::string ext = std::string(".jpg");
+  EncodeOptions options;
+  try {
+    if ((info.Length() > 1) && (info[1]->IsObject())) {
+      options = ParseEncodeOptions(info[1]->ToObject());
+    }
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+
+  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
+  AsyncToBufferWorker *worker = new AsyncToBufferWorker(callback, self,
+      options.ext, options.params);
+  // The matrix is read on the worker thread
+  worker->SaveToPersistent("matrix", info.This());
+  if (!options.buffer.IsEmpty()) {
+    worker->SetOutput(options.buffer);
+  }
+  if (options.maxBytes) {
+    worker->SetMaxBytes(options.maxBytes, options.maxQuality);
+  }
+  Nan::AsyncQueueWorker(worker);
+
+  return;
+}
+
+// One image size and format for encodeRenditions()
+struct Rendition {
+  // 0 for the full size
+  int maxWidth;
+  std::string ext;
   std::vector<int> params;
+};
 
-  // See if the options argument is passed
-  if ((info.Length() > 1) && (info[1]->IsObject())) {
-    // Get this options argument
-    v8::Handle < v8::Object > options = v8::Local<v8::Object>::Cast(info[1]);
-    // If the extension (image format) is provided
-    if (options->Has(Nan::New<String>("ext").ToLocalChecked())) {
-      v8::String::Utf8Value str(
-          options->Get(Nan::New<String>("ext").ToLocalChecked())->ToString());
-      std::string str2 = std::string(*str);
-      ext = str2;
+// Scales and encodes renditions [from, to), each from the smallest level of
+// the shared pyramid that is still at least as wide as the rendition
+class EncodeRenditionsBody: public cv::ParallelLoopBody {
+public:
+  EncodeRenditionsBody(const std::vector<cv::Mat> &levels,
+      const std::vector<Rendition> &renditions,
+      std::vector<std::vector<uchar> *> &results, std::string &error,
+      std::mutex &errorMutex, int profilerOp) :
+      levels(levels),
+      renditions(renditions),
+      results(results),
+      error(error),
+      errorMutex(errorMutex),
+      profilerOp(profilerOp) {
+  }
+
+  void operator()(const cv::Range &range) const {
+    try {
+      cv::Mat scaled;
+      for (int i = range.start; i < range.end; i++) {
+        Profiler::Timer timer(profilerOp);
+        const Rendition &r = renditions[i];
+        const cv::Mat *src = &levels[0];
+        if (r.maxWidth > 0 && r.maxWidth < levels[0].cols) {
+          for (size_t l = 1; l < levels.size() && levels[l].cols >= r.maxWidth; l++) {
+            src = &levels[l];
+          }
+          int height = std::max(1, cvRound((double) levels[0].rows * r.maxWidth / levels[0].cols));
+          cv::resize(*src, scaled, cv::Size(r.maxWidth, height), 0, 0, cv::INTER_AREA);
+          src = &scaled;
+        }
+        cv::imencode(r.ext, *src, *results[i], r.params);
+        timer.bytes = results[i]->size();
+      }
+    } catch (cv::Exception& e) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      error = e.what();
     }
-    if (options->Has(Nan::New<String>("jpegQuality").ToLocalChecked())) {
-      int compression =
-          options->Get(Nan::New<String>("jpegQuality").ToLocalChecked())->IntegerValue();
-      params.push_back(CV_IMWRITE_JPEG_QUALITY);
-      params.push_back(compression);
+  }
+
+private:
+  const std::vector<cv::Mat> &levels;
+  const std::vector<Rendition> &renditions;
+  std::vector<std::vector<uchar> *> &results;
+  std::string &error;
+  std::mutex &errorMutex;
+  int profilerOp;
+};
+
+class AsyncEncodeRenditionsWorker: public Nan::AsyncWorker {
+public:
+  AsyncEncodeRenditionsWorker(Nan::Callback *callback, const cv::Mat &mat,
+      const std::vector<Rendition> &renditions) :
+      Nan::AsyncWorker(callback),
+      mat(mat),
+      renditions(renditions),
+      results(renditions.size()),
+      queuedAt(Profiler::Now()) {
+    static int op = Profiler::Register("Matrix.encodeRenditions:worker");
+    static int renditionOp = Profiler::Register("Matrix.encodeRenditions:rendition");
+    profilerOp = op;
+    renditionProfilerOp = renditionOp;
+    for (size_t i = 0; i < results.size(); i++) {
+      results[i] = new std::vector<uchar>();
     }
-    if (options->Has(Nan::New<String>("pngCompression").ToLocalChecked())) {
-      int compression =
-          options->Get(Nan::New<String>("pngCompression").ToLocalChecked())->IntegerValue();
-      params.push_back(CV_IMWRITE_PNG_COMPRESSION);
-      params.push_back(compression);
+  }
+
+  ~AsyncEncodeRenditionsWorker() {
+    for (size_t i = 0; i < results.size(); i++) {
+      delete results[i];
     }
   }
 
-  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
-  Nan::AsyncQueueWorker(new AsyncToBufferWorker(callback, self, ext, params));
+  void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
+    if (mat.empty()) {
+      return SetErrorMessage("Cannot encode an empty matrix");
+    }
 
-  return;
+    int smallest = mat.cols;
+    for (size_t i = 0; i < renditions.size(); i++) {
+      if (renditions[i].maxWidth > 0) {
+        smallest = std::min(smallest, renditions[i].maxWidth);
+      }
+    }
+
+    std::string error;
+    std::mutex errorMutex;
+    try {
+      // Halve the image for as long as the smallest rendition still fits,
+      // so no rendition is scaled down by more than 2x in one step
+      std::vector<cv::Mat> levels(1, mat);
+      while (levels.back().cols / 2 >= smallest && levels.back().rows > 1) {
+        cv::Mat next;
+        cv::pyrDown(levels.back(), next);
+        levels.push_back(next);
+      }
+
+      cv::parallel_for_(cv::Range(0, renditions.size()), EncodeRenditionsBody(
+          levels, renditions, results, error, errorMutex, renditionProfilerOp));
+    } catch (cv::Exception& e) {
+      error = e.what();
+    }
+
+    if (!error.empty()) {
+      SetErrorMessage(error.c_str());
+    }
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    Local<Array> buffers = Nan::New<Array>(results.size());
+    for (size_t i = 0; i < results.size(); i++) {
+      buffers->Set(i, EncodedBuffer(results[i]));
+      results[i] = nullptr;
+    }
+
+    if (callback) {
+      Local<Value> argv[] = {
+        Nan::Null(),
+        buffers
+      };
+
+      Nan::TryCatch try_catch;
+      callback->Call(2, argv);
+      if (try_catch.HasCaught()) {
+        Nan::FatalException(try_catch);
+      }
+    } else {
+      Local<Promise::Resolver> resolver = GetFromPersistent("resolver").As<Promise::Resolver>();
+      resolver->Resolve(Nan::GetCurrentContext(), buffers);
+      Isolate::GetCurrent()->RunMicrotasks();
+    }
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+
+    Local<Value> error = Nan::Error(ErrorMessage());
+
+    if (callback) {
+      Local<Value> argv[] = {
+        error
+      };
+
+      Nan::TryCatch try_catch;
+      callback->Call(1, argv);
+      if (try_catch.HasCaught()) {
+        Nan::FatalException(try_catch);
+      }
+    } else {
+      Local<Promise::Resolver> resolver = GetFromPersistent("resolver").As<Promise::Resolver>();
+      resolver->Reject(Nan::GetCurrentContext(), error);
+      Isolate::GetCurrent()->RunMicrotasks();
+    }
+  }
+
+private:
+  cv::Mat mat;
+  std::vector<Rendition> renditions;
+  std::vector<std::vector<uchar> *> results;
+  uint64_t queuedAt;
+  int profilerOp;
+  int renditionProfilerOp;
+};
+
+// img.encodeRenditions([{maxWidth, ext, jpegQuality, pngCompression}, ...], [callback])
+// Encodes the image at several sizes and qualities in one call. Renditions
+// wider than maxWidth are scaled down, keeping the aspect ratio, from one
+// pyramid of halved images shared by all of them, and are encoded in
+// parallel. Resolves with a Buffer for each rendition, in order.
+NAN_METHOD(Matrix::EncodeRenditions) {
+  SETUP_FUNCTION(Matrix)
+
+  if (info.Length() < 1 || !info[0]->IsArray()) {
+    return Nan::ThrowTypeError("Argument 1 must be an array of rendition options");
+  }
+
+  Local<Array> list = info[0].As<Array>();
+  std::vector<Rendition> renditions(list->Length());
+  try {
+    for (unsigned int i = 0; i < list->Length(); i++) {
+      Local<Value> item = list->Get(i);
+      if (!item->IsObject()) {
+        throw "Argument 1 must be an array of rendition options";
+      }
+      Local<Object> options = item->ToObject();
+      EncodeOptions encode = ParseEncodeOptions(options);
+      if (!encode.buffer.IsEmpty() || encode.maxBytes) {
+        throw "encodeRenditions does not take the buffer or maxBytes options";
+      }
+      renditions[i].ext = encode.ext;
+      renditions[i].params = encode.params;
+
+      Local<Value> maxWidth = options->Get(Nan::New<String>("maxWidth").ToLocalChecked());
+      renditions[i].maxWidth = 0;
+      if (!maxWidth->IsUndefined()) {
+        renditions[i].maxWidth = maxWidth->Int32Value();
+        if (renditions[i].maxWidth <= 0) {
+          throw "maxWidth must be a positive number";
+        }
+      }
+    }
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+
+  Nan::Callback *callback = nullptr;
+  if (info.Length() > 1 && info[1]->IsFunction()) {
+    callback = new Nan::Callback(info[1].As<Function>());
+  }
+
+  AsyncEncodeRenditionsWorker *worker = new AsyncEncodeRenditionsWorker(
+      callback, self->mat, renditions);
+  worker->SaveToPersistent("matrix", info.This());
+
+  if (!callback) {
+    Local<Promise::Resolver> resolver = Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked();
+    worker->SaveToPersistent("resolver", resolver);
+    info.GetReturnValue().Set(resolver->GetPromise());
+  }
+
+  Nan::AsyncQueueWorker(worker);
 }
 
 NAN_METHOD(Matrix::Ellipse) {
@@ -1018,7 +1846,10 @@ public:
   AsyncSaveWorker(Nan::Callback *callback, Matrix* matrix, char* filename) :
       Nan::AsyncWorker(callback),
       matrix(matrix),
-      filename(filename) {
+      filename(filename),
+      queuedAt(Profiler::Now()) {
+    static int op = Profiler::Register("Matrix.saveAsync:worker");
+    profilerOp = op;
   }
 
   ~AsyncSaveWorker() {
@@ -1029,6 +1860,7 @@ public:
   // here, so everything we need for input and output
   // should go on `this`.
   void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
     res = cv::imwrite(this->filename, this->matrix->mat);
   }
 
@@ -1054,6 +1886,8 @@ private:
   Matrix* matrix;
   std::string filename;
   int res;
+  uint64_t queuedAt;
+  int profilerOp;
 };
 
 NAN_METHOD(Matrix::SaveAsync) {
@@ -1118,6 +1952,72 @@ NAN_METHOD(Matrix::Eye) {
   info.GetReturnValue().Set(im_h);
 }
 
+// Matrix.fromBuffer(buf, rows, cols, type[, step]) wraps the memory of an
+// existing Buffer in a matrix without copying it. The Buffer is pinned for
+// the lifetime of the matrix; operations that reallocate the matrix detach
+// it from the Buffer.
+NAN_METHOD(Matrix::FromBuffer) {
+  Nan::HandleScope scope;
+
+  if (info.Length() < 4) {
+    return Nan::ThrowError("Matrix.fromBuffer requires at least 4 arguments");
+  }
+
+  if (!Buffer::HasInstance(info[0])) {
+    return Nan::ThrowTypeError("Argument 1 must be a Buffer");
+  }
+
+  if (!info[1]->IsInt32() || !info[2]->IsInt32() || !info[3]->IsInt32()) {
+    return Nan::ThrowTypeError("rows, cols and type must be integers");
+  }
+
+  int rows = info[1]->Int32Value();
+  int cols = info[2]->Int32Value();
+  int type = info[3]->Int32Value();
+
+  if (rows <= 0 || cols <= 0) {
+    return Nan::ThrowRangeError("rows and cols must be > 0");
+  }
+
+  size_t rowBytes = (size_t) cols * CV_ELEM_SIZE(type);
+  size_t step = rowBytes;
+  if (info.Length() > 4 && info[4]->IsNumber()) {
+    // Anything else would wrap around in size_t
+    double value = info[4]->NumberValue();
+    if (!(value >= 0 && value <= 9007199254740991.0) || value != std::floor(value)) {
+      return Nan::ThrowRangeError("step must be a non-negative integer");
+    }
+    step = (size_t) value;
+  }
+
+  if (step < rowBytes) {
+    return Nan::ThrowRangeError("step must be at least cols * element size");
+  }
+  if (step % CV_ELEM_SIZE1(type) != 0) {
+    return Nan::ThrowRangeError("step must be a multiple of the channel size");
+  }
+
+  // The last row ends at (rows - 1) * step + rowBytes, checked without
+  // overflowing
+  Local<Object> buf = info[0]->ToObject();
+  size_t length = Buffer::Length(buf);
+  if (length < rowBytes || (rows > 1 && step > (length - rowBytes) / (rows - 1))) {
+    return Nan::ThrowRangeError("Buffer is too small for the requested matrix");
+  }
+
+  Local<Object> out = NewInstance();
+  Matrix *m = UNWRAP_OBJ(Matrix, out);
+
+  try {
+    m->mat = cv::Mat(rows, cols, type, Buffer::Data(buf), step);
+  } catch (cv::Exception& e) {
+    return Nan::ThrowError(e.what());
+  }
+  m->buffer.Reset(buf);
+
+  info.GetReturnValue().Set(out);
+}
+
 NAN_METHOD(Matrix::ConvertGrayscale) {
   Nan::HandleScope scope;
 
@@ -1150,12 +2050,19 @@ NAN_METHOD(Matrix::ConvertHSVscale) {
 NAN_METHOD(Matrix::GaussianBlur) {
   Nan::HandleScope scope;
   cv::Size ksize;
-  cv::Mat blurred;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
   double sigma = 0;
 
-  if (info.Length() < 1) {
+  Local<Object> dst;
+  try {
+    dst = DstArgument(info, 0, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  int argc = info.Length() - !dst.IsEmpty();
+
+  if (argc < 1) {
     ksize = cv::Size(5, 5);
   }
   else {
@@ -1175,8 +2082,12 @@ NAN_METHOD(Matrix::GaussianBlur) {
     }
   }
 
-  cv::GaussianBlur(self->mat, blurred, ksize, sigma);
-  blurred.copyTo(self->mat);
+  if (!dst.IsEmpty()) {
+    cv::GaussianBlur(self->mat, UNWRAP_OBJ(Matrix, dst)->mat, ksize, sigma);
+    return info.GetReturnValue().Set(dst);
+  }
+
+  cv::GaussianBlur(self->mat, self->mat, ksize, sigma);
 
   info.GetReturnValue().Set(Nan::Null());
 }
@@ -1187,6 +2098,13 @@ NAN_METHOD(Matrix::MedianBlur) {
   int ksize = 3;
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
 
+  Local<Object> dst;
+  try {
+    dst = DstArgument(info, 1, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+
   if (info[0]->IsNumber()) {
     ksize = info[0]->IntegerValue();
     if ((ksize % 2) == 0) {
@@ -1196,6 +2114,11 @@ NAN_METHOD(Matrix::MedianBlur) {
     Nan::ThrowTypeError("'ksize' argument must be a positive odd integer");
   }
 
+  if (!dst.IsEmpty()) {
+    cv::medianBlur(self->mat, UNWRAP_OBJ(Matrix, dst)->mat, ksize);
+    return info.GetReturnValue().Set(dst);
+  }
+
   cv::medianBlur(self->mat, blurred, ksize);
   blurred.copyTo(self->mat);
 
@@ -1212,19 +2135,33 @@ NAN_METHOD(Matrix::BilateralFilter) {
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
 
-  if (info.Length() != 0) {
-    if (info.Length() < 3 || info.Length() > 4) {
+  Local<Object> dst;
+  try {
+    dst = DstArgument(info, 0, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  int argc = info.Length() - !dst.IsEmpty();
+
+  if (argc != 0) {
+    if (argc < 3 || argc > 4) {
       Nan::ThrowTypeError("BilateralFilter takes 0, 3, or 4 arguments");
     } else {
       d = info[0]->IntegerValue();
       sigmaColor = info[1]->NumberValue();
       sigmaSpace = info[2]->NumberValue();
-      if (info.Length() == 4) {
+      if (argc == 4) {
         borderType = info[3]->IntegerValue();
       }
     }
   }
 
+  if (!dst.IsEmpty()) {
+    cv::bilateralFilter(self->mat, UNWRAP_OBJ(Matrix, dst)->mat, d, sigmaColor,
+        sigmaSpace, borderType);
+    return info.GetReturnValue().Set(dst);
+  }
+
   cv::bilateralFilter(self->mat, filtered, d, sigmaColor, sigmaSpace, borderType);
   filtered.copyTo(self->mat);
 
@@ -1286,7 +2223,15 @@ NAN_METHOD(Matrix::Flip) {
 
   int flipCode = Nan::To<int>(info[0]).FromJust();
 
-  Local<Object> img_to_return = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
+  Local<Object> img_to_return;
+  try {
+    img_to_return = DstArgument(info, 1, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (img_to_return.IsEmpty()) {
+    img_to_return = Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
+  }
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(img_to_return);
   cv::flip(self->mat, img->mat, flipCode);
 
@@ -1529,6 +2474,17 @@ NAN_METHOD(Matrix::Canny) {
   int lowThresh = info[0]->NumberValue();
   int highThresh = info[1]->NumberValue();
 
+  Local<Object> dst;
+  try {
+    dst = DstArgument(info, 2, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (!dst.IsEmpty()) {
+    cv::Canny(self->mat, UNWRAP_OBJ(Matrix, dst)->mat, lowThresh, highThresh);
+    return info.GetReturnValue().Set(dst);
+  }
+
   cv::Canny(self->mat, self->mat, lowThresh, highThresh);
 
   info.GetReturnValue().Set(Nan::Null());
@@ -1541,11 +2497,23 @@ NAN_METHOD(Matrix::Dilate) {
   int niters = info[0]->NumberValue();
 
   cv::Mat kernel = cv::Mat();
-  if (info.Length() == 2) {
+  if (info.Length() >= 2 && HasInstance(info[1])) {
     Matrix *kernelMatrix = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
     kernel = kernelMatrix->mat;
   }
 
+  // dilate(iterations, kernel, dst), where kernel may be null
+  Local<Object> dst;
+  try {
+    dst = DstArgument(info, 2, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (!dst.IsEmpty()) {
+    cv::dilate(self->mat, UNWRAP_OBJ(Matrix, dst)->mat, kernel, cv::Point(-1, -1), niters);
+    return info.GetReturnValue().Set(dst);
+  }
+
   cv::dilate(self->mat, self->mat, kernel, cv::Point(-1, -1), niters);
 
   info.GetReturnValue().Set(Nan::Null());
@@ -1558,10 +2526,23 @@ NAN_METHOD(Matrix::Erode) {
   int niters = info[0]->NumberValue();
 
   cv::Mat kernel = cv::Mat();
-  if (info.Length() == 2) {
+  if (info.Length() >= 2 && HasInstance(info[1])) {
     Matrix *kernelMatrix = Nan::ObjectWrap::Unwrap<Matrix>(info[1]->ToObject());
     kernel = kernelMatrix->mat;
   }
+
+  // erode(iterations, kernel, dst), where kernel may be null
+  Local<Object> dst;
+  try {
+    dst = DstArgument(info, 2, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (!dst.IsEmpty()) {
+    cv::erode(self->mat, UNWRAP_OBJ(Matrix, dst)->mat, kernel, cv::Point(-1, -1), niters);
+    return info.GetReturnValue().Set(dst);
+  }
+
   cv::erode(self->mat, self->mat, kernel, cv::Point(-1, -1), niters);
 
   info.GetReturnValue().Set(Nan::Null());
@@ -1586,6 +2567,7 @@ NAN_METHOD(Matrix::FindContours) {
   Contour *contours = Nan::ObjectWrap::Unwrap<Contour>(conts_to_return);
 
   cv::findContours(self->mat, contours->contours, contours->hierarchy, mode, chain);
+  contours->SyncExternalMemory();
 
   info.GetReturnValue().Set(conts_to_return);
 
@@ -1644,9 +2626,11 @@ NAN_METHOD(Matrix::GoodFeaturesToTrack) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  int maxCorners = info.Length() >= 1 ? info[0]->IntegerValue() : 500;
-  double qualityLevel = info.Length() >= 2 ? (double) info[1]->NumberValue() : 0.01;
-  double minDistance = info.Length() >= 3 ? (double) info[2]->NumberValue() : 10;
+  int argc;
+  bool typed = TypedOutputRequested(info, argc);
+  int maxCorners = argc >= 1 ? info[0]->IntegerValue() : 500;
+  double qualityLevel = argc >= 2 ? (double) info[1]->NumberValue() : 0.01;
+  double minDistance = argc >= 3 ? (double) info[2]->NumberValue() : 10;
 
   std::vector<cv::Point2f> corners;
   cv::Mat gray;
@@ -1655,6 +2639,14 @@ NAN_METHOD(Matrix::GoodFeaturesToTrack) {
   equalizeHist(gray, gray);
 
   cv::goodFeaturesToTrack(gray, corners, maxCorners, qualityLevel, minDistance);
+
+  if (typed) {
+    // x, y per corner
+    const float *data = corners.empty() ? NULL : &corners[0].x;
+    info.GetReturnValue().Set(NewTypedArray<Float32Array>(data, corners.size() * 2));
+    return;
+  }
+
   v8::Local<v8::Array> arr = Nan::New<Array>(corners.size());
 
   for (unsigned int i=0; i<corners.size(); i++) {
@@ -1749,11 +2741,13 @@ NAN_METHOD(Matrix::HoughLinesP) {
   Nan::HandleScope scope;
 
   Matrix *self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  double rho = info.Length() < 1 ? 1 : info[0]->NumberValue();
-  double theta = info.Length() < 2 ? CV_PI/180 : info[1]->NumberValue();
-  int threshold = info.Length() < 3 ? 80 : info[2]->Uint32Value();
-  double minLineLength = info.Length() < 4 ? 30 : info[3]->NumberValue();
-  double maxLineGap = info.Length() < 5 ? 10 : info[4]->NumberValue();
+  int argc;
+  bool typed = TypedOutputRequested(info, argc);
+  double rho = argc < 1 ? 1 : info[0]->NumberValue();
+  double theta = argc < 2 ? CV_PI/180 : info[1]->NumberValue();
+  int threshold = argc < 3 ? 80 : info[2]->Uint32Value();
+  double minLineLength = argc < 4 ? 30 : info[3]->NumberValue();
+  double maxLineGap = argc < 5 ? 10 : info[4]->NumberValue();
   std::vector<cv::Vec4i> lines;
 
   cv::Mat gray;
@@ -1762,6 +2756,13 @@ NAN_METHOD(Matrix::HoughLinesP) {
   // cv::Canny(gray, gray, 50, 200, 3);
   cv::HoughLinesP(gray, lines, rho, theta, threshold, minLineLength, maxLineGap);
 
+  if (typed) {
+    // x1, y1, x2, y2 per line
+    const int *data = lines.empty() ? NULL : &lines[0][0];
+    info.GetReturnValue().Set(NewTypedArray<Int32Array>(data, lines.size() * 4));
+    return;
+  }
+
   v8::Local<v8::Array> arr = Nan::New<Array>(lines.size());
 
   for (unsigned int i=0; i<lines.size(); i++) {
@@ -1882,7 +2883,15 @@ NAN_METHOD(Matrix::Resize) {
   DOUBLE_FROM_ARGS(fy, 2)
   INT_FROM_ARGS(interpolation, 3)
 
-  Local<Object> res = NewInstance();
+  Local<Object> res;
+  try {
+    res = DstArgument(info, 1, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (res.IsEmpty()) {
+    res = NewInstance();
+  }
 
   cv::resize(self->mat, Nan::ObjectWrap::Unwrap<Matrix>(res)->mat, size, fx, fy, interpolation);
 
@@ -1898,41 +2907,69 @@ NAN_METHOD(Matrix::Rotate) {
 
   float angle = Nan::To<double>(info[0]).FromJust();
 
+  Local<Object> dst;
+  try {
+    dst = DstArgument(info, 1, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  int argc = info.Length() - !dst.IsEmpty();
+  if (!dst.IsEmpty()) {
+    info.GetReturnValue().Set(dst);
+  }
+
+  // Without a dst, the result replaces self->mat
+  cv::Mat &out = dst.IsEmpty() ? self->mat : UNWRAP_OBJ(Matrix, dst)->mat;
+
   // Modification by SergeMv
   //-------------
   // If you provide only the angle argument and the angle is multiple of 90, then
   // we do a fast thing
   bool rightOrStraight = (ceil(angle) == angle) && (!((int)angle % 90))
-      && (info.Length() == 1);
+      && (argc == 1);
   if (rightOrStraight) {
     int angle2 = ((int)angle) % 360;
-    if (!angle2) {return;}
-    if (angle2 < 0) {angle2 += 360;}
-    // See if we do right angle rotation, we transpose the matrix:
-    if (angle2 % 180) {
-      cv::transpose(self->mat, res);
-      ~self->mat;
-      self->mat = res;
+    if (!angle2) {
+      if (!dst.IsEmpty()) {
+        self->mat.copyTo(out);
+      }
+      return;
     }
+    if (angle2 < 0) {angle2 += 360;}
     // Now flip the image
     int mode = -1;// flip around both axes
     // If counterclockwise, flip around the x-axis
     if (angle2 == 90) {mode = 0;}
     // If clockwise, flip around the y-axis
     if (angle2 == 270) {mode = 1;}
-    cv::flip(self->mat, self->mat, mode);
+    // See if we do right angle rotation, we transpose the matrix:
+    cv::Mat src = self->mat;
+    if (angle2 % 180) {
+      cv::transpose(self->mat, res);
+      src = res;
+      if (dst.IsEmpty()) {
+        ~self->mat;
+        self->mat = res;
+      }
+    }
+    cv::flip(src, out, mode);
     return;
   }
 
   //-------------
-  int x = info[1]->IsUndefined() ? round(self->mat.size().width / 2) :
-      info[1]->Uint32Value();
-  int y = info[1]->IsUndefined() ? round(self->mat.size().height / 2) :
-      info[2]->Uint32Value();
+  int x = info[1]->IsNumber() ? info[1]->Uint32Value() :
+      round(self->mat.size().width / 2);
+  int y = info[1]->IsNumber() ? info[2]->Uint32Value() :
+      round(self->mat.size().height / 2);
 
   cv::Point center = cv::Point(x,y);
   rotMatrix = getRotationMatrix2D(center, angle, 1.0);
 
+  if (!dst.IsEmpty()) {
+    cv::warpAffine(self->mat, out, rotMatrix, self->mat.size());
+    return;
+  }
+
   cv::warpAffine(self->mat, res, rotMatrix, self->mat.size());
   ~self->mat;
   self->mat = res;
@@ -1970,10 +3007,21 @@ NAN_METHOD(Matrix::WarpAffine) {
   Matrix *rotMatrix = Nan::ObjectWrap::Unwrap<Matrix>(info[0]->ToObject());
 
   // Resize the image if size is specified
-  int dstRows = info[1]->IsUndefined() ? self->mat.rows : info[1]->Uint32Value();
-  int dstCols = info[2]->IsUndefined() ? self->mat.cols : info[2]->Uint32Value();
+  int dstRows = info[1]->IsNumber() ? info[1]->Uint32Value() : self->mat.rows;
+  int dstCols = info[2]->IsNumber() ? info[2]->Uint32Value() : self->mat.cols;
   cv::Size resSize = cv::Size(dstRows, dstCols);
 
+  Local<Object> dst;
+  try {
+    dst = DstArgument(info, 1, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (!dst.IsEmpty()) {
+    cv::warpAffine(self->mat, UNWRAP_OBJ(Matrix, dst)->mat, rotMatrix->mat, resSize);
+    return info.GetReturnValue().Set(dst);
+  }
+
   cv::warpAffine(self->mat, res, rotMatrix->mat, resSize);
   ~self->mat;
   self->mat = res;
@@ -1984,6 +3032,17 @@ NAN_METHOD(Matrix::WarpAffine) {
 NAN_METHOD(Matrix::PyrDown) {
   SETUP_FUNCTION(Matrix)
 
+  Local<Object> dst;
+  try {
+    dst = DstArgument(info, 0, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (!dst.IsEmpty()) {
+    cv::pyrDown(self->mat, UNWRAP_OBJ(Matrix, dst)->mat);
+    return info.GetReturnValue().Set(dst);
+  }
+
   cv::pyrDown(self->mat, self->mat);
   return;
 }
@@ -1991,6 +3050,17 @@ NAN_METHOD(Matrix::PyrDown) {
 NAN_METHOD(Matrix::PyrUp) {
   SETUP_FUNCTION(Matrix)
 
+  Local<Object> dst;
+  try {
+    dst = DstArgument(info, 0, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (!dst.IsEmpty()) {
+    cv::pyrUp(self->mat, UNWRAP_OBJ(Matrix, dst)->mat);
+    return info.GetReturnValue().Set(dst);
+  }
+
   cv::pyrUp(self->mat, self->mat);
   return;
 }
@@ -2056,7 +3126,15 @@ NAN_METHOD(Matrix::Threshold) {
   double maxVal = info[1]->NumberValue();
   int typ = cv::THRESH_BINARY;
 
-  if (info.Length() >= 3) {
+  Local<Object> img_to_return;
+  try {
+    img_to_return = DstArgument(info, 2, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  int argc = info.Length() - !img_to_return.IsEmpty();
+
+  if (argc >= 3) {
     Nan::Utf8String typstr(info[2]);
 
     if (strcmp(*typstr, "Binary") == 0) {
@@ -2091,7 +3169,7 @@ NAN_METHOD(Matrix::Threshold) {
     }
   }
 
-  if (info.Length() >= 4) {
+  if (argc >= 4) {
     Nan::Utf8String algorithm(info[3]);
 
     if (strcmp(*algorithm, "Simple") == 0) {
@@ -2115,10 +3193,10 @@ NAN_METHOD(Matrix::Threshold) {
     }
   }
 
-  Local < Object > img_to_return =
-      Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
+  if (img_to_return.IsEmpty()) {
+    img_to_return = NewInstance();
+  }
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(img_to_return);
-  self->mat.copyTo(img->mat);
 
   cv::threshold(self->mat, img->mat, threshold, maxVal, typ);
 
@@ -2228,64 +3306,81 @@ NAN_METHOD(Matrix::ConvertTo) {
   return;
 }
 
-// @author SergeMv
-// Does in-place color transformation
-// img.cvtColor('CV_BGR2YCrCb');
-NAN_METHOD(Matrix::CvtColor) {
-  Nan::HandleScope scope;
-
-  Matrix * self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
-  if (info.Length() < 1) {
-    Nan::ThrowTypeError("Invalid number of arguments");
-  }
-
-  // Get transform string
-  v8::String::Utf8Value str (info[0]->ToString());
-  std::string str2 = std::string(*str);
-  const char * sTransform = (const char *) str2.c_str();
-  int iTransform;
-
+// Maps the name of a color conversion code (e.g. "CV_BGR2GRAY") to its value,
+// or returns -1 when the conversion is not supported.
+int getColorConversionCode(const char *sTransform) {
   if (!strcmp(sTransform, "CV_BGR2GRAY")) {
-    iTransform = CV_BGR2GRAY;
+    return CV_BGR2GRAY;
   } else if (!strcmp(sTransform, "CV_GRAY2BGR")) {
-    iTransform = CV_GRAY2BGR;
+    return CV_GRAY2BGR;
   } else if (!strcmp(sTransform, "CV_BGR2XYZ")) {
-    iTransform = CV_BGR2XYZ;
+    return CV_BGR2XYZ;
   } else if (!strcmp(sTransform, "CV_XYZ2BGR")) {
-    iTransform = CV_XYZ2BGR;
+    return CV_XYZ2BGR;
   } else if (!strcmp(sTransform, "CV_BGR2YCrCb")) {
-    iTransform = CV_BGR2YCrCb;
+    return CV_BGR2YCrCb;
   } else if (!strcmp(sTransform, "CV_YCrCb2BGR")) {
-    iTransform = CV_YCrCb2BGR;
+    return CV_YCrCb2BGR;
   } else if (!strcmp(sTransform, "CV_BGR2HSV")) {
-    iTransform = CV_BGR2HSV;
+    return CV_BGR2HSV;
   } else if (!strcmp(sTransform, "CV_HSV2BGR")) {
-    iTransform = CV_HSV2BGR;
+    return CV_HSV2BGR;
   } else if (!strcmp(sTransform, "CV_BGR2HLS")) {
-    iTransform = CV_BGR2HLS;
+    return CV_BGR2HLS;
   } else if (!strcmp(sTransform, "CV_HLS2BGR")) {
-    iTransform = CV_HLS2BGR;
+    return CV_HLS2BGR;
   } else if (!strcmp(sTransform, "CV_BGR2Lab")) {
-    iTransform = CV_BGR2Lab;
+    return CV_BGR2Lab;
   } else if (!strcmp(sTransform, "CV_Lab2BGR")) {
-    iTransform = CV_Lab2BGR;
+    return CV_Lab2BGR;
   } else if (!strcmp(sTransform, "CV_BGR2Luv")) {
-    iTransform = CV_BGR2Luv;
+    return CV_BGR2Luv;
   } else if (!strcmp(sTransform, "CV_Luv2BGR")) {
-    iTransform = CV_Luv2BGR;
+    return CV_Luv2BGR;
   } else if (!strcmp(sTransform, "CV_BayerBG2BGR")) {
-    iTransform = CV_BayerBG2BGR;
+    return CV_BayerBG2BGR;
   } else if (!strcmp(sTransform, "CV_BayerGB2BGR")) {
-    iTransform = CV_BayerGB2BGR;
+    return CV_BayerGB2BGR;
   } else if (!strcmp(sTransform, "CV_BayerRG2BGR")) {
-    iTransform = CV_BayerRG2BGR;
+    return CV_BayerRG2BGR;
   } else if (!strcmp(sTransform, "CV_BayerGR2BGR")) {
-    iTransform = CV_BayerGR2BGR;
+    return CV_BayerGR2BGR;
   } else if (!strcmp(sTransform, "CV_BGR2RGB")) {
-    iTransform = CV_BGR2RGB;
-  } else {
-    iTransform = 0;  // to avoid compiler warning
-    Nan::ThrowTypeError("Conversion code is unsupported");
+    return CV_BGR2RGB;
+  }
+  return -1;
+}
+
+// @author SergeMv
+// Does in-place color transformation
+// img.cvtColor('CV_BGR2YCrCb');
+NAN_METHOD(Matrix::CvtColor) {
+  Nan::HandleScope scope;
+
+  Matrix * self = Nan::ObjectWrap::Unwrap<Matrix>(info.This());
+  if (info.Length() < 1) {
+    Nan::ThrowTypeError("Invalid number of arguments");
+  }
+
+  // Get transform string
+  v8::String::Utf8Value str (info[0]->ToString());
+  std::string str2 = std::string(*str);
+  const char * sTransform = (const char *) str2.c_str();
+  int iTransform = getColorConversionCode(sTransform);
+
+  if (iTransform < 0) {
+    return Nan::ThrowTypeError("Conversion code is unsupported");
+  }
+
+  Local<Object> dst;
+  try {
+    dst = DstArgument(info, 1, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (!dst.IsEmpty()) {
+    cv::cvtColor(self->mat, UNWRAP_OBJ(Matrix, dst)->mat, iTransform);
+    return info.GetReturnValue().Set(dst);
   }
 
   cv::cvtColor(self->mat, self->mat, iTransform);
@@ -2392,16 +3487,18 @@ NAN_METHOD(Matrix::FloodFill) {
 NAN_METHOD(Matrix::TemplateMatches) {
   SETUP_FUNCTION(Matrix)
 
+  int argc;
+  bool typed = TypedOutputRequested(info, argc);
   bool filter_min_probability =
-      (info.Length() >= 1) ? info[0]->IsNumber() : false;
+      (argc >= 1) ? info[0]->IsNumber() : false;
   bool filter_max_probability =
-      (info.Length() >= 2) ? info[1]->IsNumber() : false;
+      (argc >= 2) ? info[1]->IsNumber() : false;
   double min_probability = filter_min_probability ? info[0]->NumberValue() : 0;
   double max_probability = filter_max_probability ? info[1]->NumberValue() : 0;
-  int limit = (info.Length() >= 3) ? info[2]->IntegerValue() : 0;
-  bool ascending = (info.Length() >= 4) ? info[3]->BooleanValue() : false;
-  int min_x_distance = (info.Length() >= 5) ? info[4]->IntegerValue() : 0;
-  int min_y_distance = (info.Length() >= 6) ? info[5]->IntegerValue() : 0;
+  int limit = (argc >= 3) ? info[2]->IntegerValue() : 0;
+  bool ascending = (argc >= 4) ? info[3]->BooleanValue() : false;
+  int min_x_distance = (argc >= 5) ? info[4]->IntegerValue() : 0;
+  int min_y_distance = (argc >= 6) ? info[5]->IntegerValue() : 0;
 
   cv::Mat_<int> indices;
 
@@ -2414,7 +3511,12 @@ NAN_METHOD(Matrix::TemplateMatches) {
   }
 
   cv::Mat hit_mask = cv::Mat::zeros(self->mat.size(), CV_64F);
-  v8::Local < v8::Array > probabilites_array = Nan::New<v8::Array>(limit);
+  v8::Local < v8::Array > probabilites_array;
+  // x, y, probability per match
+  std::vector<float> matches;
+  if (!typed) {
+    probabilites_array = Nan::New<v8::Array>(limit);
+  }
 
   cv::Mat_<float>::const_iterator begin = self->mat.begin<float>();
   cv::Mat_<int>::const_iterator it = indices.begin();
@@ -2468,6 +3570,14 @@ NAN_METHOD(Matrix::TemplateMatches) {
       cv::rectangle(hit_mask, top_left, bottom_right, color, CV_FILLED);
     }
 
+    if (typed) {
+      matches.push_back(pt.x);
+      matches.push_back(pt.y);
+      matches.push_back(probability);
+      index++;
+      continue;
+    }
+
     Local<Value> x_value = Nan::New<Number>(pt.x);
     Local<Value> y_value = Nan::New<Number>(pt.y);
     Local<Value> probability_value = Nan::New<Number>(probability);
@@ -2481,6 +3591,11 @@ NAN_METHOD(Matrix::TemplateMatches) {
     index++;
   }
 
+  if (typed) {
+    info.GetReturnValue().Set(NewTypedArray<Float32Array>(matches));
+    return;
+  }
+
   info.GetReturnValue().Set(probabilites_array);
 }
 
@@ -2635,7 +3750,19 @@ NAN_METHOD(Matrix::WarpPerspective) {
     borderColor = setColor(objColor);
   }
 
-  cv::Mat res = cv::Mat(width, height, CV_32FC3);
+  Local<Object> dst;
+  try {
+    dst = DstArgument(info, 3, self->mat);
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (!dst.IsEmpty()) {
+    cv::warpPerspective(self->mat, UNWRAP_OBJ(Matrix, dst)->mat, xfrm->mat,
+        cv::Size(width, height), flags, borderMode, borderColor);
+    return info.GetReturnValue().Set(dst);
+  }
+
+  cv::Mat res;
 
   cv::warpPerspective(self->mat, res, xfrm->mat, cv::Size(width, height), flags,
       borderMode, borderColor);
@@ -13,21 +13,46 @@ public:
   static void Init(Local<Object> target);
   static NAN_METHOD(New);
 
+  // Buffer whose memory backs `mat` when created through fromBuffer()
+  Nan::Persistent<Object> buffer;
+
+  // Bytes of mat last reported to V8 with Nan::AdjustExternalMemory
+  int64_t externalBytes;
+  // The pixel buffer whose bytes are in externalBytes, NULL when mat has
+  // none or another matrix reports it
+  cv::UMatData *countedData;
+  // Stops reporting countedData, letting another matrix sharing it take over
+  void ReleaseCountedData();
+  // Whether this is queued for a SyncExternalMemory, see MemoryChanged
+  bool syncPending;
+  // Reports any change in the size of mat since the last call, returning it
+  int64_t SyncExternalMemory();
+  // Marks m for a SyncExternalMemory when its mat was changed outside of a
+  // Matrix method, e.g. when an async operation completes
+  static void MemoryChanged(Matrix *m);
+  static NAN_METHOD(TrackedMethod);
+
   Matrix();
   Matrix(cv::Mat other, cv::Rect roi);
   Matrix(int rows, int cols);
   Matrix(int rows, int cols, int type);
   Matrix(int rows, int cols, int type, Local<Object> scalarObj);
+  ~Matrix();
 
   static Local<Object> NewInstance();
 
   static bool HasInstance(Local<Value> object);
 
+  // The optional destination Matrix of a transform, see Matrix.cc
+  static Local<Object> DstArgument(Nan::NAN_METHOD_ARGS_TYPE info, int minArgs,
+      const cv::Mat &src);
+
   static double DblGet(cv::Mat mat, int i, int j);
 
   JSFUNC(Zeros)  // factory
   JSFUNC(Ones)  // factory
   JSFUNC(Eye)  // factory
+  JSFUNC(FromBuffer)  // factory
 
   JSFUNC(SetTo)
 
@@ -36,6 +61,9 @@ public:
   JSFUNC(Put)
 
   JSFUNC(GetData)
+  JSFUNC(GetDataView)
+  JSFUNC(ReadRegion)
+  JSFUNC(WriteRegion)
   JSFUNC(Normalize)
   JSFUNC(Brightness)
   JSFUNC(Norm)
@@ -62,6 +90,7 @@ public:
 
   JSFUNC(ToBuffer)
   JSFUNC(ToBufferAsync)
+  JSFUNC(EncodeRenditions)
 
   JSFUNC(Resize)
   JSFUNC(Rotate)
@@ -0,0 +1,822 @@
+#include "MatrixOp.h"
+#include "Matrix.h"
+#include "Contours.h"
+#include "Size.h"
+#include "Profiler.h"
+#include <nan.h>
+
+cv::Scalar setColor(Local<Object> objColor);
+int getColorConversionCode(const char *sTransform);
+void adjustBrightness(const cv::Mat &src, cv::Mat &dst, double alpha, double beta);
+
+Local<Value> MatrixOp::Result(Local<Object> matrix, cv::Mat &dst) {
+  if (inPlace) {
+    Matrix *m = UNWRAP_OBJ(Matrix, matrix);
+    m->mat = dst;
+    Matrix::MemoryChanged(m);
+    return matrix;
+  }
+
+  Local<Object> out = Matrix::NewInstance();
+  UNWRAP_OBJ(Matrix, out)->mat = dst;
+  return out;
+}
+
+// The operations below take the same arguments as the synchronous Matrix
+// methods of the same name.
+
+class ConvertGrayscaleOp: public MatrixOp {
+public:
+  ConvertGrayscaleOp(const int &argc, Local<Value> argv[]) {}
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    if (src.channels() != 3) {
+      throw "Image is no 3-channel";
+    }
+    cv::cvtColor(src, dst, CV_BGR2GRAY);
+  }
+};
+
+class ConvertHSVscaleOp: public MatrixOp {
+public:
+  ConvertHSVscaleOp(const int &argc, Local<Value> argv[]) {}
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    if (src.channels() != 3) {
+      throw "Image is no 3-channel";
+    }
+    cv::cvtColor(src, dst, CV_BGR2HSV);
+  }
+};
+
+class CvtColorOp: public MatrixOp {
+public:
+  CvtColorOp(const int &argc, Local<Value> argv[]) {
+    if (argc < 1) {
+      throw "Invalid number of arguments";
+    }
+    code = getColorConversionCode(*Nan::Utf8String(argv[0]));
+    if (code < 0) {
+      throw "Conversion code is unsupported";
+    }
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::cvtColor(src, dst, code);
+  }
+
+private:
+  int code;
+};
+
+class BrightnessOp: public MatrixOp {
+public:
+  BrightnessOp(const int &argc, Local<Value> argv[]) : alpha(1), beta(0) {
+    if (argc == 2 && argv[0]->IsNumber() && argv[1]->IsNumber()) {
+      alpha = argv[0]->NumberValue();
+      beta = argv[1]->NumberValue();
+    } else if (argc == 1 && argv[0]->IsNumber()) {
+      beta = argv[0]->NumberValue();
+    } else {
+      throw "Matrix.brightness takes (alpha, beta) or (diff)";
+    }
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    adjustBrightness(src, dst, alpha, beta);
+  }
+
+private:
+  double alpha;
+  double beta;
+};
+
+class GaussianBlurOp: public MatrixOp {
+public:
+  GaussianBlurOp(const int &argc, Local<Value> argv[]) : ksize(5, 5), sigma(0) {
+    if (argc > 0) {
+      if (!argv[0]->IsArray()) {
+        throw "'ksize' argument must be a 2 double array";
+      }
+      Local<Object> array = argv[0]->ToObject();
+      Local<Value> x = array->Get(0);
+      Local<Value> y = array->Get(1);
+      if (!x->IsNumber() || !y->IsNumber()) {
+        throw "'ksize' argument must be a 2 double array";
+      }
+      ksize = cv::Size(x->NumberValue(), y->NumberValue());
+      if (argc > 1 && argv[1]->IsNumber()) {
+        sigma = argv[1]->NumberValue();
+      }
+    }
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::GaussianBlur(src, dst, ksize, sigma);
+  }
+
+private:
+  cv::Size ksize;
+  double sigma;
+};
+
+class MedianBlurOp: public MatrixOp {
+public:
+  MedianBlurOp(const int &argc, Local<Value> argv[]) {
+    if (argc < 1 || !argv[0]->IsNumber() || (argv[0]->IntegerValue() % 2) == 0) {
+      throw "'ksize' argument must be a positive odd integer";
+    }
+    ksize = argv[0]->IntegerValue();
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::medianBlur(src, dst, ksize);
+  }
+
+private:
+  int ksize;
+};
+
+class BilateralFilterOp: public MatrixOp {
+public:
+  BilateralFilterOp(const int &argc, Local<Value> argv[]) :
+      d(15), sigmaColor(80), sigmaSpace(80), borderType(cv::BORDER_DEFAULT) {
+    if (argc != 0) {
+      if (argc < 3 || argc > 4) {
+        throw "BilateralFilter takes 0, 3, or 4 arguments";
+      }
+      d = argv[0]->IntegerValue();
+      sigmaColor = argv[1]->NumberValue();
+      sigmaSpace = argv[2]->NumberValue();
+      if (argc == 4) {
+        borderType = argv[3]->IntegerValue();
+      }
+    }
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::bilateralFilter(src, dst, d, sigmaColor, sigmaSpace, borderType);
+  }
+
+private:
+  int d;
+  double sigmaColor;
+  double sigmaSpace;
+  int borderType;
+};
+
+class CannyOp: public MatrixOp {
+public:
+  CannyOp(const int &argc, Local<Value> argv[]) {
+    if (argc < 2) {
+      throw "Canny requires low and high threshold arguments";
+    }
+    lowThresh = argv[0]->NumberValue();
+    highThresh = argv[1]->NumberValue();
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::Canny(src, dst, lowThresh, highThresh);
+  }
+
+private:
+  int lowThresh;
+  int highThresh;
+};
+
+class MorphologyOp: public MatrixOp {
+public:
+  MorphologyOp(const int &argc, Local<Value> argv[]) {
+    niters = argc > 0 ? argv[0]->NumberValue() : 0;
+    if (argc > 1 && Matrix::HasInstance(argv[1])) {
+      kernel = UNWRAP_OBJ(Matrix, argv[1]->ToObject())->mat;
+    }
+  }
+
+protected:
+  int niters;
+  cv::Mat kernel;
+};
+
+class DilateOp: public MorphologyOp {
+public:
+  DilateOp(const int &argc, Local<Value> argv[]) : MorphologyOp(argc, argv) {}
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::dilate(src, dst, kernel, cv::Point(-1, -1), niters);
+  }
+};
+
+class ErodeOp: public MorphologyOp {
+public:
+  ErodeOp(const int &argc, Local<Value> argv[]) : MorphologyOp(argc, argv) {}
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::erode(src, dst, kernel, cv::Point(-1, -1), niters);
+  }
+};
+
+class EqualizeHistOp: public MatrixOp {
+public:
+  EqualizeHistOp(const int &argc, Local<Value> argv[]) {}
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::equalizeHist(src, dst);
+  }
+};
+
+class PyrDownOp: public MatrixOp {
+public:
+  PyrDownOp(const int &argc, Local<Value> argv[]) {}
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::pyrDown(src, dst);
+  }
+};
+
+class PyrUpOp: public MatrixOp {
+public:
+  PyrUpOp(const int &argc, Local<Value> argv[]) {}
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::pyrUp(src, dst);
+  }
+};
+
+class RotateOp: public MatrixOp {
+public:
+  RotateOp(const int &argc, Local<Value> argv[]) : hasCenter(false) {
+    if (argc < 1) {
+      throw "Rotate requires an angle argument";
+    }
+    angle = argv[0]->NumberValue();
+    rightOrStraight = (ceil(angle) == angle) && (!((int)angle % 90)) && (argc == 1);
+    if (argc > 2 && !argv[1]->IsUndefined()) {
+      hasCenter = true;
+      center = cv::Point(argv[1]->Uint32Value(), argv[2]->Uint32Value());
+    }
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    if (rightOrStraight) {
+      int angle2 = ((int)angle) % 360;
+      if (angle2 < 0) {angle2 += 360;}
+      if (!angle2) {
+        dst = src;
+        return;
+      }
+      cv::Mat res;
+      if (angle2 % 180) {
+        cv::transpose(src, res);
+      } else {
+        res = src;
+      }
+      int mode = -1;
+      if (angle2 == 90) {mode = 0;}
+      if (angle2 == 270) {mode = 1;}
+      cv::flip(res, dst, mode);
+      return;
+    }
+
+    cv::Point c = hasCenter ? center :
+        cv::Point(round(src.size().width / 2), round(src.size().height / 2));
+    cv::warpAffine(src, dst, cv::getRotationMatrix2D(c, angle, 1.0), src.size());
+  }
+
+private:
+  float angle;
+  bool rightOrStraight;
+  bool hasCenter;
+  cv::Point center;
+};
+
+class WarpAffineOp: public MatrixOp {
+public:
+  WarpAffineOp(const int &argc, Local<Value> argv[]) : dstRows(-1), dstCols(-1) {
+    if (argc < 1 || !Matrix::HasInstance(argv[0])) {
+      throw "Argument 1 must be a Matrix";
+    }
+    rotMatrix = UNWRAP_OBJ(Matrix, argv[0]->ToObject())->mat;
+    if (argc > 1 && !argv[1]->IsUndefined()) {
+      dstRows = argv[1]->Uint32Value();
+    }
+    if (argc > 2 && !argv[2]->IsUndefined()) {
+      dstCols = argv[2]->Uint32Value();
+    }
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::Size resSize = cv::Size(dstRows < 0 ? src.rows : dstRows,
+        dstCols < 0 ? src.cols : dstCols);
+    cv::warpAffine(src, dst, rotMatrix, resSize);
+  }
+
+private:
+  cv::Mat rotMatrix;
+  int dstRows;
+  int dstCols;
+};
+
+class WarpPerspectiveOp: public MatrixOp {
+public:
+  WarpPerspectiveOp(const int &argc, Local<Value> argv[]) : borderColor(0, 0, 255) {
+    if (argc < 3 || !Matrix::HasInstance(argv[0])) {
+      throw "warpPerspective requires a Matrix, width and height";
+    }
+    xfrm = UNWRAP_OBJ(Matrix, argv[0]->ToObject())->mat;
+    width = argv[1]->IntegerValue();
+    height = argv[2]->IntegerValue();
+    if (argc > 3 && argv[3]->IsArray()) {
+      borderColor = setColor(argv[3]->ToObject());
+    }
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::warpPerspective(src, dst, xfrm, cv::Size(width, height),
+        cv::INTER_LINEAR, cv::BORDER_REPLICATE, borderColor);
+  }
+
+private:
+  cv::Mat xfrm;
+  int width;
+  int height;
+  cv::Scalar borderColor;
+};
+
+class InRangeOp: public MatrixOp {
+public:
+  InRangeOp(const int &argc, Local<Value> argv[]) : apply(false) {
+    if (argc > 1 && argv[0]->IsArray() && argv[1]->IsArray()) {
+      apply = true;
+      lowerb = setColor(argv[0]->ToObject());
+      upperb = setColor(argv[1]->ToObject());
+    }
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    if (!apply) {
+      dst = src;
+      return;
+    }
+    cv::inRange(src, lowerb, upperb, dst);
+  }
+
+private:
+  bool apply;
+  cv::Scalar lowerb;
+  cv::Scalar upperb;
+};
+
+class ResizeOp: public MatrixOp {
+public:
+  ResizeOp(const int &argc, Local<Value> argv[]) :
+      MatrixOp(false), fx(0), fy(0), interpolation(cv::INTER_LINEAR) {
+    if (argc < 1) {
+      throw "Matrix.resize requires at least 1 argument";
+    }
+    size = Size::RawSize(1, argv);
+    if (size.area() == 0) {
+      throw "Area of size must be > 0";
+    }
+    if (argc > 1 && argv[1]->IsNumber()) {
+      fx = argv[1]->NumberValue();
+    }
+    if (argc > 2 && argv[2]->IsNumber()) {
+      fy = argv[2]->NumberValue();
+    }
+    if (argc > 3 && argv[3]->IsNumber()) {
+      interpolation = argv[3]->Int32Value();
+    }
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::resize(src, dst, size, fx, fy, interpolation);
+  }
+
+private:
+  cv::Size size;
+  double fx;
+  double fy;
+  int interpolation;
+};
+
+class FlipOp: public MatrixOp {
+public:
+  FlipOp(const int &argc, Local<Value> argv[]) : MatrixOp(false) {
+    if (argc < 1 || !argv[0]->IsInt32()) {
+      throw "Flip requires an integer flipCode argument "
+          "(0 = X axis, positive = Y axis, negative = both axis)";
+    }
+    flipCode = argv[0]->Int32Value();
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::flip(src, dst, flipCode);
+  }
+
+private:
+  int flipCode;
+};
+
+class SobelOp: public MatrixOp {
+public:
+  SobelOp(const int &argc, Local<Value> argv[]) :
+      MatrixOp(false), ksize(3), scale(1), delta(0), borderType(cv::BORDER_DEFAULT) {
+    if (argc < 3) {
+      throw "Need more arguments: sobel(ddepth, xorder, yorder, ksize=3, scale=1.0, delta=0.0, borderType=CV_BORDER_DEFAULT)";
+    }
+    ddepth = argv[0]->IntegerValue();
+    xorder = argv[1]->IntegerValue();
+    yorder = argv[2]->IntegerValue();
+    if (argc > 3) ksize = argv[3]->IntegerValue();
+    if (argc > 4) scale = argv[4]->NumberValue();
+    if (argc > 5) delta = argv[5]->NumberValue();
+    if (argc > 6) borderType = argv[6]->IntegerValue();
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::Sobel(src, dst, ddepth, xorder, yorder, ksize, scale, delta, borderType);
+  }
+
+private:
+  int ddepth;
+  int xorder;
+  int yorder;
+  int ksize;
+  double scale;
+  double delta;
+  int borderType;
+};
+
+class AdaptiveThresholdOp: public MatrixOp {
+public:
+  AdaptiveThresholdOp(const int &argc, Local<Value> argv[]) : MatrixOp(false) {
+    if (argc < 5) {
+      throw "adaptiveThreshold requires 5 arguments";
+    }
+    maxVal = argv[0]->NumberValue();
+    adaptiveMethod = argv[1]->NumberValue();
+    thresholdType = argv[2]->NumberValue();
+    blockSize = argv[3]->NumberValue();
+    C = argv[4]->NumberValue();
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::adaptiveThreshold(src, dst, maxVal, adaptiveMethod, thresholdType,
+        blockSize, C);
+  }
+
+private:
+  double maxVal;
+  double adaptiveMethod;
+  double thresholdType;
+  double blockSize;
+  double C;
+};
+
+class MatchTemplateOp: public MatrixOp {
+public:
+  MatchTemplateOp(const int &argc, Local<Value> argv[]) : MatrixOp(false) {
+    if (argc < 2) {
+      throw "Matrix.matchTemplate requires at least 2 arguments";
+    }
+    if (!Matrix::HasInstance(argv[0])) {
+      throw "Argument 1 must be a Matrix";
+    }
+    if (!argv[1]->IsInt32()) {
+      throw "Argument 2 must be a number";
+    }
+    templ = UNWRAP_OBJ(Matrix, argv[0]->ToObject())->mat;
+    method = argv[1]->Int32Value();
+    if (argc > 2 && Matrix::HasInstance(argv[2])) {
+      mask = UNWRAP_OBJ(Matrix, argv[2]->ToObject())->mat;
+    }
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+#if CV_MAJOR_VERSION < 3
+    cv::matchTemplate(src, templ, dst, method);
+#else
+    if (mask.empty()) {
+      cv::matchTemplate(src, templ, dst, method);
+    } else {
+      cv::matchTemplate(src, templ, dst, method, mask);
+    }
+#endif
+  }
+
+private:
+  cv::Mat templ;
+  int method;
+  cv::Mat mask;
+};
+
+class FindContoursOp: public MatrixOp {
+public:
+  FindContoursOp(const int &argc, Local<Value> argv[]) :
+      MatrixOp(false), mode(CV_RETR_LIST), chain(CV_CHAIN_APPROX_SIMPLE) {
+    if (argc > 0 && argv[0]->IsNumber()) mode = argv[0]->IntegerValue();
+    if (argc > 1 && argv[1]->IsNumber()) chain = argv[1]->IntegerValue();
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    // findContours modifies its input, so work on a copy rather than on
+    // pixels the main thread can still see.
+    dst = src.clone();
+    cv::findContours(dst, contours, hierarchy, mode, chain);
+  }
+
+  bool ReturnsMatrix() const {
+    return false;
+  }
+
+  Local<Value> Result(Local<Object> matrix, cv::Mat &dst) {
+    Local<Object> out = Nan::NewInstance(Nan::GetFunction(Nan::New(Contour::constructor)).ToLocalChecked()).ToLocalChecked();
+    Contour *c = UNWRAP_OBJ(Contour, out);
+    c->contours.swap(contours);
+    c->hierarchy.swap(hierarchy);
+    c->SyncExternalMemory();
+    return out;
+  }
+
+private:
+  int mode;
+  int chain;
+  std::vector<std::vector<cv::Point> > contours;
+  std::vector<cv::Vec4i> hierarchy;
+};
+
+class HoughLinesPOp: public MatrixOp {
+public:
+  HoughLinesPOp(const int &argc, Local<Value> argv[]) : MatrixOp(false) {
+    rho = argc < 1 ? 1 : argv[0]->NumberValue();
+    theta = argc < 2 ? CV_PI/180 : argv[1]->NumberValue();
+    threshold = argc < 3 ? 80 : argv[2]->Uint32Value();
+    minLineLength = argc < 4 ? 30 : argv[3]->NumberValue();
+    maxLineGap = argc < 5 ? 10 : argv[4]->NumberValue();
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::equalizeHist(src, dst);
+    cv::HoughLinesP(dst, lines, rho, theta, threshold, minLineLength, maxLineGap);
+  }
+
+  bool ReturnsMatrix() const {
+    return false;
+  }
+
+  Local<Value> Result(Local<Object> matrix, cv::Mat &dst) {
+    Local<Array> arr = Nan::New<Array>(lines.size());
+    for (unsigned int i = 0; i < lines.size(); i++) {
+      Local<Array> pt = Nan::New<Array>(4);
+      pt->Set(0, Nan::New<Number>((double) lines[i][0]));
+      pt->Set(1, Nan::New<Number>((double) lines[i][1]));
+      pt->Set(2, Nan::New<Number>((double) lines[i][2]));
+      pt->Set(3, Nan::New<Number>((double) lines[i][3]));
+      arr->Set(i, pt);
+    }
+    return arr;
+  }
+
+private:
+  double rho;
+  double theta;
+  int threshold;
+  double minLineLength;
+  double maxLineGap;
+  std::vector<cv::Vec4i> lines;
+};
+
+class HoughCirclesOp: public MatrixOp {
+public:
+  HoughCirclesOp(const int &argc, Local<Value> argv[]) : MatrixOp(false) {
+    dp = argc < 1 ? 1 : argv[0]->NumberValue();
+    minDist = argc < 2 ? 1 : argv[1]->NumberValue();
+    higherThreshold = argc < 3 ? 100 : argv[2]->NumberValue();
+    accumulatorThreshold = argc < 4 ? 100 : argv[3]->NumberValue();
+    minRadius = argc < 5 ? 0 : argv[4]->Uint32Value();
+    maxRadius = argc < 6 ? 0 : argv[5]->Uint32Value();
+  }
+
+  void Execute(const cv::Mat &src, cv::Mat &dst) {
+    cv::equalizeHist(src, dst);
+    cv::HoughCircles(dst, circles, CV_HOUGH_GRADIENT, dp, minDist,
+        higherThreshold, accumulatorThreshold, minRadius, maxRadius);
+  }
+
+  bool ReturnsMatrix() const {
+    return false;
+  }
+
+  Local<Value> Result(Local<Object> matrix, cv::Mat &dst) {
+    Local<Array> arr = Nan::New<Array>(circles.size());
+    for (unsigned int i = 0; i < circles.size(); i++) {
+      Local<Array> pt = Nan::New<Array>(3);
+      pt->Set(0, Nan::New<Number>((double) circles[i][0]));  // center x
+      pt->Set(1, Nan::New<Number>((double) circles[i][1]));  // center y
+      pt->Set(2, Nan::New<Number>((double) circles[i][2]));  // radius
+      arr->Set(i, pt);
+    }
+    return arr;
+  }
+
+private:
+  double dp;
+  double minDist;
+  double higherThreshold;
+  double accumulatorThreshold;
+  int minRadius;
+  int maxRadius;
+  std::vector<cv::Vec3f> circles;
+};
+
+template <class T>
+static MatrixOp *CreateOp(const int &argc, Local<Value> argv[]) {
+  return new T(argc, argv);
+}
+
+struct MatrixOpEntry {
+  const char *name;
+  MatrixOp *(*create)(const int &argc, Local<Value> argv[]);
+};
+
+static const MatrixOpEntry ops[] = {
+  {"convertGrayscale", CreateOp<ConvertGrayscaleOp>},
+  {"convertHSVscale", CreateOp<ConvertHSVscaleOp>},
+  {"cvtColor", CreateOp<CvtColorOp>},
+  {"brightness", CreateOp<BrightnessOp>},
+  {"gaussianBlur", CreateOp<GaussianBlurOp>},
+  {"medianBlur", CreateOp<MedianBlurOp>},
+  {"bilateralFilter", CreateOp<BilateralFilterOp>},
+  {"canny", CreateOp<CannyOp>},
+  {"dilate", CreateOp<DilateOp>},
+  {"erode", CreateOp<ErodeOp>},
+  {"equalizeHist", CreateOp<EqualizeHistOp>},
+  {"pyrDown", CreateOp<PyrDownOp>},
+  {"pyrUp", CreateOp<PyrUpOp>},
+  {"rotate", CreateOp<RotateOp>},
+  {"warpAffine", CreateOp<WarpAffineOp>},
+  {"warpPerspective", CreateOp<WarpPerspectiveOp>},
+  {"inRange", CreateOp<InRangeOp>},
+  {"resize", CreateOp<ResizeOp>},
+  {"flip", CreateOp<FlipOp>},
+  {"sobel", CreateOp<SobelOp>},
+  {"adaptiveThreshold", CreateOp<AdaptiveThresholdOp>},
+  {"matchTemplate", CreateOp<MatchTemplateOp>},
+  {"findContours", CreateOp<FindContoursOp>},
+  {"houghLinesP", CreateOp<HoughLinesPOp>},
+  {"houghCircles", CreateOp<HoughCirclesOp>}
+};
+
+static const int opCount = sizeof(ops) / sizeof(ops[0]);
+
+MatrixOp *MatrixOp::Create(const std::string &name, const int &argc, Local<Value> argv[]) {
+  for (int i = 0; i < opCount; i++) {
+    if (name == ops[i].name) {
+      return ops[i].create(argc, argv);
+    }
+  }
+  return NULL;
+}
+
+Local<Array> MatrixOp::Names() {
+  Local<Array> names = Nan::New<Array>(opCount);
+  for (int i = 0; i < opCount; i++) {
+    names->Set(i, Nan::New(ops[i].name).ToLocalChecked());
+  }
+  return names;
+}
+
+// cv.stats() ids of the worker side of each operation, by index in ops
+static int profilerOps[opCount];
+
+void MatrixOp::Init(Local<FunctionTemplate> ctor) {
+  for (int i = 0; i < opCount; i++) {
+    std::string method = std::string(ops[i].name) + "Async";
+    profilerOps[i] = Profiler::Register("Matrix." + method + ":worker");
+    Nan::SetPrototypeMethod(ctor, method.c_str(), Dispatch,
+        Nan::New<External>((void *) &ops[i]));
+  }
+}
+
+class AsyncMatrixWorker: public Nan::AsyncWorker {
+public:
+  AsyncMatrixWorker(Nan::Callback *callback, MatrixOp *op, const cv::Mat &src,
+      int profilerOp) :
+      Nan::AsyncWorker(callback),
+      op(op),
+      src(src),
+      queuedAt(Profiler::Now()),
+      profilerOp(profilerOp) {
+  }
+
+  ~AsyncMatrixWorker() {
+    delete op;
+  }
+
+  void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
+    try {
+      op->Execute(src, dst);
+      timer.bytes = dst.dataend - dst.datastart;
+    } catch (cv::Exception& e) {
+      SetErrorMessage(e.what());
+    } catch (const char *msg) {
+      SetErrorMessage(msg);
+    }
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    Local<Object> matrix = GetFromPersistent("matrix").As<Object>();
+    Local<Value> result = op->Result(matrix, dst);
+
+    if (callback) {
+      Local<Value> argv[] = {
+        Nan::Null(),
+        result
+      };
+
+      Nan::TryCatch try_catch;
+      callback->Call(2, argv);
+      if (try_catch.HasCaught()) {
+        Nan::FatalException(try_catch);
+      }
+    } else {
+      Local<Promise::Resolver> resolver = GetFromPersistent("resolver").As<Promise::Resolver>();
+      resolver->Resolve(Nan::GetCurrentContext(), result);
+      Isolate::GetCurrent()->RunMicrotasks();
+    }
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+
+    Local<Value> error = Nan::Error(ErrorMessage());
+
+    if (callback) {
+      Local<Value> argv[] = {
+        error
+      };
+
+      Nan::TryCatch try_catch;
+      callback->Call(1, argv);
+      if (try_catch.HasCaught()) {
+        Nan::FatalException(try_catch);
+      }
+    } else {
+      Local<Promise::Resolver> resolver = GetFromPersistent("resolver").As<Promise::Resolver>();
+      resolver->Reject(Nan::GetCurrentContext(), error);
+      Isolate::GetCurrent()->RunMicrotasks();
+    }
+  }
+
+private:
+  MatrixOp *op;
+  cv::Mat src;
+  cv::Mat dst;
+  uint64_t queuedAt;
+  int profilerOp;
+};
+
+// img.<name>Async(args..., [callback])
+// Runs the named operation on the thread pool. Returns a Promise unless a
+// callback is given as the last argument.
+NAN_METHOD(MatrixOp::Dispatch) {
+  SETUP_FUNCTION(Matrix)
+
+  const MatrixOpEntry *entry = static_cast<const MatrixOpEntry *>(info.Data().As<External>()->Value());
+
+  int argc = info.Length();
+  Local<Function> cb;
+  if (argc > 0 && info[argc - 1]->IsFunction()) {
+    cb = info[argc - 1].As<Function>();
+    argc--;
+  }
+
+  std::vector<Local<Value> > argv(argc);
+  for (int n = 0; n < argc; ++n) {
+    argv[n] = info[n];
+  }
+
+  MatrixOp *op;
+  try {
+    op = entry->create(argc, argv.data());
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+
+  Nan::Callback *callback = cb.IsEmpty() ? nullptr : new Nan::Callback(cb);
+  AsyncMatrixWorker *worker = new AsyncMatrixWorker(callback, op, self->mat,
+      profilerOps[entry - ops]);
+  worker->SaveToPersistent("matrix", info.This());
+
+  if (!callback) {
+    Local<Promise::Resolver> resolver = Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked();
+    worker->SaveToPersistent("resolver", resolver);
+    info.GetReturnValue().Set(resolver->GetPromise());
+  }
+
+  Nan::AsyncQueueWorker(worker);
+}
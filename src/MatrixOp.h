@@ -0,0 +1,44 @@
+#ifndef __NODE_MATRIXOP_H
+#define __NODE_MATRIXOP_H
+
+#include "OpenCV.h"
+
+/**
+ * A Matrix operation that can run off the main thread.
+ *
+ * The arguments are parsed from JS on the main thread when the operation is
+ * created, Execute() then runs on a worker thread and must not touch V8, and
+ * Result() converts the output back to JS on the main thread.
+ */
+class MatrixOp {
+public:
+  MatrixOp(bool inPlace = true) : inPlace(inPlace) {}
+  virtual ~MatrixOp() {}
+
+  virtual void Execute(const cv::Mat &src, cv::Mat &dst) = 0;
+
+  // In-place operations store dst back into the matrix and return it, the
+  // others return dst as a new Matrix, mirroring the synchronous methods.
+  virtual Local<Value> Result(Local<Object> matrix, cv::Mat &dst);
+
+  // False for operations such as findContours whose result is not an image,
+  // nothing can be chained after those in a Pipeline.
+  virtual bool ReturnsMatrix() const { return true; }
+
+  // Creates the named operation, or returns NULL if there is no such
+  // operation. Throws a const char* if the arguments are invalid.
+  static MatrixOp *Create(const std::string &name, const int &argc, Local<Value> argv[]);
+
+  // Names of all the operations
+  static Local<Array> Names();
+
+  // Adds a <name>Async method to the Matrix prototype for every operation
+  static void Init(Local<FunctionTemplate> ctor);
+
+  static NAN_METHOD(Dispatch);
+
+protected:
+  bool inPlace;
+};
+
+#endif
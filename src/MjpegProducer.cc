@@ -0,0 +1,370 @@
+#include "MjpegProducer.h"
+#include "VideoCaptureWrap.h"
+#include "Profiler.h"
+
+#include <algorithm>
+
+Nan::Persistent<FunctionTemplate> MjpegProducer::constructor;
+
+static int encodeProfilerOp;
+
+void MjpegProducer::Init(Local<Object> target) {
+  Nan::HandleScope scope;
+
+  encodeProfilerOp = Profiler::Register("MjpegProducer.encode:worker");
+
+  Local<FunctionTemplate> ctor = Nan::New<FunctionTemplate>(MjpegProducer::New);
+  constructor.Reset(ctor);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("MjpegProducer").ToLocalChecked());
+
+  Nan::SetPrototypeMethod(ctor, "start", Start);
+  Nan::SetPrototypeMethod(ctor, "stop", Stop);
+  Nan::SetPrototypeMethod(ctor, "setActive", SetActive);
+  Nan::SetPrototypeMethod(ctor, "boundary", Boundary);
+  Nan::SetPrototypeMethod(ctor, "stats", Stats);
+
+  target->Set(Nan::New("MjpegProducer").ToLocalChecked(), ctor->GetFunction());
+}
+
+// new cv.MjpegProducer(capture, [{quality: 80, minQuality: 30, maxWidth: 0,
+//     boundary: 'mjpegframe'}])
+// quality is where encoding starts and the most it goes back up to, and
+// minQuality the least it goes down to while subscribers are behind. Frames
+// wider than maxWidth, when it is set, are scaled down first.
+NAN_METHOD(MjpegProducer::New) {
+  Nan::HandleScope scope;
+
+  if (info.This()->InternalFieldCount() == 0) {
+    return Nan::ThrowTypeError("Cannot Instantiate without new");
+  }
+  if (info.Length() < 1 || !Nan::New(VideoCaptureWrap::constructor)->HasInstance(info[0])) {
+    return Nan::ThrowTypeError("Argument 1 must be a VideoCapture");
+  }
+
+  int quality = 80;
+  int minQuality = 30;
+  int maxWidth = 0;
+  std::string boundary = "mjpegframe";
+
+  if (info.Length() > 1 && info[1]->IsObject()) {
+    Local<Object> options = info[1]->ToObject();
+    Local<String> qualityKey = Nan::New("quality").ToLocalChecked();
+    Local<String> minQualityKey = Nan::New("minQuality").ToLocalChecked();
+    Local<String> maxWidthKey = Nan::New("maxWidth").ToLocalChecked();
+    Local<String> boundaryKey = Nan::New("boundary").ToLocalChecked();
+
+    if (Nan::Has(options, qualityKey).FromJust()) {
+      quality = Nan::Get(options, qualityKey).ToLocalChecked()->Int32Value();
+    }
+    if (Nan::Has(options, minQualityKey).FromJust()) {
+      minQuality = Nan::Get(options, minQualityKey).ToLocalChecked()->Int32Value();
+    }
+    if (Nan::Has(options, maxWidthKey).FromJust()) {
+      maxWidth = Nan::Get(options, maxWidthKey).ToLocalChecked()->Int32Value();
+    }
+    if (Nan::Has(options, boundaryKey).FromJust()) {
+      boundary = *Nan::Utf8String(Nan::Get(options, boundaryKey).ToLocalChecked());
+    }
+  }
+
+  if (quality < 1 || quality > 100 || minQuality < 1 || minQuality > quality) {
+    return Nan::ThrowTypeError("quality must be 1 to 100, and minQuality 1 to quality");
+  }
+  if (maxWidth < 0) {
+    return Nan::ThrowTypeError("maxWidth must be a positive number");
+  }
+  // RFC 2046 limits boundaries to 70 characters, and they go in a header
+  if (boundary.empty() || boundary.size() > 70 ||
+      boundary.find_first_of("\r\n") != std::string::npos) {
+    return Nan::ThrowTypeError("boundary must be 1 to 70 characters, on one line");
+  }
+
+  MjpegProducer *p = new MjpegProducer(UNWRAP_ARG(VideoCaptureWrap, 0));
+  p->capture.Reset(info[0]->ToObject());
+  p->boundary = boundary;
+  p->maxWidth = maxWidth;
+  p->minQuality = minQuality;
+  p->maxQuality = quality;
+  p->quality = quality;
+  p->Wrap(info.This());
+
+  info.GetReturnValue().Set(info.This());
+}
+
+MjpegProducer::MjpegProducer(VideoCaptureWrap *vc) :
+    vc(vc),
+    maxWidth(0),
+    minQuality(1),
+    maxQuality(100),
+    quality(100),
+    active(true),
+    calm(0),
+    stopping(false),
+    finished(false),
+    encoded(0),
+    delivered(0),
+    dropped(0),
+    async(NULL),
+    callback(NULL) {
+}
+
+// A started producer stays referenced until Deliver has joined its thread,
+// so there is never a thread left to stop here
+MjpegProducer::~MjpegProducer() {
+  if (async) {
+    uv_close(reinterpret_cast<uv_handle_t *>(async), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_async_t *>(handle);
+    });
+  }
+  delete callback;
+  capture.Reset();
+}
+
+void MjpegProducer::Run() {
+  cv::Mat frame;
+  cv::Mat scaled;
+  std::vector<uchar> jpeg;
+  std::vector<int> params(2);
+  params[0] = CV_IMWRITE_JPEG_QUALITY;
+
+  while (true) {
+    bool ok;
+    try {
+      if (grabber) {
+        ok = grabber->Pop(frame);
+      } else {
+        std::lock_guard<std::mutex> lock(vc->capMutex);
+        ok = vc->cap.read(frame);
+      }
+    } catch (cv::Exception &e) {
+      std::lock_guard<std::mutex> lock(mutex);
+      error = e.what();
+      break;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (stopping) {
+        break;
+      }
+    }
+    if (!ok || frame.empty()) {
+      // End of the file, or the device went away
+      break;
+    }
+    if (!active) {
+      // Nobody to send to, but the source is still drained so the next
+      // subscriber starts with a fresh frame
+      continue;
+    }
+
+    Chunk chunk = std::make_shared<std::vector<uchar> >();
+    {
+      Profiler::Timer timer(encodeProfilerOp);
+      try {
+        const cv::Mat *src = &frame;
+        if (maxWidth && frame.cols > maxWidth) {
+          int height = std::max(1, cvRound((double) frame.rows * maxWidth / frame.cols));
+          cv::resize(frame, scaled, cv::Size(maxWidth, height), 0, 0, cv::INTER_AREA);
+          src = &scaled;
+        }
+        params[1] = quality;
+        cv::imencode(".jpg", *src, jpeg, params);
+      } catch (cv::Exception &e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = e.what();
+        break;
+      }
+
+      // The part headers and the image in one block, ready to send
+      std::string header = "--" + boundary + "\r\nContent-Type: image/jpeg\r\n"
+          "Content-Length: " + std::to_string(jpeg.size()) + "\r\n\r\n";
+      chunk->reserve(header.size() + jpeg.size() + 2);
+      chunk->insert(chunk->end(), header.begin(), header.end());
+      chunk->insert(chunk->end(), jpeg.begin(), jpeg.end());
+      chunk->push_back('\r');
+      chunk->push_back('\n');
+      timer.bytes = chunk->size();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (pending) {
+        dropped++;
+      }
+      pending = chunk;
+      encoded++;
+    }
+    uv_async_send(async);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+  }
+  uv_async_send(async);
+}
+
+void MjpegProducer::Adapt(bool congested) {
+  // Drop quality quickly while anyone is behind, and recover it slowly
+  int q = quality;
+  if (congested) {
+    calm = 0;
+    quality = std::max(minQuality, q - 10);
+  } else if (++calm >= 30) {
+    calm = 0;
+    quality = std::min(maxQuality, q + 5);
+  }
+}
+
+// Frees a chunk once every Buffer view of it has been collected
+static void FreeChunk(char *data, void *hint) {
+  std::shared_ptr<std::vector<uchar> > *chunk =
+      static_cast<std::shared_ptr<std::vector<uchar> > *>(hint);
+  Nan::AdjustExternalMemory(-(int) (*chunk)->capacity());
+  delete chunk;
+}
+
+// Runs on the main thread with the newest chunk, and once the thread has
+// stopped
+void MjpegProducer::Deliver(uv_async_t *handle) {
+  Nan::HandleScope scope;
+  MjpegProducer *self = static_cast<MjpegProducer *>(handle->data);
+
+  Chunk chunk;
+  bool finished;
+  std::string error;
+  {
+    std::lock_guard<std::mutex> lock(self->mutex);
+    chunk.swap(self->pending);
+    finished = self->finished;
+    error = self->error;
+  }
+
+  if (chunk && self->callback) {
+    self->delivered++;
+    Nan::AdjustExternalMemory((int) chunk->capacity());
+    Local<Object> buf = Nan::NewBuffer((char *) chunk->data(), chunk->size(),
+        FreeChunk, new Chunk(chunk)).ToLocalChecked();
+
+    Local<Value> argv[] = {
+      Nan::Null(),
+      buf
+    };
+
+    // The callback returns true when a subscriber could not take the chunk
+    Nan::TryCatch try_catch;
+    Local<Value> congested = self->callback->Call(2, argv);
+    if (try_catch.HasCaught()) {
+      Nan::FatalException(try_catch);
+    } else {
+      self->Adapt(!congested.IsEmpty() && congested->IsTrue());
+    }
+  }
+
+  if (!finished || !self->async) {
+    return;
+  }
+
+  // The thread has set finished and is about to return, so this is quick
+  if (self->thread.joinable()) {
+    self->thread.join();
+  }
+  uv_close(reinterpret_cast<uv_handle_t *>(self->async), [](uv_handle_t *handle) {
+    delete reinterpret_cast<uv_async_t *>(handle);
+  });
+  self->async = NULL;
+  self->grabber.reset();
+  self->capture.Reset();
+
+  Nan::Callback *callback = self->callback;
+  self->callback = NULL;
+  if (callback) {
+    Local<Value> argv[] = {
+      error.empty() ? Local<Value>(Nan::Null()) : Nan::Error(error.c_str()),
+      Nan::Null()
+    };
+
+    Nan::TryCatch try_catch;
+    callback->Call(2, argv);
+    delete callback;
+    if (try_catch.HasCaught()) {
+      Nan::FatalException(try_catch);
+    }
+  }
+
+  // Last, as it may let the object be collected
+  self->Unref();
+}
+
+// producer.start(function(err, chunk) {})
+// Starts reading and encoding. The callback gets each multipart chunk as a
+// Buffer, and should return true when a subscriber could not take it, which
+// lowers the quality. At the end of the stream, or after stop(), it is called
+// once more with a null chunk. Uses the capture's background grabber when it
+// has one, see startGrabbing.
+NAN_METHOD(MjpegProducer::Start) {
+  SETUP_FUNCTION(MjpegProducer)
+
+  REQ_FUN_ARG(0, cb);
+
+  if (self->callback || self->finished) {
+    return Nan::ThrowError("MjpegProducer can only be started once");
+  }
+  if (!self->vc->cap.isOpened()) {
+    return Nan::ThrowError("VideoCapture is not open");
+  }
+
+  self->callback = new Nan::Callback(cb.As<Function>());
+  self->grabber = self->vc->grabber;
+
+  // Holds the loop open, and this object, until the thread has stopped
+  self->async = new uv_async_t();
+  self->async->data = self;
+  uv_async_init(uv_default_loop(), self->async, Deliver);
+  self->Ref();
+
+  self->thread = std::thread(&MjpegProducer::Run, self);
+}
+
+// producer.stop()
+// Asks the thread to stop, without waiting for it: a stalled live source can
+// keep a read blocked for long. The thread ends once that read returns, and
+// the start() callback then gets its final call from the event loop.
+NAN_METHOD(MjpegProducer::Stop) {
+  SETUP_FUNCTION(MjpegProducer)
+
+  std::lock_guard<std::mutex> lock(self->mutex);
+  self->stopping = true;
+}
+
+// producer.setActive(bool)
+// While inactive, frames are still read, so a live source does not back up,
+// but are not encoded.
+NAN_METHOD(MjpegProducer::SetActive) {
+  SETUP_FUNCTION(MjpegProducer)
+
+  self->active = info.Length() > 0 && info[0]->BooleanValue();
+}
+
+NAN_METHOD(MjpegProducer::Boundary) {
+  SETUP_FUNCTION(MjpegProducer)
+
+  info.GetReturnValue().Set(Nan::New(self->boundary).ToLocalChecked());
+}
+
+// Returns {encoded, delivered, dropped, quality}, where dropped counts the
+// chunks replaced by a newer one before the event loop took them.
+NAN_METHOD(MjpegProducer::Stats) {
+  SETUP_FUNCTION(MjpegProducer)
+
+  std::lock_guard<std::mutex> lock(self->mutex);
+  Local<Object> stats = Nan::New<Object>();
+  stats->Set(Nan::New("encoded").ToLocalChecked(), Nan::New<Number>(self->encoded));
+  stats->Set(Nan::New("delivered").ToLocalChecked(), Nan::New<Number>(self->delivered));
+  stats->Set(Nan::New("dropped").ToLocalChecked(), Nan::New<Number>(self->dropped));
+  stats->Set(Nan::New("quality").ToLocalChecked(), Nan::New<Number>(self->quality.load()));
+
+  info.GetReturnValue().Set(stats);
+}
@@ -0,0 +1,75 @@
+#ifndef __NODE_MJPEGPRODUCER_H
+#define __NODE_MJPEGPRODUCER_H
+
+#include "OpenCV.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class VideoCaptureWrap;
+class FrameGrabber;
+
+/**
+ * cv.MjpegProducer, turns a VideoCapture into multipart/x-mixed-replace
+ * chunks on its own thread.
+ *
+ * Each frame is read, scaled and JPEG encoded once, with the boundary and
+ * part headers around it, and handed to JS as a single Buffer for every
+ * subscriber to send. Only the newest chunk waits for the event loop; older
+ * ones are dropped. The JPEG quality goes down while subscribers fall behind
+ * and back up once they keep up.
+ */
+class MjpegProducer: public Nan::ObjectWrap {
+public:
+  static Nan::Persistent<FunctionTemplate> constructor;
+  static void Init(Local<Object> target);
+  static NAN_METHOD(New);
+
+  MjpegProducer(VideoCaptureWrap *vc);
+  ~MjpegProducer();
+
+  static NAN_METHOD(Start);
+  static NAN_METHOD(Stop);
+  static NAN_METHOD(SetActive);
+  static NAN_METHOD(Boundary);
+  static NAN_METHOD(Stats);
+
+private:
+  typedef std::shared_ptr<std::vector<uchar> > Chunk;
+
+  void Run();
+  // Called on the main thread with whether any subscriber was backed up
+  void Adapt(bool congested);
+  static void Deliver(uv_async_t *handle);
+
+  VideoCaptureWrap *vc;
+  Nan::Persistent<Object> capture;
+  std::shared_ptr<FrameGrabber> grabber;
+  std::string boundary;
+  int maxWidth;
+  int minQuality;
+  int maxQuality;
+  std::atomic<int> quality;
+  std::atomic<bool> active;
+  // Frames since a subscriber was last backed up
+  int calm;
+
+  std::thread thread;
+  std::mutex mutex;
+  // The newest chunk the main thread has not taken yet
+  Chunk pending;
+  bool stopping;
+  bool finished;
+  double encoded;
+  double delivered;
+  double dropped;
+  std::string error;
+
+  uv_async_t *async;
+  // Called with each chunk, then with (err, null) at the end
+  Nan::Callback *callback;
+};
+
+#endif
@@ -1,6 +1,11 @@
 #include "OpenCV.h"
 #include "Matrix.h"
+#include "Rect.h"
+#include "ImageHeader.h"
+#include "Profiler.h"
 #include <nan.h>
+#include <algorithm>
+#include <cmath>
 
 void OpenCV::Init(Local<Object> target) {
   Nan::HandleScope scope;
@@ -10,6 +15,139 @@ void OpenCV::Init(Local<Object> target) {
 
   Nan::SetMethod(target, "readImage", ReadImage);
   Nan::SetMethod(target, "readImageMulti", ReadImageMulti);
+  Nan::SetMethod(target, "probeImage", ProbeImage);
+}
+
+static int ReadImageProfilerOp() {
+  static int op = Profiler::Register("readImage:worker");
+  return op;
+}
+
+// The options of readImage
+struct ReadImageOptions {
+  int mode = cv::IMREAD_COLOR;
+  // When set, images larger than this on either side are scaled down to fit
+  int maxDim = 0;
+  // Decode at 1/reduce of the size, 1 for full size
+  int reduce = 1;
+  // Only keep this part of the image, in full size coordinates
+  bool hasCrop = false;
+  cv::Rect crop;
+};
+
+// The IMREAD_REDUCED_* modes arrived in OpenCV 3.2
+#if CV_MAJOR_VERSION > 3 || (CV_MAJOR_VERSION == 3 && CV_MINOR_VERSION >= 2)
+#define HAVE_IMREAD_REDUCED 1
+#endif
+
+// Whether the decoder can do the scaling in mode, see ReducedMode()
+static bool CanReduce(int mode) {
+#ifdef HAVE_IMREAD_REDUCED
+  return mode == cv::IMREAD_COLOR || mode == cv::IMREAD_GRAYSCALE;
+#else
+  return false;
+#endif
+}
+
+static int ReducedMode(int mode, int factor) {
+#ifdef HAVE_IMREAD_REDUCED
+  bool gray = mode == cv::IMREAD_GRAYSCALE;
+  switch (factor) {
+    case 2: return gray ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_REDUCED_COLOR_2;
+    case 4: return gray ? cv::IMREAD_REDUCED_GRAYSCALE_4 : cv::IMREAD_REDUCED_COLOR_4;
+    case 8: return gray ? cv::IMREAD_REDUCED_GRAYSCALE_8 : cv::IMREAD_REDUCED_COLOR_8;
+  }
+#endif
+  return mode;
+}
+
+// Parses {mode, maxDim, reduce, crop}, where mode is 'color', 'grayscale',
+// 'unchanged' or one of the cv.Constants.IMREAD_* flags. Throws a const char*
+// when invalid.
+static ReadImageOptions ParseReadImageOptions(Local<Object> object) {
+  ReadImageOptions options;
+
+  Local<String> modeKey = Nan::New("mode").ToLocalChecked();
+  Local<String> maxDimKey = Nan::New("maxDim").ToLocalChecked();
+  Local<String> reduceKey = Nan::New("reduce").ToLocalChecked();
+  Local<String> cropKey = Nan::New("crop").ToLocalChecked();
+
+  Local<Value> mode = Nan::Get(object, modeKey).ToLocalChecked();
+  if (mode->IsNumber()) {
+    options.mode = mode->Int32Value();
+  } else if (mode->IsString()) {
+    std::string name = *Nan::Utf8String(mode);
+    if (name == "color") {
+      options.mode = cv::IMREAD_COLOR;
+    } else if (name == "grayscale") {
+      options.mode = cv::IMREAD_GRAYSCALE;
+    } else if (name == "unchanged") {
+      options.mode = cv::IMREAD_UNCHANGED;
+    } else {
+      throw "mode must be 'color', 'grayscale', 'unchanged' or an IMREAD_* constant";
+    }
+  } else if (!mode->IsUndefined()) {
+    throw "mode must be 'color', 'grayscale', 'unchanged' or an IMREAD_* constant";
+  }
+
+  Local<Value> maxDim = Nan::Get(object, maxDimKey).ToLocalChecked();
+  if (maxDim->IsNumber()) {
+    options.maxDim = maxDim->Int32Value();
+    if (options.maxDim < 1) {
+      throw "maxDim must be a positive number";
+    }
+  } else if (!maxDim->IsUndefined()) {
+    throw "maxDim must be a positive number";
+  }
+
+  Local<Value> reduce = Nan::Get(object, reduceKey).ToLocalChecked();
+  if (!reduce->IsUndefined()) {
+    options.reduce = reduce->Int32Value();
+    if (options.reduce != 1 && options.reduce != 2 && options.reduce != 4 &&
+        options.reduce != 8) {
+      throw "reduce must be 1, 2, 4 or 8";
+    }
+    if (options.reduce > 1 && !CanReduce(options.mode)) {
+      throw "reduce needs mode 'color' or 'grayscale', and OpenCV 3.2 or later";
+    }
+  }
+
+  Local<Value> crop = Nan::Get(object, cropKey).ToLocalChecked();
+  if (!crop->IsUndefined()) {
+    options.crop = Rect::RawRect(1, &crop);
+    if (options.crop.x < 0 || options.crop.y < 0 || options.crop.area() <= 0) {
+      throw "crop must be a non-empty rect inside the image";
+    }
+    options.hasCrop = true;
+  }
+
+  return options;
+}
+
+// The crop rect in the coordinates of an image decoded at 1/factor, rounded
+// outwards so it still covers the whole region
+static cv::Rect ScaleCrop(const cv::Rect &crop, int factor) {
+  int x0 = crop.x / factor;
+  int y0 = crop.y / factor;
+  int x1 = (crop.x + crop.width + factor - 1) / factor;
+  int y1 = (crop.y + crop.height + factor - 1) / factor;
+  return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+// Scales mat down, keeping its aspect ratio, until neither side is above
+// maxDim. INTER_AREA, as it averages the pixels that are dropped.
+static void FitWithin(cv::Mat &mat, int maxDim) {
+  int longest = std::max(mat.rows, mat.cols);
+  if (longest <= maxDim) {
+    return;
+  }
+
+  double scale = (double)maxDim / longest;
+  cv::Size size(std::max(1, (int)std::round(mat.cols * scale)),
+      std::max(1, (int)std::round(mat.rows * scale)));
+  cv::Mat small;
+  cv::resize(mat, small, size, 0, 0, cv::INTER_AREA);
+  mat = small;
 }
 
 class ReadImageAsyncWorker : public Nan::AsyncWorker {
@@ -17,27 +155,84 @@ public:
   ReadImageAsyncWorker(const std::string &path): Nan::AsyncWorker{nullptr}, path(path) {}
   ReadImageAsyncWorker(const unsigned &length, uint8_t *data): Nan::AsyncWorker{nullptr}, length(length), data(data) {}
 
-  void SetImreadMode(cv::ImreadModes mode) {
-    this->mode = mode;
+  void SetOptions(const ReadImageOptions &options) {
+    this->options = options;
   }
 
   void Execute() override {
+    Profiler::Timer timer(profilerOp, queuedAt);
+    int factor = options.reduce;
+    if (factor == 1 && options.maxDim && CanReduce(options.mode)) {
+      factor = ReductionFor(options.maxDim);
+    }
+
     try {
+      int mode = factor > 1 ? ReducedMode(options.mode, factor) : options.mode;
       if (data == nullptr) {
         mat = cv::imread(path, mode);
       } else {
-        cv::Mat mbuf(length, 1, CV_64FC1, data);
+        cv::Mat mbuf(1, length, CV_8UC1, data);
         mat = cv::imdecode(mbuf, mode);
       }
+
+      if (options.hasCrop && !mat.empty()) {
+        cv::Rect bounds(0, 0, mat.cols, mat.rows);
+        cv::Rect region = ScaleCrop(options.crop, factor);
+        // A reduced decode may round its size either way
+        if (factor > 1) {
+          region &= bounds;
+        }
+        if (region.area() == 0 || (region & bounds) != region) {
+          return SetErrorMessage("crop must be a non-empty rect inside the image");
+        }
+        // A copy, so the full image is freed
+        mat = mat(region).clone();
+      }
+
+      if (options.maxDim && !mat.empty()) {
+        FitWithin(mat, options.maxDim);
+      }
     } catch (cv::Exception& e) {
       return SetErrorMessage(e.what());
     }
+    timer.bytes = mat.dataend - mat.datastart;
 
     if (mat.empty()) {
       SetErrorMessage("Could not open or find the image");
     }
   }
 
+private:
+  // The largest decode time reduction that still leaves the image, or the
+  // crop, at least maxDim on its longer side. Only JPEG decoders scale while
+  // decoding, other formats are decoded in full and resized by FitWithin.
+  int ReductionFor(int maxDim) {
+    ImageHeader header;
+    try {
+      if (data == nullptr) {
+        ReadImageHeader(path, header);
+      } else {
+        ReadImageHeader(data, length, header);
+      }
+    } catch (const char *msg) {
+      // Left for the decoder to report
+      return 1;
+    }
+    if (header.format != "jpeg") {
+      return 1;
+    }
+
+    int longest = options.hasCrop ?
+        std::max(options.crop.width, options.crop.height) :
+        std::max(header.width, header.height);
+    for (int factor = 8; factor > 1; factor /= 2) {
+      if (longest / factor >= maxDim) {
+        return factor;
+      }
+    }
+    return 1;
+  }
+
 protected:
   void HandleOKCallback() override {
     Nan::HandleScope scope;
@@ -59,14 +254,17 @@ protected:
   virtual void OnFailure(Local<Value> error) = 0;
 
 private:
-    const std::string path = nullptr;
+    const std::string path;
 
     unsigned length = 0;
     uint8_t *data = nullptr;
 
-    cv::ImreadModes mode = cv::IMREAD_COLOR;
+    ReadImageOptions options;
 
     cv::Mat mat;
+
+    uint64_t queuedAt = Profiler::Now();
+    int profilerOp = ReadImageProfilerOp();
 };
 
 class CallbackReadImageAsyncWorker : public ReadImageAsyncWorker {
@@ -130,10 +328,22 @@ NAN_METHOD(OpenCV::ReadImage) {
     return Nan::ThrowError("readImage requires at least 1 arguments");
   }
 
+  // readImage(src, [options], [callback])
+  ReadImageOptions options;
+  int cbIndex = 1;
+  if (info.Length() > 1 && info[1]->IsObject() && !info[1]->IsFunction()) {
+    try {
+      options = ParseReadImageOptions(info[1]->ToObject());
+    } catch (const char *msg) {
+      return Nan::ThrowTypeError(msg);
+    }
+    cbIndex = 2;
+  }
+
   bool isCallback = false;
-  if (info.Length() > 1) {
-    if (!info[1]->IsFunction()) {
-      return Nan::ThrowTypeError("Argument 2 must be a Function");
+  if (info.Length() > cbIndex) {
+    if (!info[cbIndex]->IsFunction()) {
+      return Nan::ThrowTypeError(cbIndex == 1 ? "Argument 2 must be a Function" : "Argument 3 must be a Function");
     }
 
     isCallback = true;
@@ -160,8 +370,15 @@ NAN_METHOD(OpenCV::ReadImage) {
     return Nan::ThrowTypeError("Argument 1 must be a string or a Buffer");
   }
 
+  worker->SetOptions(options);
+
+  if (!info[0]->IsString()) {
+    // Keeps the Buffer alive while the worker decodes from it
+    worker->SaveToPersistent("buffer", info[0]);
+  }
+
   if (isCallback) {
-    worker->SaveToPersistent(0u, info[1]);
+    worker->SaveToPersistent(0u, info[cbIndex]);
   } else {
     Local<Promise::Resolver> resolver = Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked();
     worker->SaveToPersistent(0u, resolver);
@@ -221,3 +438,204 @@ NAN_METHOD(OpenCV::ReadImageMulti) {
   return;
 }
 #endif
+
+// {format, width, height, channels, depth} for probeImage
+static Local<Object> ImageHeaderObject(const ImageHeader &header) {
+  Local<Object> result = Nan::New<Object>();
+  result->Set(Nan::New("format").ToLocalChecked(), Nan::New(header.format).ToLocalChecked());
+  result->Set(Nan::New("width").ToLocalChecked(), Nan::New<Number>(header.width));
+  result->Set(Nan::New("height").ToLocalChecked(), Nan::New<Number>(header.height));
+  result->Set(Nan::New("channels").ToLocalChecked(), Nan::New<Number>(header.channels));
+  result->Set(Nan::New("depth").ToLocalChecked(), Nan::New<Number>(header.depth));
+  return result;
+}
+
+static int ProbeImageProfilerOp() {
+  static int op = Profiler::Register("probeImage:worker");
+  return op;
+}
+
+// Reads headers on the thread pool, for probeImage with a callback
+class ProbeImageAsyncWorker : public Nan::AsyncWorker {
+public:
+  ProbeImageAsyncWorker(Nan::Callback *callback, const std::vector<std::string> &paths,
+      bool batch) :
+      Nan::AsyncWorker(callback),
+      paths(paths),
+      data(nullptr),
+      length(0),
+      batch(batch),
+      headers(paths.size()),
+      errors(paths.size()),
+      queuedAt(Profiler::Now()),
+      profilerOp(ProbeImageProfilerOp()) {
+  }
+
+  ProbeImageAsyncWorker(Nan::Callback *callback, const uchar *data, size_t length) :
+      Nan::AsyncWorker(callback),
+      data(data),
+      length(length),
+      batch(false),
+      headers(1),
+      errors(1),
+      queuedAt(Profiler::Now()),
+      profilerOp(ProbeImageProfilerOp()) {
+  }
+
+  void Execute() override {
+    Profiler::Timer timer(profilerOp, queuedAt);
+    for (size_t i = 0; i < headers.size(); i++) {
+      try {
+        if (data == nullptr) {
+          ReadImageHeader(paths[i], headers[i]);
+        } else {
+          ReadImageHeader(data, length, headers[i]);
+        }
+      } catch (const char *msg) {
+        errors[i] = msg;
+      }
+    }
+    if (!batch && !errors[0].empty()) {
+      SetErrorMessage(errors[0].c_str());
+    }
+  }
+
+protected:
+  void HandleOKCallback() override {
+    Nan::HandleScope scope;
+
+    Local<Value> result;
+    if (batch) {
+      Local<Array> results = Nan::New<Array>(headers.size());
+      for (size_t i = 0; i < headers.size(); i++) {
+        if (errors[i].empty()) {
+          results->Set(i, ImageHeaderObject(headers[i]));
+        } else {
+          Local<Object> failed = Nan::New<Object>();
+          failed->Set(Nan::New("error").ToLocalChecked(), Nan::New(errors[i]).ToLocalChecked());
+          results->Set(i, failed);
+        }
+      }
+      result = results;
+    } else {
+      result = ImageHeaderObject(headers[0]);
+    }
+
+    Local<Value> argv[] = {
+      Nan::Null(),
+      result
+    };
+
+    Nan::TryCatch try_catch;
+    callback->Call(2, argv);
+    if (try_catch.HasCaught()) {
+      Nan::FatalException(try_catch);
+    }
+  }
+
+private:
+  std::vector<std::string> paths;
+  const uchar *data;
+  size_t length;
+  bool batch;
+  std::vector<ImageHeader> headers;
+  std::vector<std::string> errors;
+  uint64_t queuedAt;
+  int profilerOp;
+};
+
+// cv.probeImage(pathOrBuffer, [callback])
+// cv.probeImage([path, ...], [callback])
+// Reads only the header of an image, and returns {format, width, height,
+// channels, depth} without decoding any pixels. format is 'jpeg', 'png',
+// 'gif', 'bmp', 'webp' or 'tiff', and depth a cv.Constants.CV_8U style type.
+// An array of paths gives an array of results, where an image that could not
+// be probed is {error}. Files are read on the thread pool when there is a
+// callback; otherwise the call returns the result and throws on failure.
+NAN_METHOD(OpenCV::ProbeImage) {
+  Nan::HandleScope scope;
+
+  const char *usage = "Argument 1 must be a path, a Buffer or an array of paths";
+  if (info.Length() < 1) {
+    return Nan::ThrowTypeError(usage);
+  }
+
+  Nan::Callback *callback = nullptr;
+  if (info.Length() > 1) {
+    if (!info[1]->IsFunction()) {
+      return Nan::ThrowTypeError("Argument 2 must be a Function");
+    }
+    callback = new Nan::Callback(info[1].As<Function>());
+  }
+
+  if (Buffer::HasInstance(info[0])) {
+    const uchar *data = (const uchar *) Buffer::Data(info[0]->ToObject());
+    size_t length = Buffer::Length(info[0]->ToObject());
+
+    if (callback) {
+      ProbeImageAsyncWorker *worker = new ProbeImageAsyncWorker(callback, data, length);
+      // Keeps the Buffer alive while the worker reads it
+      worker->SaveToPersistent("buffer", info[0]);
+      Nan::AsyncQueueWorker(worker);
+      return;
+    }
+
+    ImageHeader header;
+    try {
+      ReadImageHeader(data, length, header);
+    } catch (const char *msg) {
+      return Nan::ThrowError(msg);
+    }
+    info.GetReturnValue().Set(ImageHeaderObject(header));
+    return;
+  }
+
+  bool batch = info[0]->IsArray();
+  std::vector<std::string> paths;
+  if (batch) {
+    Local<Array> array = info[0].As<Array>();
+    for (uint32_t i = 0; i < array->Length(); i++) {
+      Local<Value> path = array->Get(i);
+      if (!path->IsString()) {
+        delete callback;
+        return Nan::ThrowTypeError(usage);
+      }
+      paths.push_back(*Nan::Utf8String(path));
+    }
+  } else if (info[0]->IsString()) {
+    paths.push_back(*Nan::Utf8String(info[0]));
+  } else {
+    delete callback;
+    return Nan::ThrowTypeError(usage);
+  }
+
+  if (callback) {
+    Nan::AsyncQueueWorker(new ProbeImageAsyncWorker(callback, paths, batch));
+    return;
+  }
+
+  if (!batch) {
+    ImageHeader header;
+    try {
+      ReadImageHeader(paths[0], header);
+    } catch (const char *msg) {
+      return Nan::ThrowError(msg);
+    }
+    info.GetReturnValue().Set(ImageHeaderObject(header));
+    return;
+  }
+
+  Local<Array> results = Nan::New<Array>(paths.size());
+  for (size_t i = 0; i < paths.size(); i++) {
+    ImageHeader header;
+    try {
+      ReadImageHeader(paths[i], header);
+      results->Set(i, ImageHeaderObject(header));
+    } catch (const char *msg) {
+      Local<Object> failed = Nan::New<Object>();
+      failed->Set(Nan::New("error").ToLocalChecked(), Nan::New(msg).ToLocalChecked());
+      results->Set(i, failed);
+    }
+  }
+  info.GetReturnValue().Set(results);
+}
@@ -77,6 +77,7 @@ public:
 
   static NAN_METHOD(ReadImage);
   static NAN_METHOD(ReadImageMulti);
+  static NAN_METHOD(ProbeImage);
 };
 
 #endif
@@ -0,0 +1,260 @@
+#include "Pipeline.h"
+#include "Matrix.h"
+#include "Profiler.h"
+#include <nan.h>
+
+Nan::Persistent<FunctionTemplate> Pipeline::constructor;
+
+void Pipeline::Init(Local<Object> target) {
+  Nan::HandleScope scope;
+
+  // Constructor
+  Local<FunctionTemplate> ctor = Nan::New<FunctionTemplate>(Pipeline::New);
+  constructor.Reset(ctor);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("Pipeline").ToLocalChecked());
+
+  // Prototype
+  Nan::SetPrototypeMethod(ctor, "add", Add);
+  Nan::SetPrototypeMethod(ctor, "size", Size);
+  Nan::SetPrototypeMethod(ctor, "clear", Clear);
+  Nan::SetPrototypeMethod(ctor, "run", Run);
+
+  Local<Function> fn = ctor->GetFunction();
+  fn->Set(Nan::New("operations").ToLocalChecked(), MatrixOp::Names());
+
+  target->Set(Nan::New("Pipeline").ToLocalChecked(), fn);
+}
+
+NAN_METHOD(Pipeline::New) {
+  Nan::HandleScope scope;
+
+  if (info.This()->InternalFieldCount() == 0) {
+    return Nan::ThrowTypeError("Cannot Instantiate without new");
+  }
+
+  Pipeline *pipeline = new Pipeline();
+  pipeline->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+Pipeline::Pipeline() :
+    running(false) {
+}
+
+Pipeline::~Pipeline() {
+  for (size_t i = 0; i < ops.size(); i++) {
+    delete ops[i];
+  }
+}
+
+void Pipeline::Execute(const cv::Mat &src, cv::Mat &dst) {
+  cv::Mat cur = src;
+  int next = 0;
+
+  for (size_t i = 0; i < ops.size(); i++) {
+    cv::Mat &out = scratch[next];
+    ops[i]->Execute(cur, out);
+
+    if (out.data == cur.data) {
+      // The step passed its input through, keep reading from where we are
+      out = cv::Mat();
+      continue;
+    }
+
+    cur = out;
+    next = 1 - next;
+  }
+
+  // The caller gets the last image to keep, so stop reusing its memory
+  for (int i = 0; i < 2; i++) {
+    if (scratch[i].data == cur.data) {
+      scratch[i] = cv::Mat();
+    }
+  }
+
+  dst = cur.data == src.data ? src.clone() : cur;
+}
+
+// pipeline.add(name, args...)
+// Records the named Matrix operation, with the same arguments as the
+// synchronous method. See cv.Pipeline.operations for the supported names.
+NAN_METHOD(Pipeline::Add) {
+  SETUP_FUNCTION(Pipeline)
+
+  if (info.Length() < 1 || !info[0]->IsString()) {
+    return Nan::ThrowTypeError("Argument 1 must be an operation name");
+  }
+  if (self->running) {
+    return Nan::ThrowError("Cannot add to a Pipeline while it is running");
+  }
+  if (!self->ops.empty() && !self->ops.back()->ReturnsMatrix()) {
+    return Nan::ThrowError("Nothing can follow an operation that does not return a Matrix");
+  }
+
+  std::string name = *Nan::Utf8String(info[0]);
+  int argc = info.Length() - 1;
+  std::vector<Local<Value> > argv(argc);
+  for (int n = 0; n < argc; ++n) {
+    argv[n] = info[n + 1];
+  }
+
+  MatrixOp *op;
+  try {
+    op = MatrixOp::Create(name, argc, argv.data());
+  } catch (const char *msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (!op) {
+    std::string msg = "Unknown operation " + name;
+    return Nan::ThrowTypeError(msg.c_str());
+  }
+
+  self->ops.push_back(op);
+  info.GetReturnValue().Set(info.This());
+}
+
+NAN_METHOD(Pipeline::Size) {
+  SETUP_FUNCTION(Pipeline)
+
+  info.GetReturnValue().Set(Nan::New<Number>(self->ops.size()));
+}
+
+NAN_METHOD(Pipeline::Clear) {
+  SETUP_FUNCTION(Pipeline)
+
+  if (self->running) {
+    return Nan::ThrowError("Cannot clear a Pipeline while it is running");
+  }
+
+  for (size_t i = 0; i < self->ops.size(); i++) {
+    delete self->ops[i];
+  }
+  self->ops.clear();
+  self->scratch[0] = cv::Mat();
+  self->scratch[1] = cv::Mat();
+
+  info.GetReturnValue().Set(info.This());
+}
+
+class AsyncPipelineWorker: public Nan::AsyncWorker {
+public:
+  AsyncPipelineWorker(Nan::Callback *callback, Pipeline *pipeline, const cv::Mat &src) :
+      Nan::AsyncWorker(callback),
+      pipeline(pipeline),
+      src(src),
+      queuedAt(Profiler::Now()) {
+    static int op = Profiler::Register("Pipeline.run:worker");
+    profilerOp = op;
+  }
+
+  void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
+    try {
+      pipeline->Execute(src, dst);
+      timer.bytes = dst.dataend - dst.datastart;
+    } catch (cv::Exception& e) {
+      SetErrorMessage(e.what());
+    } catch (const char *msg) {
+      SetErrorMessage(msg);
+    }
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    pipeline->running = false;
+
+    Local<Value> result;
+    if (pipeline->ops.empty() || pipeline->ops.back()->ReturnsMatrix()) {
+      Local<Object> im = Matrix::NewInstance();
+      UNWRAP_OBJ(Matrix, im)->mat = dst;
+      result = im;
+    } else {
+      result = pipeline->ops.back()->Result(GetFromPersistent("matrix").As<Object>(), dst);
+    }
+
+    if (callback) {
+      Local<Value> argv[] = {
+        Nan::Null(),
+        result
+      };
+
+      Nan::TryCatch try_catch;
+      callback->Call(2, argv);
+      if (try_catch.HasCaught()) {
+        Nan::FatalException(try_catch);
+      }
+    } else {
+      Local<Promise::Resolver> resolver = GetFromPersistent("resolver").As<Promise::Resolver>();
+      resolver->Resolve(Nan::GetCurrentContext(), result);
+      Isolate::GetCurrent()->RunMicrotasks();
+    }
+  }
+
+  void HandleErrorCallback() {
+    Nan::HandleScope scope;
+
+    pipeline->running = false;
+
+    Local<Value> error = Nan::Error(ErrorMessage());
+
+    if (callback) {
+      Local<Value> argv[] = {
+        error
+      };
+
+      Nan::TryCatch try_catch;
+      callback->Call(1, argv);
+      if (try_catch.HasCaught()) {
+        Nan::FatalException(try_catch);
+      }
+    } else {
+      Local<Promise::Resolver> resolver = GetFromPersistent("resolver").As<Promise::Resolver>();
+      resolver->Reject(Nan::GetCurrentContext(), error);
+      Isolate::GetCurrent()->RunMicrotasks();
+    }
+  }
+
+private:
+  Pipeline *pipeline;
+  cv::Mat src;
+  cv::Mat dst;
+  uint64_t queuedAt;
+  int profilerOp;
+};
+
+// pipeline.run(matrix, [callback])
+// Runs all the recorded operations on a copy-free view of matrix, which is
+// left unchanged. Resolves with the output of the last operation. A Pipeline
+// runs one image at a time, use one per stream to process streams in parallel.
+NAN_METHOD(Pipeline::Run) {
+  SETUP_FUNCTION(Pipeline)
+
+  if (info.Length() < 1 || !Matrix::HasInstance(info[0])) {
+    return Nan::ThrowTypeError("Argument 1 must be a Matrix");
+  }
+  if (self->running) {
+    return Nan::ThrowError("Pipeline is already running");
+  }
+
+  Matrix *im = UNWRAP_OBJ(Matrix, info[0]->ToObject());
+
+  Nan::Callback *callback = nullptr;
+  if (info.Length() > 1 && info[1]->IsFunction()) {
+    callback = new Nan::Callback(info[1].As<Function>());
+  }
+
+  AsyncPipelineWorker *worker = new AsyncPipelineWorker(callback, self, im->mat);
+  worker->SaveToPersistent("pipeline", info.This());
+  worker->SaveToPersistent("matrix", info[0]);
+
+  if (!callback) {
+    Local<Promise::Resolver> resolver = Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked();
+    worker->SaveToPersistent("resolver", resolver);
+    info.GetReturnValue().Set(resolver->GetPromise());
+  }
+
+  self->running = true;
+  Nan::AsyncQueueWorker(worker);
+}
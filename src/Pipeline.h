@@ -0,0 +1,34 @@
+#ifndef __NODE_PIPELINE_H
+#define __NODE_PIPELINE_H
+
+#include "OpenCV.h"
+#include "MatrixOp.h"
+
+/**
+ * A recorded chain of Matrix operations that runs in a single thread pool job
+ */
+class Pipeline: public Nan::ObjectWrap {
+public:
+  std::vector<MatrixOp *> ops;
+  // Intermediate images, reused between the steps and between runs
+  cv::Mat scratch[2];
+  bool running;
+
+  static Nan::Persistent<FunctionTemplate> constructor;
+  static void Init(Local<Object> target);
+  static NAN_METHOD(New);
+
+  Pipeline();
+  ~Pipeline();
+
+  // Runs every operation on src, leaving the last output in dst.
+  // Called from a worker thread.
+  void Execute(const cv::Mat &src, cv::Mat &dst);
+
+  JSFUNC(Add)
+  JSFUNC(Size)
+  JSFUNC(Clear)
+  JSFUNC(Run)
+};
+
+#endif
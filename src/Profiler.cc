@@ -0,0 +1,263 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+
+std::atomic<bool> Profiler::enabled(false);
+
+static const int kMaxOps = 1024;
+
+// Latency histogram buckets: everything under 1us, then two per power of two
+static const int kBuckets = 64;
+
+static int bucketOf(uint64_t ns) {
+  if (ns < 1024) {
+    return 0;
+  }
+  int e = 63;
+  while (!(ns >> e)) {
+    e--;
+  }
+  int b = 2 * (e - 10) + ((ns >> (e - 1)) & 1) + 1;
+  return b < kBuckets ? b : kBuckets - 1;
+}
+
+static double bucketMid(int b) {
+  if (b == 0) {
+    return 512;
+  }
+  int e = (b - 1) / 2 + 10;
+  double low = (double) (1ULL << e) + ((b - 1) % 2) * (double) (1ULL << (e - 1));
+  return low + (double) (1ULL << (e - 2));
+}
+
+// Counters for one operation on one thread. Only the owning thread writes,
+// so plain load/store pairs are enough and readers just see relaxed values.
+struct OpCounters {
+  std::atomic<uint64_t> calls;
+  std::atomic<uint64_t> totalNs;
+  std::atomic<uint64_t> minNs;
+  std::atomic<uint64_t> maxNs;
+  std::atomic<uint64_t> queueNs;
+  std::atomic<uint64_t> bytes;
+  std::atomic<uint32_t> histogram[kBuckets];
+
+  OpCounters() {
+    Clear();
+  }
+
+  void Clear() {
+    calls.store(0, std::memory_order_relaxed);
+    totalNs.store(0, std::memory_order_relaxed);
+    minNs.store(UINT64_MAX, std::memory_order_relaxed);
+    maxNs.store(0, std::memory_order_relaxed);
+    queueNs.store(0, std::memory_order_relaxed);
+    bytes.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < kBuckets; i++) {
+      histogram[i].store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+static inline void add(std::atomic<uint64_t> &counter, uint64_t n) {
+  counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// A thread's counters, allocated per operation on first use. Blocks are never
+// freed, so the registry can't be left pointing at an exited thread's memory.
+struct ThreadCounters {
+  std::atomic<OpCounters *> ops[kMaxOps];
+
+  ThreadCounters() {
+    for (int i = 0; i < kMaxOps; i++) {
+      ops[i].store(NULL, std::memory_order_relaxed);
+    }
+  }
+};
+
+static std::mutex threadsMutex;
+static std::vector<ThreadCounters *> threads;
+static std::vector<std::string> names;
+
+static ThreadCounters *currentThread() {
+  static thread_local ThreadCounters *counters = NULL;
+  if (!counters) {
+    counters = new ThreadCounters();
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    threads.push_back(counters);
+  }
+  return counters;
+}
+
+int Profiler::Register(const std::string &name) {
+  for (size_t i = 0; i < names.size(); i++) {
+    if (names[i] == name) {
+      return i;
+    }
+  }
+  if (names.size() >= (size_t) kMaxOps) {
+    return -1;
+  }
+  names.push_back(name);
+  return names.size() - 1;
+}
+
+uint64_t Profiler::Now() {
+  if (!enabled.load(std::memory_order_relaxed)) {
+    return 0;
+  }
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::Record(int op, uint64_t ns, uint64_t queueNs, uint64_t bytes) {
+  if (op < 0 || op >= kMaxOps) {
+    return;
+  }
+
+  ThreadCounters *thread = currentThread();
+  OpCounters *c = thread->ops[op].load(std::memory_order_acquire);
+  if (!c) {
+    c = new OpCounters();
+    thread->ops[op].store(c, std::memory_order_release);
+  }
+
+  add(c->calls, 1);
+  add(c->totalNs, ns);
+  add(c->queueNs, queueNs);
+  add(c->bytes, bytes);
+  if (ns < c->minNs.load(std::memory_order_relaxed)) {
+    c->minNs.store(ns, std::memory_order_relaxed);
+  }
+  if (ns > c->maxNs.load(std::memory_order_relaxed)) {
+    c->maxNs.store(ns, std::memory_order_relaxed);
+  }
+  std::atomic<uint32_t> &bucket = c->histogram[bucketOf(ns)];
+  bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+Profiler::Timer::Timer(int op, uint64_t queuedAt) :
+    bytes(0),
+    op(op),
+    queuedAt(queuedAt),
+    start(Now()) {
+}
+
+Profiler::Timer::~Timer() {
+  // Profiling was off when the timer started
+  if (!start) {
+    return;
+  }
+  uint64_t end = Now();
+  if (!end) {
+    return;
+  }
+  Record(op, end - start, queuedAt ? start - queuedAt : 0, bytes);
+}
+
+void Profiler::Init(Local<Object> target) {
+  Nan::Persistent<Object> inner;
+  Local<Object> obj = Nan::New<Object>();
+  inner.Reset(obj);
+
+  Nan::SetMethod(obj, "enable", Enable);
+  Nan::SetMethod(obj, "disable", Disable);
+  Nan::SetMethod(obj, "reset", Reset);
+  Nan::SetMethod(obj, "stats", Stats);
+
+  target->Set(Nan::New("profiler").ToLocalChecked(), obj);
+  Nan::SetMethod(target, "stats", Stats);
+}
+
+NAN_METHOD(Profiler::Enable) {
+  enabled.store(true);
+}
+
+NAN_METHOD(Profiler::Disable) {
+  enabled.store(false);
+}
+
+// Counters being updated while this runs may keep part of their old values
+NAN_METHOD(Profiler::Reset) {
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  for (size_t t = 0; t < threads.size(); t++) {
+    for (int i = 0; i < kMaxOps; i++) {
+      OpCounters *c = threads[t]->ops[i].load(std::memory_order_acquire);
+      if (c) {
+        c->Clear();
+      }
+    }
+  }
+}
+
+// cv.stats()
+// Returns {<operation>: {calls, totalMs, minMs, maxMs, p50Ms, p99Ms, bytes,
+// queueMs}} for every operation called while profiling was enabled. For
+// thread pool jobs the latencies are the time spent executing, and queueMs is
+// the total time the jobs waited for a free thread. p50 and p99 come from a
+// histogram with two buckets per power of two, so are within about 25%.
+NAN_METHOD(Profiler::Stats) {
+  Nan::HandleScope scope;
+
+  std::vector<ThreadCounters *> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    snapshot = threads;
+  }
+
+  Local<Object> stats = Nan::New<Object>();
+
+  for (size_t i = 0; i < names.size(); i++) {
+    uint64_t calls = 0, totalNs = 0, minNs = UINT64_MAX, maxNs = 0;
+    uint64_t queueNs = 0, bytes = 0;
+    uint64_t histogram[kBuckets] = {0};
+
+    for (size_t t = 0; t < snapshot.size(); t++) {
+      OpCounters *c = snapshot[t]->ops[i].load(std::memory_order_acquire);
+      if (!c) {
+        continue;
+      }
+      calls += c->calls.load(std::memory_order_relaxed);
+      totalNs += c->totalNs.load(std::memory_order_relaxed);
+      minNs = std::min(minNs, (uint64_t) c->minNs.load(std::memory_order_relaxed));
+      maxNs = std::max(maxNs, (uint64_t) c->maxNs.load(std::memory_order_relaxed));
+      queueNs += c->queueNs.load(std::memory_order_relaxed);
+      bytes += c->bytes.load(std::memory_order_relaxed);
+      for (int b = 0; b < kBuckets; b++) {
+        histogram[b] += c->histogram[b].load(std::memory_order_relaxed);
+      }
+    }
+
+    if (!calls) {
+      continue;
+    }
+
+    double p50 = 0, p99 = 0;
+    uint64_t seen = 0;
+    for (int b = 0; b < kBuckets; b++) {
+      seen += histogram[b];
+      if (!p50 && seen * 100 >= calls * 50) {
+        p50 = bucketMid(b);
+      }
+      if (!p99 && seen * 100 >= calls * 99) {
+        p99 = bucketMid(b);
+        break;
+      }
+    }
+
+    Local<Object> op = Nan::New<Object>();
+    op->Set(Nan::New("calls").ToLocalChecked(), Nan::New<Number>(calls));
+    op->Set(Nan::New("totalMs").ToLocalChecked(), Nan::New<Number>(totalNs / 1e6));
+    op->Set(Nan::New("minMs").ToLocalChecked(), Nan::New<Number>(minNs / 1e6));
+    op->Set(Nan::New("maxMs").ToLocalChecked(), Nan::New<Number>(maxNs / 1e6));
+    op->Set(Nan::New("p50Ms").ToLocalChecked(), Nan::New<Number>(p50 / 1e6));
+    op->Set(Nan::New("p99Ms").ToLocalChecked(), Nan::New<Number>(p99 / 1e6));
+    op->Set(Nan::New("bytes").ToLocalChecked(), Nan::New<Number>(bytes));
+    op->Set(Nan::New("queueMs").ToLocalChecked(), Nan::New<Number>(queueNs / 1e6));
+
+    stats->Set(Nan::New(names[i]).ToLocalChecked(), op);
+  }
+
+  info.GetReturnValue().Set(stats);
+}
@@ -0,0 +1,50 @@
+#ifndef __NODE_PROFILER_H
+#define __NODE_PROFILER_H
+
+#include "OpenCV.h"
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * Opt-in per-operation timing, exposed as cv.stats().
+ *
+ * Each thread records into its own counters, so recording takes no locks.
+ * Operations are registered by name from the main thread and recorded by id.
+ */
+class Profiler {
+public:
+  static std::atomic<bool> enabled;
+
+  // Returns the id for the named operation, registering it on first use.
+  // Main thread only.
+  static int Register(const std::string &name);
+
+  // Monotonic nanoseconds, or 0 when profiling is disabled
+  static uint64_t Now();
+
+  static void Record(int op, uint64_t ns, uint64_t queueNs, uint64_t bytes);
+
+  // Times the enclosing scope. Pass the time a thread pool job was queued at
+  // to also record how long it waited for a thread.
+  class Timer {
+  public:
+    Timer(int op, uint64_t queuedAt = 0);
+    ~Timer();
+
+    // Bytes allocated by the operation
+    uint64_t bytes;
+
+  private:
+    int op;
+    uint64_t queuedAt;
+    uint64_t start;
+  };
+
+  static void Init(Local<Object> target);
+  static NAN_METHOD(Enable);
+  static NAN_METHOD(Disable);
+  static NAN_METHOD(Reset);
+  static NAN_METHOD(Stats);
+};
+
+#endif
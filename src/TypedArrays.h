@@ -0,0 +1,90 @@
+#ifndef __NODE_TYPEDARRAYS_H
+#define __NODE_TYPEDARRAYS_H
+
+#include "OpenCV.h"
+#include <string.h>
+
+/**
+ * Flat typed array results, for returning many numbers without building a
+ * JS object per item.
+ *
+ * NewTypedArray<Int32Array>(ints, n) copies n ints into a new Int32Array.
+ */
+template <class ArrayType, class T>
+inline Local<ArrayType> NewTypedArray(const T *data, size_t length) {
+  Local<ArrayBuffer> buffer = ArrayBuffer::New(Isolate::GetCurrent(), length * sizeof(T));
+  if (length > 0) {
+    memcpy(buffer->GetContents().Data(), data, length * sizeof(T));
+  }
+  return ArrayType::New(buffer, 0, length);
+}
+
+template <class ArrayType, class T>
+inline Local<ArrayType> NewTypedArray(const std::vector<T> &data) {
+  return NewTypedArray<ArrayType>(data.empty() ? NULL : &data[0], data.size());
+}
+
+// The Mat depth matching the elements of a typed array, or -1 for a
+// DataView or a Uint32Array, which has no Mat equivalent
+inline int TypedArrayDepth(Local<TypedArray> array) {
+  if (array->IsUint8Array() || array->IsUint8ClampedArray()) {
+    return CV_8U;
+  } else if (array->IsInt8Array()) {
+    return CV_8S;
+  } else if (array->IsUint16Array()) {
+    return CV_16U;
+  } else if (array->IsInt16Array()) {
+    return CV_16S;
+  } else if (array->IsInt32Array()) {
+    return CV_32S;
+  } else if (array->IsFloat32Array()) {
+    return CV_32F;
+  } else if (array->IsFloat64Array()) {
+    return CV_64F;
+  }
+  return -1;
+}
+
+inline void *TypedArrayData(Local<TypedArray> array) {
+  return (char *) array->Buffer()->GetContents().Data() + array->ByteOffset();
+}
+
+template <class ArrayType, class T>
+inline Local<TypedArray> NewTypedArrayOfLength(size_t length) {
+  Local<ArrayBuffer> buffer = ArrayBuffer::New(Isolate::GetCurrent(), length * sizeof(T));
+  return ArrayType::New(buffer, 0, length);
+}
+
+// A new typed array of `length` elements of the given Mat depth
+inline Local<TypedArray> NewTypedArrayForDepth(int depth, size_t length) {
+  switch (depth) {
+    case CV_8U: return NewTypedArrayOfLength<Uint8Array, uint8_t>(length);
+    case CV_8S: return NewTypedArrayOfLength<Int8Array, int8_t>(length);
+    case CV_16U: return NewTypedArrayOfLength<Uint16Array, uint16_t>(length);
+    case CV_16S: return NewTypedArrayOfLength<Int16Array, int16_t>(length);
+    case CV_32S: return NewTypedArrayOfLength<Int32Array, int32_t>(length);
+    case CV_32F: return NewTypedArrayOfLength<Float32Array, float>(length);
+    default: return NewTypedArrayOfLength<Float64Array, double>(length);
+  }
+}
+
+// Methods that can return typed arrays take an options object as their last
+// argument. Returns whether it asks for {typed: true}, and drops it from argc
+// so the positional arguments are parsed as before.
+inline bool TypedOutputRequested(Nan::NAN_METHOD_ARGS_TYPE info, int &argc) {
+  argc = info.Length();
+  if (argc == 0) {
+    return false;
+  }
+
+  Local<Value> last = info[argc - 1];
+  if (!last->IsObject() || last->IsArray() || last->IsFunction()) {
+    return false;
+  }
+
+  argc--;
+  Local<Value> typed = Nan::Get(last.As<Object>(), Nan::New("typed").ToLocalChecked()).ToLocalChecked();
+  return typed->BooleanValue();
+}
+
+#endif
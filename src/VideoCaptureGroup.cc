@@ -0,0 +1,488 @@
+#include "VideoCaptureGroup.h"
+#include "VideoCaptureWrap.h"
+#include "Matrix.h"
+#include "Profiler.h"
+
+#include <chrono>
+
+Nan::Persistent<FunctionTemplate> VideoCaptureGroup::constructor;
+
+static int tickProfilerOp;
+
+static double NowMs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count() / 1000.0;
+}
+
+void VideoCaptureGroup::Init(Local<Object> target) {
+  Nan::HandleScope scope;
+
+  tickProfilerOp = Profiler::Register("VideoCaptureGroup.tick");
+
+  Local<FunctionTemplate> ctor = Nan::New<FunctionTemplate>(VideoCaptureGroup::New);
+  constructor.Reset(ctor);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("VideoCaptureGroup").ToLocalChecked());
+
+  Nan::SetPrototypeMethod(ctor, "read", Read);
+  Nan::SetPrototypeMethod(ctor, "start", Start);
+  Nan::SetPrototypeMethod(ctor, "stop", Stop);
+  Nan::SetPrototypeMethod(ctor, "size", Size);
+  Nan::SetPrototypeMethod(ctor, "stats", Stats);
+
+  target->Set(Nan::New("VideoCaptureGroup").ToLocalChecked(), ctor->GetFunction());
+}
+
+// new cv.VideoCaptureGroup([capture, ...])
+NAN_METHOD(VideoCaptureGroup::New) {
+  Nan::HandleScope scope;
+
+  if (info.This()->InternalFieldCount() == 0) {
+    return Nan::ThrowTypeError("Cannot Instantiate without new");
+  }
+  if (info.Length() < 1 || !info[0]->IsArray()) {
+    return Nan::ThrowTypeError("Argument 1 must be an array of VideoCaptures");
+  }
+
+  Local<Array> array = info[0].As<Array>();
+  if (array->Length() == 0) {
+    return Nan::ThrowTypeError("Argument 1 must be an array of VideoCaptures");
+  }
+
+  std::vector<VideoCaptureWrap *> captures;
+  for (uint32_t i = 0; i < array->Length(); i++) {
+    Local<Value> item = array->Get(i);
+    if (!Nan::New(VideoCaptureWrap::constructor)->HasInstance(item)) {
+      return Nan::ThrowTypeError("Argument 1 must be an array of VideoCaptures");
+    }
+    VideoCaptureWrap *vc = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(item->ToObject());
+    if (vc->grabber) {
+      return Nan::ThrowError("Cannot group a VideoCapture while background grabbing is enabled");
+    }
+    for (size_t j = 0; j < captures.size(); j++) {
+      if (captures[j] == vc) {
+        return Nan::ThrowError("A VideoCapture can only be in a group once");
+      }
+    }
+    captures.push_back(vc);
+  }
+
+  VideoCaptureGroup *group = new VideoCaptureGroup(captures);
+  // The captures must live as long as the group
+  group->sources.Reset(array);
+  group->Wrap(info.This());
+
+  info.GetReturnValue().Set(info.This());
+}
+
+VideoCaptureGroup::VideoCaptureGroup(const std::vector<VideoCaptureWrap *> &captures) :
+    captures(captures),
+    generation(0),
+    grabbedCount(0),
+    doneCount(0),
+    quitting(false),
+    grabbed(captures.size()),
+    ticks(0),
+    lastSkewMs(0),
+    policy(DROP_OLDEST),
+    running(false),
+    loopDone(false),
+    hasPending(false),
+    dropped(0),
+    async(NULL),
+    callback(NULL),
+    stopCallback(NULL) {
+  for (size_t i = 0; i < captures.size(); i++) {
+    threads.push_back(std::thread(&VideoCaptureGroup::RunSource, this, i));
+  }
+}
+
+VideoCaptureGroup::~VideoCaptureGroup() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quitting = true;
+  }
+  tickStart.notify_all();
+  allGrabbed.notify_all();
+
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i].join();
+  }
+  sources.Reset();
+}
+
+void VideoCaptureGroup::RunSource(size_t i) {
+  VideoCaptureWrap *vc = captures[i];
+  uint64_t seen = 0;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      tickStart.wait(lock, [&] { return quitting || generation != seen; });
+      if (quitting) {
+        return;
+      }
+      seen = generation;
+    }
+
+    bool ok = false;
+    try {
+      std::lock_guard<std::mutex> lock(vc->capMutex);
+      ok = vc->cap.grab();
+    } catch (cv::Exception &e) {
+      ok = false;
+    }
+    double timestamp = NowMs();
+
+    // Nobody decodes until everybody has grabbed
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      grabbed[i] = ok;
+      current.timestamps[i] = timestamp;
+      if (++grabbedCount == captures.size()) {
+        allGrabbed.notify_all();
+      } else {
+        allGrabbed.wait(lock, [&] { return grabbedCount == captures.size() || quitting; });
+        if (quitting) {
+          return;
+        }
+      }
+    }
+
+    cv::Mat frame;
+    if (ok) {
+      try {
+        std::lock_guard<std::mutex> lock(vc->capMutex);
+        vc->cap.retrieve(frame);
+      } catch (cv::Exception &e) {
+        frame = cv::Mat();
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    current.frames[i] = frame;
+    if (++doneCount == captures.size()) {
+      tickDone.notify_all();
+    }
+  }
+}
+
+bool VideoCaptureGroup::Tick(CaptureBatch &batch) {
+  Profiler::Timer timer(tickProfilerOp);
+  std::lock_guard<std::mutex> tickLock(tickMutex);
+  std::unique_lock<std::mutex> lock(mutex);
+
+  size_t n = captures.size();
+  grabbedCount = 0;
+  doneCount = 0;
+  current.frames.assign(n, cv::Mat());
+  current.timestamps.assign(n, 0);
+  generation++;
+  tickStart.notify_all();
+  tickDone.wait(lock, [&] { return doneCount == n; });
+
+  batch.frames.swap(current.frames);
+  batch.timestamps = current.timestamps;
+
+  bool any = false;
+  double first = 0, last = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (!grabbed[i]) {
+      continue;
+    }
+    double t = batch.timestamps[i];
+    if (!any || t < first) {
+      first = t;
+    }
+    if (!any || t > last) {
+      last = t;
+    }
+    any = true;
+  }
+
+  ticks++;
+  if (any) {
+    lastSkewMs = last - first;
+  }
+  return any;
+}
+
+void VideoCaptureGroup::RunLoop() {
+  while (true) {
+    CaptureBatch batch;
+    bool more = Tick(batch);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!running) {
+      break;
+    }
+    if (hasPending) {
+      if (policy == BLOCK) {
+        pendingTaken.wait(lock, [this] { return !hasPending || !running; });
+        if (!running) {
+          break;
+        }
+      } else {
+        dropped++;
+      }
+    }
+
+    // The last batch, of empty frames, tells JS the sources have ended
+    pending.frames.swap(batch.frames);
+    pending.timestamps.swap(batch.timestamps);
+    hasPending = true;
+    uv_async_send(async);
+
+    if (!more) {
+      break;
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    loopDone = true;
+  }
+  uv_async_send(async);
+}
+
+// Callback arguments for a batch: null, frames, timestamps
+static void BatchArguments(const CaptureBatch &batch, Local<Value> argv[3]) {
+  Local<Array> frames = Nan::New<Array>(batch.frames.size());
+  Local<Array> timestamps = Nan::New<Array>(batch.timestamps.size());
+  for (size_t i = 0; i < batch.frames.size(); i++) {
+    Local<Object> im = Matrix::NewInstance();
+    Nan::ObjectWrap::Unwrap<Matrix>(im)->mat = batch.frames[i];
+    frames->Set(i, im);
+    timestamps->Set(i, Nan::New<Number>(batch.timestamps[i]));
+  }
+
+  argv[0] = Nan::Null();
+  argv[1] = frames;
+  argv[2] = timestamps;
+}
+
+// Runs on the main thread for each batch the loop hands over, and once the
+// loop has returned
+void VideoCaptureGroup::Deliver(uv_async_t *handle) {
+  Nan::HandleScope scope;
+  VideoCaptureGroup *self = static_cast<VideoCaptureGroup *>(handle->data);
+
+  CaptureBatch batch;
+  bool has, finished;
+  {
+    std::lock_guard<std::mutex> lock(self->mutex);
+    has = self->hasPending;
+    finished = self->loopDone;
+    batch.frames.swap(self->pending.frames);
+    batch.timestamps.swap(self->pending.timestamps);
+    self->hasPending = false;
+  }
+  self->pendingTaken.notify_all();
+
+  if (has && self->callback) {
+    Local<Value> argv[3];
+    BatchArguments(batch, argv);
+
+    // The callback may call stop(), which deletes self->callback
+    Local<Function> fn = self->callback->GetFunction();
+    Nan::TryCatch try_catch;
+    Nan::MakeCallback(Nan::GetCurrentContext()->Global(), fn, 3, argv);
+    if (try_catch.HasCaught()) {
+      Nan::FatalException(try_catch);
+    }
+  }
+
+  if (finished && self->async) {
+    self->FinishLoop();
+  }
+}
+
+void VideoCaptureGroup::FinishLoop() {
+  // The loop has set loopDone and is about to return, so this is quick
+  if (loop.joinable()) {
+    loop.join();
+  }
+
+  uv_close(reinterpret_cast<uv_handle_t *>(async), [](uv_handle_t *handle) {
+    delete reinterpret_cast<uv_async_t *>(handle);
+  });
+  async = NULL;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+    hasPending = false;
+    pending = CaptureBatch();
+  }
+
+  delete callback;
+  callback = NULL;
+
+  Nan::Callback *stopped = stopCallback;
+  stopCallback = NULL;
+  if (stopped) {
+    Nan::TryCatch try_catch;
+    stopped->Call(0, NULL);
+    delete stopped;
+    if (try_catch.HasCaught()) {
+      Nan::FatalException(try_catch);
+    }
+  }
+
+  // Taken in start(), last as it may let the object be collected
+  Unref();
+}
+
+class AsyncGroupReadWorker: public Nan::AsyncWorker {
+public:
+  AsyncGroupReadWorker(Nan::Callback *callback, VideoCaptureGroup *group) :
+      Nan::AsyncWorker(callback),
+      group(group),
+      queuedAt(Profiler::Now()) {
+    static int op = Profiler::Register("VideoCaptureGroup.read:worker");
+    profilerOp = op;
+  }
+
+  void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
+    group->Tick(batch);
+  }
+
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+
+    Local<Value> argv[3];
+    BatchArguments(batch, argv);
+
+    Nan::TryCatch try_catch;
+    callback->Call(3, argv);
+    if (try_catch.HasCaught()) {
+      Nan::FatalException(try_catch);
+    }
+  }
+
+private:
+  VideoCaptureGroup *group;
+  CaptureBatch batch;
+  uint64_t queuedAt;
+  int profilerOp;
+};
+
+// group.read(function(err, frames, timestamps) {})
+// Grabs on every capture at once, then decodes. frames[i] comes from the i-th
+// capture, and is empty once that capture has ended. timestamps[i] is when
+// its grab returned, in ms since the epoch.
+NAN_METHOD(VideoCaptureGroup::Read) {
+  SETUP_FUNCTION(VideoCaptureGroup)
+
+  REQ_FUN_ARG(0, cb);
+
+  if (self->async) {
+    return Nan::ThrowError("Cannot read while the group is started");
+  }
+
+  Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
+  AsyncGroupReadWorker *worker = new AsyncGroupReadWorker(callback, self);
+  worker->SaveToPersistent("group", info.This());
+  Nan::AsyncQueueWorker(worker);
+}
+
+// group.start(function(err, frames, timestamps) {}, [{policy: 'dropOldest'}])
+// Reads batches back to back on a background thread and calls back once per
+// batch, like read(). When JS falls behind, 'dropOldest' replaces the batch
+// that is waiting with the newer one, which suits live cameras, while 'block'
+// holds the next tick until the waiting batch is taken. The group stops by
+// itself after a batch of empty frames, once every source has ended.
+NAN_METHOD(VideoCaptureGroup::Start) {
+  SETUP_FUNCTION(VideoCaptureGroup)
+
+  REQ_FUN_ARG(0, cb);
+
+  Policy policy = DROP_OLDEST;
+  if (info.Length() > 1 && info[1]->IsObject()) {
+    Local<Object> options = info[1]->ToObject();
+    Local<String> policyKey = Nan::New("policy").ToLocalChecked();
+    if (Nan::Has(options, policyKey).FromJust()) {
+      std::string p = *Nan::Utf8String(Nan::Get(options, policyKey).ToLocalChecked());
+      if (p == "block") {
+        policy = BLOCK;
+      } else if (p != "dropOldest") {
+        return Nan::ThrowTypeError("policy must be 'dropOldest' or 'block'");
+      }
+    }
+  }
+
+  if (self->async) {
+    return Nan::ThrowError("VideoCaptureGroup is already started");
+  }
+
+  self->callback = new Nan::Callback(cb.As<Function>());
+  self->async = new uv_async_t();
+  self->async->data = self;
+  uv_async_init(uv_default_loop(), self->async, Deliver);
+
+  {
+    std::lock_guard<std::mutex> lock(self->mutex);
+    self->policy = policy;
+    self->running = true;
+    self->loopDone = false;
+    self->hasPending = false;
+    self->dropped = 0;
+  }
+
+  // Kept alive until the loop stops
+  self->Ref();
+  self->loop = std::thread(&VideoCaptureGroup::RunLoop, self);
+}
+
+// group.stop([function() {}])
+// Stops calling back with batches at once, but does not wait for the loop:
+// one stalled source can hold a tick for as long as its grab takes. The
+// callback runs once the loop has returned, after which the captures are free
+// to release and the group can be started again.
+NAN_METHOD(VideoCaptureGroup::Stop) {
+  SETUP_FUNCTION(VideoCaptureGroup)
+
+  if (!self->async) {
+    if (info.Length() > 0 && info[0]->IsFunction()) {
+      Nan::Callback cb(info[0].As<Function>());
+      cb.Call(0, NULL);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(self->mutex);
+    self->running = false;
+  }
+  self->pendingTaken.notify_all();
+
+  // No more batches reach JS
+  delete self->callback;
+  self->callback = NULL;
+
+  if (info.Length() > 0 && info[0]->IsFunction() && !self->stopCallback) {
+    self->stopCallback = new Nan::Callback(info[0].As<Function>());
+  }
+}
+
+NAN_METHOD(VideoCaptureGroup::Size) {
+  SETUP_FUNCTION(VideoCaptureGroup)
+
+  info.GetReturnValue().Set(Nan::New<Number>(self->captures.size()));
+}
+
+// Returns {running, ticks, dropped, skewMs}, where skewMs is the time between
+// the first and the last grab of the latest tick.
+NAN_METHOD(VideoCaptureGroup::Stats) {
+  SETUP_FUNCTION(VideoCaptureGroup)
+
+  std::lock_guard<std::mutex> lock(self->mutex);
+  Local<Object> stats = Nan::New<Object>();
+  stats->Set(Nan::New("running").ToLocalChecked(), Nan::New<Boolean>(self->running));
+  stats->Set(Nan::New("ticks").ToLocalChecked(), Nan::New<Number>(self->ticks));
+  stats->Set(Nan::New("dropped").ToLocalChecked(), Nan::New<Number>(self->dropped));
+  stats->Set(Nan::New("skewMs").ToLocalChecked(), Nan::New<Number>(self->lastSkewMs));
+
+  info.GetReturnValue().Set(stats);
+}
@@ -0,0 +1,95 @@
+#ifndef __NODE_VIDEOCAPTUREGROUP_H
+#define __NODE_VIDEOCAPTUREGROUP_H
+
+#include "OpenCV.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+class VideoCaptureWrap;
+
+// One synchronised read from every capture of a group
+struct CaptureBatch {
+  std::vector<cv::Mat> frames;
+  // Wall clock time each grab returned, in ms since the epoch
+  std::vector<double> timestamps;
+};
+
+/**
+ * cv.VideoCaptureGroup, reads several VideoCaptures in lockstep.
+ *
+ * Each capture has its own thread. A tick releases them all to grab() at
+ * once, waits until every grab has returned, and only then lets them
+ * retrieve() (decode), so the frames are as close in time as the sources
+ * allow. start() runs ticks back to back on a loop thread and hands each
+ * batch to JS in a single callback.
+ */
+class VideoCaptureGroup: public Nan::ObjectWrap {
+public:
+  enum Policy {
+    DROP_OLDEST,  // replace a batch JS has not taken yet with the newer one
+    BLOCK         // wait for JS to take the batch before the next tick
+  };
+
+  static Nan::Persistent<FunctionTemplate> constructor;
+  static void Init(Local<Object> target);
+  static NAN_METHOD(New);
+
+  VideoCaptureGroup(const std::vector<VideoCaptureWrap *> &captures);
+  ~VideoCaptureGroup();
+
+  // Runs one tick on the capture threads and waits for it. Returns false once
+  // every source has reached its end.
+  bool Tick(CaptureBatch &batch);
+
+  static NAN_METHOD(Read);
+  static NAN_METHOD(Start);
+  static NAN_METHOD(Stop);
+  static NAN_METHOD(Size);
+  static NAN_METHOD(Stats);
+
+private:
+  void RunSource(size_t i);
+  void RunLoop();
+  // Joins the loop thread once it has returned, and drops what start() took
+  void FinishLoop();
+  static void Deliver(uv_async_t *handle);
+
+  std::vector<VideoCaptureWrap *> captures;
+  Nan::Persistent<Object> sources;
+  std::vector<std::thread> threads;
+
+  // Serialises ticks, as read() and the loop may both ask for one
+  std::mutex tickMutex;
+
+  // Guards everything below, shared with the capture threads
+  std::mutex mutex;
+  std::condition_variable tickStart;
+  std::condition_variable allGrabbed;
+  std::condition_variable tickDone;
+  uint64_t generation;
+  size_t grabbedCount;
+  size_t doneCount;
+  bool quitting;
+  CaptureBatch current;
+  std::vector<bool> grabbed;
+  double ticks;
+  double lastSkewMs;
+
+  // The start() loop
+  std::thread loop;
+  Policy policy;
+  bool running;
+  // Set by the loop thread as it returns, see Deliver
+  bool loopDone;
+  bool hasPending;
+  CaptureBatch pending;
+  std::condition_variable pendingTaken;
+  double dropped;
+  uv_async_t *async;
+  Nan::Callback *callback;
+  Nan::Callback *stopCallback;
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "VideoCaptureWrap.h"
 #include "Matrix.h"
 #include "OpenCV.h"
+#include "Profiler.h"
 
 #include  <iostream>
 
@@ -37,6 +38,9 @@ void VideoCaptureWrap::Init(Local<Object> target) {
   Nan::SetPrototypeMethod(ctor, "ReadSync", ReadSync);
   Nan::SetPrototypeMethod(ctor, "grab", Grab);
   Nan::SetPrototypeMethod(ctor, "retrieve", Retrieve);
+  Nan::SetPrototypeMethod(ctor, "startGrabbing", StartGrabbing);
+  Nan::SetPrototypeMethod(ctor, "stopGrabbing", StopGrabbing);
+  Nan::SetPrototypeMethod(ctor, "grabberStats", GrabberStats);
 
   target->Set(Nan::New("VideoCapture").ToLocalChecked(), ctor->GetFunction());
 }
@@ -79,6 +83,12 @@ VideoCaptureWrap::VideoCaptureWrap(const std::string& filename) {
   }
 }
 
+VideoCaptureWrap::~VideoCaptureWrap() {
+  if (grabber) {
+    grabber->Stop();
+  }
+}
+
 NAN_METHOD(VideoCaptureWrap::SetWidth) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
@@ -88,6 +98,7 @@ NAN_METHOD(VideoCaptureWrap::SetWidth) {
 
   int w = info[0]->IntegerValue();
 
+  std::lock_guard<std::mutex> lock(v->capMutex);
   if(v->cap.isOpened())
   v->cap.set(CV_CAP_PROP_FRAME_WIDTH, w);
 
@@ -98,6 +109,7 @@ NAN_METHOD(VideoCaptureWrap::GetFrameCount) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
 
+  std::lock_guard<std::mutex> lock(v->capMutex);
   int cnt = int(v->cap.get(CV_CAP_PROP_FRAME_COUNT));
 
   info.GetReturnValue().Set(Nan::New<Number>(cnt));
@@ -112,6 +124,7 @@ NAN_METHOD(VideoCaptureWrap::SetHeight) {
 
   int h = info[0]->IntegerValue();
 
+  std::lock_guard<std::mutex> lock(v->capMutex);
   v->cap.set(CV_CAP_PROP_FRAME_HEIGHT, h);
 
   return;
@@ -126,6 +139,7 @@ NAN_METHOD(VideoCaptureWrap::SetPosition) {
 
   int pos = info[0]->IntegerValue();
 
+  std::lock_guard<std::mutex> lock(v->capMutex);
   v->cap.set(CV_CAP_PROP_POS_FRAMES, pos);
 
   return;
@@ -140,6 +154,7 @@ NAN_METHOD(VideoCaptureWrap::GetFrameAt) {
 
   int pos = info[0]->IntegerValue();
 
+  std::lock_guard<std::mutex> lock(v->capMutex);
   v->cap.set(CV_CAP_PROP_POS_MSEC, pos);
 
   return;
@@ -149,6 +164,11 @@ NAN_METHOD(VideoCaptureWrap::Release) {
   Nan::HandleScope scope;
   VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
 
+  if (v->grabber) {
+    v->grabber->Stop();
+  }
+
+  std::lock_guard<std::mutex> lock(v->capMutex);
   v->cap.release();
 
   return;
@@ -161,7 +181,11 @@ public:
       Nan::AsyncWorker(callback),
       vc(vc),
       retrieve(retrieve),
-      channel(channel) {
+      channel(channel),
+      queuedAt(Profiler::Now()) {
+    static int readOp = Profiler::Register("VideoCapture.read:worker");
+    static int retrieveOp = Profiler::Register("VideoCapture.retrieve:worker");
+    profilerOp = retrieve ? retrieveOp : readOp;
   }
 
   ~AsyncVCWorker() {
@@ -172,6 +196,8 @@ public:
   // here, so everything we need for input and output
   // should go on `this`.
   void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
+    std::lock_guard<std::mutex> lock(vc->capMutex);
     if (retrieve) {
       if (!this->vc->cap.retrieve(mat, channel)) {
         SetErrorMessage("retrieve failed");
@@ -208,6 +234,8 @@ private:
   cv::Mat mat;
   bool retrieve;
   int channel;
+  uint64_t queuedAt;
+  int profilerOp;
 };
 
 NAN_METHOD(VideoCaptureWrap::Read) {
@@ -217,7 +245,15 @@ NAN_METHOD(VideoCaptureWrap::Read) {
   REQ_FUN_ARG(0, cb);
 
   Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
-  Nan::AsyncQueueWorker(new AsyncVCWorker(callback, v));
+  if (v->grabber) {
+    // Waits for the ring without holding a thread pool thread
+    v->grabber->Read(callback, info.This());
+    return;
+  }
+
+  AsyncVCWorker *worker = new AsyncVCWorker(callback, v);
+  worker->SaveToPersistent("capture", info.This());
+  Nan::AsyncQueueWorker(worker);
 
   return;
 }
@@ -229,7 +265,12 @@ NAN_METHOD(VideoCaptureWrap::ReadSync) {
   Local<Object> im_to_return= Nan::NewInstance(Nan::GetFunction(Nan::New(Matrix::constructor)).ToLocalChecked()).ToLocalChecked();
   Matrix *img = Nan::ObjectWrap::Unwrap<Matrix>(im_to_return);
 
-  v->cap.read(img->mat);
+  if (v->grabber) {
+    v->grabber->Pop(img->mat);
+  } else {
+    std::lock_guard<std::mutex> lock(v->capMutex);
+    v->cap.read(img->mat);
+  }
 
   info.GetReturnValue().Set(im_to_return);
 }
@@ -238,13 +279,18 @@ class AsyncGrabWorker: public Nan::AsyncWorker {
 public:
   AsyncGrabWorker(Nan::Callback *callback, VideoCaptureWrap* vc) :
       Nan::AsyncWorker(callback),
-      vc(vc) {
+      vc(vc),
+      queuedAt(Profiler::Now()) {
+    static int op = Profiler::Register("VideoCapture.grab:worker");
+    profilerOp = op;
   }
 
   ~AsyncGrabWorker() {
   }
 
   void Execute() {
+    Profiler::Timer timer(profilerOp, queuedAt);
+    std::lock_guard<std::mutex> lock(vc->capMutex);
     if (!this->vc->cap.grab()) {
       SetErrorMessage("grab failed");
     }
@@ -252,6 +298,8 @@ public:
 
 private:
   VideoCaptureWrap *vc;
+  uint64_t queuedAt;
+  int profilerOp;
 };
 
 NAN_METHOD(VideoCaptureWrap::Grab) {
@@ -260,8 +308,14 @@ NAN_METHOD(VideoCaptureWrap::Grab) {
 
   REQ_FUN_ARG(0, cb);
 
+  if (v->grabber) {
+    return Nan::ThrowError("Cannot grab while background grabbing is enabled");
+  }
+
   Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
-  Nan::AsyncQueueWorker(new AsyncGrabWorker(callback, v));
+  AsyncGrabWorker *worker = new AsyncGrabWorker(callback, v);
+  worker->SaveToPersistent("capture", info.This());
+  Nan::AsyncQueueWorker(worker);
 
   return;
 }
@@ -274,8 +328,303 @@ NAN_METHOD(VideoCaptureWrap::Retrieve) {
   REQ_FUN_ARG(0, cb);
   INT_FROM_ARGS(channel, 1);
 
+  if (v->grabber) {
+    return Nan::ThrowError("Cannot retrieve while background grabbing is enabled");
+  }
+
   Nan::Callback *callback = new Nan::Callback(cb.As<Function>());
-  Nan::AsyncQueueWorker(new AsyncVCWorker(callback, v, true, channel));
+  AsyncVCWorker *worker = new AsyncVCWorker(callback, v, true, channel);
+  worker->SaveToPersistent("capture", info.This());
+  Nan::AsyncQueueWorker(worker);
+
+  return;
+}
+
+FrameGrabber::FrameGrabber(VideoCaptureWrap *vc, size_t size, Policy policy) :
+    size(size),
+    policy(policy),
+    vc(vc),
+    ring(size),
+    head(0),
+    count(0),
+    running(false),
+    grabbed(0),
+    dropped(0),
+    async(NULL),
+    wanted(false) {
+}
+
+FrameGrabber::~FrameGrabber() {
+  Stop();
+
+  if (async) {
+    uv_close(reinterpret_cast<uv_handle_t *>(async), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_async_t *>(handle);
+    });
+  }
+  capture.Reset();
+}
+
+void FrameGrabber::Start() {
+  // Only holds the loop open while a read() waits
+  async = new uv_async_t();
+  async->data = this;
+  uv_async_init(uv_default_loop(), async, Deliver);
+  uv_unref(reinterpret_cast<uv_handle_t *>(async));
+
+  std::lock_guard<std::mutex> lock(mutex);
+  running = true;
+  thread = std::thread(&FrameGrabber::Run, this);
+}
+
+void FrameGrabber::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  notFull.notify_all();
+  notEmpty.notify_all();
+
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+bool FrameGrabber::Running() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return running;
+}
+
+void FrameGrabber::Stats(double &grabbed, double &dropped, size_t &depth) {
+  std::lock_guard<std::mutex> lock(mutex);
+  grabbed = this->grabbed;
+  dropped = this->dropped;
+  depth = count;
+}
+
+void FrameGrabber::Run() {
+  // Swapped with the slot it fills, so once every slot has been used the
+  // source always decodes into memory the ring already owns
+  cv::Mat frame;
+
+  while (true) {
+    bool ok;
+    {
+      std::lock_guard<std::mutex> lock(vc->capMutex);
+      ok = vc->cap.read(frame);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!running) {
+      break;
+    }
+    if (!ok) {
+      // End of the file, or the device went away
+      running = false;
+      break;
+    }
+
+    if (count == size) {
+      if (policy == BLOCK) {
+        notFull.wait(lock, [this] { return count < size || !running; });
+        if (!running) {
+          break;
+        }
+      } else {
+        head = (head + 1) % size;
+        count--;
+        dropped++;
+      }
+    }
+
+    std::swap(ring[(head + count) % size], frame);
+    count++;
+    grabbed++;
+    notEmpty.notify_one();
+    if (wanted) {
+      uv_async_send(async);
+    }
+  }
+
+  notEmpty.notify_all();
+  std::lock_guard<std::mutex> lock(mutex);
+  if (wanted) {
+    uv_async_send(async);
+  }
+}
+
+void FrameGrabber::Take(cv::Mat &frame) {
+  // A copy rather than a reference, so the slot keeps its buffer. Into the
+  // caller's own buffer when it already has one of the right size.
+  ring[head].copyTo(frame);
+  head = (head + 1) % size;
+  count--;
+  notFull.notify_one();
+}
+
+bool FrameGrabber::Pop(cv::Mat &frame) {
+  std::unique_lock<std::mutex> lock(mutex);
+  notEmpty.wait(lock, [this] { return count > 0 || !running; });
+
+  if (count == 0) {
+    return false;
+  }
+  Take(frame);
+  return true;
+}
+
+void FrameGrabber::Read(Nan::Callback *callback, Local<Object> capture) {
+  if (readers.empty()) {
+    this->capture.Reset(capture);
+    self = shared_from_this();
+    uv_ref(reinterpret_cast<uv_handle_t *>(async));
+  }
+  readers.push_back(callback);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    wanted = true;
+  }
+  // Served from Deliver even when a frame is ready, so the callback is
+  // always asynchronous
+  uv_async_send(async);
+}
+
+// Runs on the main thread when a frame arrived or the grabber stopped while
+// read() callbacks were waiting
+void FrameGrabber::Deliver(uv_async_t *handle) {
+  Nan::HandleScope scope;
+  // The last reader lets go of self, so hold on until the end
+  std::shared_ptr<FrameGrabber> grabber = static_cast<FrameGrabber *>(handle->data)->self;
+  if (!grabber) {
+    return;
+  }
+
+  while (!grabber->readers.empty()) {
+    cv::Mat frame;
+    {
+      std::lock_guard<std::mutex> lock(grabber->mutex);
+      if (grabber->count > 0) {
+        grabber->Take(frame);
+      } else if (grabber->running) {
+        break;
+      }
+      // Otherwise the stream has ended, and frame stays empty like cap.read
+    }
+
+    Nan::Callback *callback = grabber->readers.front();
+    grabber->readers.pop_front();
+
+    Local<Object> im = Matrix::NewInstance();
+    Nan::ObjectWrap::Unwrap<Matrix>(im)->mat = frame;
+    Local<Value> argv[] = {
+      Nan::Null(),
+      im
+    };
+
+    Nan::TryCatch try_catch;
+    callback->Call(2, argv);
+    delete callback;
+    if (try_catch.HasCaught()) {
+      Nan::FatalException(try_catch);
+    }
+  }
+
+  if (grabber->readers.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(grabber->mutex);
+      grabber->wanted = false;
+    }
+    uv_unref(reinterpret_cast<uv_handle_t *>(grabber->async));
+    grabber->capture.Reset();
+    grabber->self.reset();
+  }
+}
+
+// cap.startGrabbing({size: 4, policy: 'dropOldest'})
+// Starts reading frames on a background thread into a ring of `size` frames.
+// When the ring is full the 'dropOldest' policy overwrites the oldest unread
+// frame, which suits live sources, while 'block' pauses reading until a frame
+// is consumed. read() and ReadSync() take frames from the ring until
+// stopGrabbing() is called.
+NAN_METHOD(VideoCaptureWrap::StartGrabbing) {
+  Nan::HandleScope scope;
+  VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+
+  int size = 4;
+  FrameGrabber::Policy policy = FrameGrabber::DROP_OLDEST;
+
+  if (info.Length() > 0 && info[0]->IsObject()) {
+    Local<Object> options = info[0]->ToObject();
+    Local<String> sizeKey = Nan::New("size").ToLocalChecked();
+    Local<String> policyKey = Nan::New("policy").ToLocalChecked();
+
+    if (Nan::Has(options, sizeKey).FromJust()) {
+      size = Nan::Get(options, sizeKey).ToLocalChecked()->Int32Value();
+    }
+    if (Nan::Has(options, policyKey).FromJust()) {
+      std::string p = *Nan::Utf8String(Nan::Get(options, policyKey).ToLocalChecked());
+      if (p == "block") {
+        policy = FrameGrabber::BLOCK;
+      } else if (p != "dropOldest") {
+        return Nan::ThrowTypeError("policy must be 'dropOldest' or 'block'");
+      }
+    }
+  }
+
+  if (size < 1) {
+    return Nan::ThrowRangeError("size must be at least 1");
+  }
+  if (v->grabber && v->grabber->Running()) {
+    return Nan::ThrowError("Background grabbing is already running");
+  }
+  if (!v->cap.isOpened()) {
+    return Nan::ThrowError("VideoCapture is not open");
+  }
+
+  v->grabber = std::make_shared<FrameGrabber>(v, size, policy);
+  v->grabber->Start();
+
+  return;
+}
+
+NAN_METHOD(VideoCaptureWrap::StopGrabbing) {
+  Nan::HandleScope scope;
+  VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+
+  if (v->grabber) {
+    // Reads still waiting on the ring see the end of the stream
+    v->grabber->Stop();
+    v->grabber.reset();
+  }
 
   return;
 }
+
+// Returns {running, size, depth, grabbed, dropped}, where depth is the
+// number of frames waiting to be read.
+NAN_METHOD(VideoCaptureWrap::GrabberStats) {
+  Nan::HandleScope scope;
+  VideoCaptureWrap *v = Nan::ObjectWrap::Unwrap<VideoCaptureWrap>(info.This());
+
+  bool running = false;
+  size_t size = 0;
+  size_t depth = 0;
+  double grabbed = 0;
+  double dropped = 0;
+
+  if (v->grabber) {
+    running = v->grabber->Running();
+    size = v->grabber->size;
+    v->grabber->Stats(grabbed, dropped, depth);
+  }
+
+  Local<Object> stats = Nan::New<Object>();
+  stats->Set(Nan::New("running").ToLocalChecked(), Nan::New<Boolean>(running));
+  stats->Set(Nan::New("size").ToLocalChecked(), Nan::New<Number>(size));
+  stats->Set(Nan::New("depth").ToLocalChecked(), Nan::New<Number>(depth));
+  stats->Set(Nan::New("grabbed").ToLocalChecked(), Nan::New<Number>(grabbed));
+  stats->Set(Nan::New("dropped").ToLocalChecked(), Nan::New<Number>(dropped));
+
+  info.GetReturnValue().Set(stats);
+}
@@ -1,8 +1,83 @@
 #include "OpenCV.h"
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class VideoCaptureWrap;
+
+/**
+ * Reads frames from a VideoCapture on its own thread into a bounded ring,
+ * so decoding happens ahead of the consumer rather than on its critical path.
+ *
+ * The ring's frames keep their buffers: consumers get a copy, and the slot
+ * is decoded into again, so a running grabber does not allocate. read()
+ * callbacks wait on the event loop rather than on a thread pool thread.
+ */
+class FrameGrabber: public std::enable_shared_from_this<FrameGrabber> {
+public:
+  enum Policy {
+    DROP_OLDEST,  // overwrite the oldest unread frame when the ring is full
+    BLOCK         // stop reading from the source until there is room
+  };
+
+  FrameGrabber(VideoCaptureWrap *vc, size_t size, Policy policy);
+  ~FrameGrabber();
+
+  void Start();
+  void Stop();
+
+  // Copies out the oldest frame, waiting for one if the ring is empty.
+  // Returns false once the grabber has stopped and the ring has been drained.
+  bool Pop(cv::Mat &frame);
+
+  // Calls back from the event loop with the next frame, or an empty one at
+  // the end of the stream. The capture is kept alive until then.
+  void Read(Nan::Callback *callback, Local<Object> capture);
+
+  bool Running();
+  void Stats(double &grabbed, double &dropped, size_t &depth);
+
+  const size_t size;
+  const Policy policy;
+
+private:
+  void Run();
+  // Copies the oldest frame out and frees its slot, with mutex held
+  void Take(cv::Mat &frame);
+  static void Deliver(uv_async_t *handle);
+
+  VideoCaptureWrap *vc;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+
+  std::vector<cv::Mat> ring;
+  size_t head;
+  size_t count;
+  bool running;
+  double grabbed;
+  double dropped;
+
+  // Main thread only, except `wanted` which is guarded by mutex
+  uv_async_t *async;
+  std::deque<Nan::Callback *> readers;
+  bool wanted;
+  Nan::Persistent<Object> capture;
+  // Keeps this alive while readers wait, even once stopGrabbing() let go
+  std::shared_ptr<FrameGrabber> self;
+};
+
 class VideoCaptureWrap: public Nan::ObjectWrap {
 public:
   cv::VideoCapture cap;
+  // Held around every use of cap, which may come from several threads
+  std::mutex capMutex;
+  // Set while background grabbing is enabled, see startGrabbing
+  std::shared_ptr<FrameGrabber> grabber;
 
   static Nan::Persistent<FunctionTemplate> constructor;
   static void Init(Local<Object> target);
@@ -10,6 +85,7 @@ public:
 
   VideoCaptureWrap(const std::string& filename);
   VideoCaptureWrap(int device);
+  ~VideoCaptureWrap();
 
   static NAN_METHOD(Read);
   static NAN_METHOD(ReadSync);
@@ -29,4 +105,9 @@ public:
 
   // release the stream
   static NAN_METHOD(Release);
+
+  // Read frames ahead on a background thread
+  static NAN_METHOD(StartGrabbing);
+  static NAN_METHOD(StopGrabbing);
+  static NAN_METHOD(GrabberStats);
 };
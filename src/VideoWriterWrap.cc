@@ -0,0 +1,382 @@
+#include "VideoWriterWrap.h"
+#include "Matrix.h"
+#include "Size.h"
+#include "Profiler.h"
+
+Nan::Persistent<FunctionTemplate> VideoWriterWrap::constructor;
+
+static int writeProfilerOp;
+
+void VideoWriterWrap::Init(Local<Object> target) {
+  Nan::HandleScope scope;
+
+  writeProfilerOp = Profiler::Register("VideoWriter.write:worker");
+
+  Local<FunctionTemplate> ctor = Nan::New<FunctionTemplate>(VideoWriterWrap::New);
+  constructor.Reset(ctor);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("VideoWriter").ToLocalChecked());
+
+  Nan::SetPrototypeMethod(ctor, "write", Write);
+  Nan::SetPrototypeMethod(ctor, "release", Release);
+  Nan::SetPrototypeMethod(ctor, "isOpened", IsOpened);
+  Nan::SetPrototypeMethod(ctor, "stats", Stats);
+
+  target->Set(Nan::New("VideoWriter").ToLocalChecked(), ctor->GetFunction());
+}
+
+// new cv.VideoWriter(filename, fourcc, fps, size, [{isColor: true, queueSize: 8}])
+// fourcc is a four character code such as 'MJPG', or the number OpenCV uses
+// for it. Which codecs and containers work depends on how OpenCV was built.
+NAN_METHOD(VideoWriterWrap::New) {
+  Nan::HandleScope scope;
+
+  if (info.This()->InternalFieldCount() == 0) {
+    return Nan::ThrowTypeError("Cannot Instantiate without new");
+  }
+  if (info.Length() < 4 || !info[0]->IsString() || !info[2]->IsNumber()) {
+    return Nan::ThrowTypeError("VideoWriter takes (filename, fourcc, fps, size, [options])");
+  }
+
+  std::string filename = *Nan::Utf8String(info[0]);
+  double fps = info[2]->NumberValue();
+
+  int fourcc;
+  if (info[1]->IsString()) {
+    std::string code = *Nan::Utf8String(info[1]);
+    if (code.size() != 4) {
+      return Nan::ThrowTypeError("fourcc must be a four character code such as 'MJPG'");
+    }
+    fourcc = (code[0] & 255) | ((code[1] & 255) << 8) |
+        ((code[2] & 255) << 16) | ((code[3] & 255) << 24);
+  } else if (info[1]->IsNumber()) {
+    fourcc = info[1]->Int32Value();
+  } else {
+    return Nan::ThrowTypeError("fourcc must be a four character code such as 'MJPG'");
+  }
+
+  cv::Size size;
+  try {
+    size = Size::RawSize(1, new Local<Value>[1] { info[3] });
+  } catch(const char* msg) {
+    return Nan::ThrowTypeError(msg);
+  }
+  if (size.area() == 0) {
+    return Nan::ThrowError("Area of size must be > 0");
+  }
+
+  bool isColor = true;
+  int queueSize = 8;
+  if (info.Length() > 4 && info[4]->IsObject()) {
+    Local<Object> options = info[4]->ToObject();
+    Local<String> isColorKey = Nan::New("isColor").ToLocalChecked();
+    Local<String> queueSizeKey = Nan::New("queueSize").ToLocalChecked();
+    if (Nan::Has(options, isColorKey).FromJust()) {
+      isColor = Nan::Get(options, isColorKey).ToLocalChecked()->BooleanValue();
+    }
+    if (Nan::Has(options, queueSizeKey).FromJust()) {
+      queueSize = Nan::Get(options, queueSizeKey).ToLocalChecked()->Int32Value();
+      if (queueSize < 1) {
+        return Nan::ThrowTypeError("queueSize must be at least 1");
+      }
+    }
+  }
+
+  VideoWriterWrap *w = new VideoWriterWrap(queueSize);
+  w->frameSize = size;
+  w->isColor = isColor;
+  try {
+    w->writer.open(filename, fourcc, fps, size, isColor);
+  } catch (cv::Exception &e) {
+  }
+  if (!w->writer.isOpened()) {
+    delete w;
+    return Nan::ThrowError("Video file could not be opened for writing");
+  }
+
+  w->thread = std::thread(&VideoWriterWrap::Run, w);
+  w->Wrap(info.This());
+
+  info.GetReturnValue().Set(info.This());
+}
+
+VideoWriterWrap::VideoWriterWrap(size_t queueSize) :
+    isColor(true),
+    queueSize(queueSize),
+    closing(false),
+    finished(false),
+    written(0),
+    refed(false),
+    drainCallback(NULL),
+    releaseCallback(NULL) {
+  async = new uv_async_t();
+  async->data = this;
+  uv_async_init(uv_default_loop(), async, Deliver);
+  // Only holds the loop open while a callback is waiting, see UpdateRef
+  uv_unref(reinterpret_cast<uv_handle_t *>(async));
+}
+
+VideoWriterWrap::~VideoWriterWrap() {
+  Finish();
+
+  if (async) {
+    uv_close(reinterpret_cast<uv_handle_t *>(async), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_async_t *>(handle);
+    });
+  }
+  delete drainCallback;
+  delete releaseCallback;
+}
+
+void VideoWriterWrap::Run() {
+  while (true) {
+    QueuedFrame frame;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      notEmpty.wait(lock, [this] { return closing || !queue.empty(); });
+      if (queue.empty()) {
+        break;
+      }
+      // Stays queued while it is encoded, so it counts against queueSize
+      frame = queue.front();
+    }
+
+    {
+      Profiler::Timer timer(writeProfilerOp, frame.queuedAt);
+      timer.bytes = frame.mat.dataend - frame.mat.datastart;
+      try {
+        writer.write(frame.mat);
+      } catch (cv::Exception &e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (error.empty()) {
+          error = e.what();
+        }
+      }
+    }
+
+    bool room;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.pop_front();
+      written++;
+      room = queue.size() == queueSize - 1;
+    }
+    if (room) {
+      uv_async_send(async);
+    }
+  }
+
+  try {
+    writer.release();
+  } catch (cv::Exception &e) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (error.empty()) {
+      error = e.what();
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+  }
+  uv_async_send(async);
+}
+
+void VideoWriterWrap::Finish() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    closing = true;
+  }
+  notEmpty.notify_all();
+
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+void VideoWriterWrap::UpdateRef() {
+  bool waiting = async && (drainCallback || releaseCallback);
+  if (waiting == refed) {
+    return;
+  }
+
+  refed = waiting;
+  if (waiting) {
+    uv_ref(reinterpret_cast<uv_handle_t *>(async));
+    Ref();
+  } else {
+    if (async) {
+      uv_unref(reinterpret_cast<uv_handle_t *>(async));
+    }
+    Unref();
+  }
+}
+
+// Runs on the main thread when the queue has room again, and once the
+// encoder has finished
+void VideoWriterWrap::Deliver(uv_async_t *handle) {
+  Nan::HandleScope scope;
+  VideoWriterWrap *self = static_cast<VideoWriterWrap *>(handle->data);
+
+  bool room, finished;
+  std::string error;
+  {
+    std::lock_guard<std::mutex> lock(self->mutex);
+    room = self->queue.size() < self->queueSize;
+    finished = self->finished;
+    error = self->error;
+  }
+
+  Nan::Callback *drain = NULL;
+  Nan::Callback *release = NULL;
+  if (self->drainCallback && (room || finished)) {
+    drain = self->drainCallback;
+    self->drainCallback = NULL;
+  }
+  if (finished) {
+    release = self->releaseCallback;
+    self->releaseCallback = NULL;
+
+    if (self->thread.joinable()) {
+      self->thread.join();
+    }
+    uv_close(reinterpret_cast<uv_handle_t *>(self->async), [](uv_handle_t *handle) {
+      delete reinterpret_cast<uv_async_t *>(handle);
+    });
+    self->async = NULL;
+  }
+
+  Local<Value> argv[1];
+  if (error.empty()) {
+    argv[0] = Nan::Null();
+  } else {
+    argv[0] = Nan::Error(error.c_str());
+  }
+
+  Nan::Callback *callbacks[] = {drain, release};
+  for (int i = 0; i < 2; i++) {
+    if (!callbacks[i]) {
+      continue;
+    }
+    Nan::TryCatch try_catch;
+    callbacks[i]->Call(1, argv);
+    delete callbacks[i];
+    if (try_catch.HasCaught()) {
+      Nan::FatalException(try_catch);
+    }
+  }
+
+  // Last, as it may let the object be collected
+  self->UpdateRef();
+}
+
+// writer.write(mat, [function(err) {}])
+// Queues a copy of the frame for the encoder and returns at once. Returns
+// false when the queue is full, in which case the callback, if any, is called
+// once there is room again; otherwise the callback is not used. Frames are
+// still taken when the queue is full, so it is up to the caller to wait.
+// Throws if an earlier frame failed to encode.
+NAN_METHOD(VideoWriterWrap::Write) {
+  SETUP_FUNCTION(VideoWriterWrap)
+
+  if (info.Length() < 1 || !Nan::New(Matrix::constructor)->HasInstance(info[0])) {
+    return Nan::ThrowTypeError("Argument 1 must be a Matrix");
+  }
+  Matrix *im = UNWRAP_ARG(Matrix, 0);
+
+  if (im->mat.size() != self->frameSize) {
+    return Nan::ThrowError("Frame size does not match the size of the VideoWriter");
+  }
+  if (im->mat.type() != (self->isColor ? CV_8UC3 : CV_8UC1)) {
+    return Nan::ThrowError(self->isColor ? "Frames must be 8 bit, 3 channel BGR" : "Frames must be 8 bit grayscale");
+  }
+
+  bool hasCallback = info.Length() > 1 && info[1]->IsFunction();
+  if (hasCallback && self->drainCallback) {
+    return Nan::ThrowError("A write is already waiting for the queue to drain");
+  }
+
+  std::string error;
+  bool closing, room;
+  {
+    std::lock_guard<std::mutex> lock(self->mutex);
+    error = self->error;
+    closing = self->closing;
+    if (error.empty() && !closing) {
+      // JS may go on to change the Matrix, so the encoder gets its own copy
+      QueuedFrame frame = {im->mat.clone(), Profiler::Now()};
+      self->queue.push_back(frame);
+    }
+    room = self->queue.size() < self->queueSize;
+  }
+  self->notEmpty.notify_one();
+
+  if (closing) {
+    return Nan::ThrowError("VideoWriter has been released");
+  }
+  if (!error.empty()) {
+    return Nan::ThrowError(error.c_str());
+  }
+
+  if (!room && hasCallback) {
+    self->drainCallback = new Nan::Callback(info[1].As<Function>());
+    self->UpdateRef();
+  }
+
+  info.GetReturnValue().Set(Nan::New<Boolean>(room));
+}
+
+// writer.release([function(err) {}])
+// Takes no more frames, and closes the file once the queued frames have been
+// encoded. Without a callback this waits for the encoder, and throws if any
+// frame failed to encode.
+NAN_METHOD(VideoWriterWrap::Release) {
+  SETUP_FUNCTION(VideoWriterWrap)
+
+  {
+    std::lock_guard<std::mutex> lock(self->mutex);
+    if (self->closing) {
+      return Nan::ThrowError("VideoWriter has already been released");
+    }
+  }
+
+  if (info.Length() > 0 && info[0]->IsFunction()) {
+    self->releaseCallback = new Nan::Callback(info[0].As<Function>());
+    self->UpdateRef();
+
+    {
+      std::lock_guard<std::mutex> lock(self->mutex);
+      self->closing = true;
+    }
+    self->notEmpty.notify_all();
+    return;
+  }
+
+  self->Finish();
+
+  std::lock_guard<std::mutex> lock(self->mutex);
+  if (!self->error.empty()) {
+    return Nan::ThrowError(self->error.c_str());
+  }
+}
+
+NAN_METHOD(VideoWriterWrap::IsOpened) {
+  SETUP_FUNCTION(VideoWriterWrap)
+
+  std::lock_guard<std::mutex> lock(self->mutex);
+  info.GetReturnValue().Set(Nan::New<Boolean>(!self->closing));
+}
+
+// Returns {queued, written, queueSize}, where queued includes the frame
+// being encoded.
+NAN_METHOD(VideoWriterWrap::Stats) {
+  SETUP_FUNCTION(VideoWriterWrap)
+
+  std::lock_guard<std::mutex> lock(self->mutex);
+  Local<Object> stats = Nan::New<Object>();
+  stats->Set(Nan::New("queued").ToLocalChecked(), Nan::New<Number>(self->queue.size()));
+  stats->Set(Nan::New("written").ToLocalChecked(), Nan::New<Number>(self->written));
+  stats->Set(Nan::New("queueSize").ToLocalChecked(), Nan::New<Number>(self->queueSize));
+
+  info.GetReturnValue().Set(stats);
+}
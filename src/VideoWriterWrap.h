@@ -0,0 +1,67 @@
+#ifndef __NODE_VIDEOWRITERWRAP_H
+#define __NODE_VIDEOWRITERWRAP_H
+
+#include "OpenCV.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+/**
+ * cv.VideoWriter, encodes frames into a video file on its own thread.
+ *
+ * write() only queues the frame, so the encoder never runs on the event loop.
+ * The queue holds up to queueSize frames; write() returns false once it is
+ * full, and calls back when there is room again, like a Node stream.
+ */
+class VideoWriterWrap: public Nan::ObjectWrap {
+public:
+  static Nan::Persistent<FunctionTemplate> constructor;
+  static void Init(Local<Object> target);
+  static NAN_METHOD(New);
+
+  VideoWriterWrap(size_t queueSize);
+  ~VideoWriterWrap();
+
+  static NAN_METHOD(Write);
+  static NAN_METHOD(Release);
+  static NAN_METHOD(IsOpened);
+  static NAN_METHOD(Stats);
+
+private:
+  struct QueuedFrame {
+    cv::Mat mat;
+    uint64_t queuedAt;
+  };
+
+  void Run();
+  // Stops taking frames and waits for the encoder to finish the queue
+  void Finish();
+  // Keeps the event loop, and this object, alive while JS waits on a callback
+  void UpdateRef();
+  static void Deliver(uv_async_t *handle);
+
+  cv::VideoWriter writer;
+  cv::Size frameSize;
+  bool isColor;
+  const size_t queueSize;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable notEmpty;
+  std::deque<QueuedFrame> queue;
+  bool closing;
+  bool finished;
+  double written;
+  std::string error;
+
+  uv_async_t *async;
+  bool refed;
+  // Waiting for room in the queue, from a write() that returned false
+  Nan::Callback *drainCallback;
+  // Waiting for the encoder to finish, from release()
+  Nan::Callback *releaseCallback;
+};
+
+#endif
@@ -5,8 +5,13 @@
 #include "Rect.h"
 #include "Scalar.h"
 #include "Matrix.h"
+#include "Pipeline.h"
 #include "CascadeClassifierWrap.h"
 #include "VideoCaptureWrap.h"
+#include "VideoCaptureGroup.h"
+#include "VideoWriterWrap.h"
+#include "MjpegProducer.h"
+#include "ImageDecoder.h"
 #include "Contours.h"
 #include "CamShift.h"
 #include "HighGUI.h"
@@ -15,6 +20,8 @@
 #include "Constants.h"
 #include "Calib3D.h"
 #include "ImgProc.h"
+#include "MatPool.h"
+#include "Profiler.h"
 #include "Stereo.h"
 #include "BackgroundSubtractor.h"
 #include "LDAWrap.h"
@@ -28,14 +35,21 @@ extern "C" void init(Local<Object> target) {
   Rect::Init(target);
   Scalar::Init(target);
   Matrix::Init(target);
+  Pipeline::Init(target);
   CascadeClassifierWrap::Init(target);
   VideoCaptureWrap::Init(target);
+  VideoCaptureGroup::Init(target);
+  VideoWriterWrap::Init(target);
+  MjpegProducer::Init(target);
+  ImageDecoder::Init(target);
   Contour::Init(target);
   TrackedObject::Init(target);
   NamedWindow::Init(target);
   Constants::Init(target);
   Calib3D::Init(target);
   ImgProc::Init(target);
+  MatPool::Init(target);
+  Profiler::Init(target);
 #if CV_MAJOR_VERSION < 3
   StereoBM::Init(target);
   StereoSGBM::Init(target);
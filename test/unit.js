@@ -243,6 +243,250 @@ test('Matrix accessors', function(assert){
   assert.end()
 })
 
+test('Matrix getDataView', function(assert) {
+  var mat = new cv.Matrix(2, 3, cv.Constants.CV_8UC3, [1, 2, 3]);
+  var view = mat.getDataView();
+  assert.equal(view.length, 2 * 3 * 3);
+  assert.deepEqual(view, mat.getData());
+
+  // The view shares memory with the matrix
+  view[0] = 42;
+  assert.deepEqual(mat.pixel(0, 0), [42, 2, 3]);
+
+  // and keeps the pixels alive after the matrix lets go of them
+  mat.release();
+  assert.equal(view[1], 2);
+
+  assert.equal(new cv.Matrix().getDataView().length, 0);
+
+  var roi = new cv.Matrix(4, 4, cv.Constants.CV_8UC1).roi(0, 0, 2, 2);
+  assert.throws(function() { roi.getDataView(); }, /continuous/, 'no silent copy of a ROI');
+  assert.equal(roi.clone().getDataView().length, 4);
+  assert.end();
+})
+
+test('Matrix brightness', function(assert) {
+  var mat = new cv.Matrix(1, 2, cv.Constants.CV_8UC3, [10, 100, 200]);
+  mat.brightness(2, 5);
+  assert.deepEqual(mat.pixel(0, 1), [25, 205, 255], 'all channels, saturated');
+  mat.brightness(-30);
+  assert.deepEqual(mat.pixel(0, 0), [0, 175, 225]);
+
+  var gray = new cv.Matrix(1, 1, cv.Constants.CV_8UC1, [100]);
+  gray.brightness(0.5, 0);
+  assert.equal(gray.pixel(0, 0), 50);
+
+  var bgra = cv.Matrix.Zeros(1, 1, cv.Constants.CV_8UC4);
+  bgra.writeRow(0, new Uint8Array([1, 2, 3, 4]));
+  bgra.brightness(1, 1);
+  assert.deepEqual(Array.from(bgra.readRow(0)), [2, 3, 4, 5]);
+
+  var floats = cv.Matrix.Zeros(1, 1, cv.Constants.CV_32FC1);
+  floats.writeRow(0, new Float32Array([0.5]));
+  floats.brightness(4, -0.5);
+  assert.equal(floats.get(0, 0), 1.5);
+
+  assert.throws(function() { mat.brightness() }, /brightness takes/);
+
+  gray.brightnessAsync(2, 1).then(function(res) {
+    assert.equal(res, gray, 'in place');
+    assert.equal(gray.pixel(0, 0), 101);
+    assert.end();
+  }, assert.end);
+})
+
+test('Matrix readRegion/writeRegion', function(assert) {
+  var mat = new cv.Matrix(2, 3, cv.Constants.CV_8UC3, [1, 2, 3]);
+
+  var region = mat.readRegion({x: 1, y: 0, width: 2, height: 2});
+  assert.ok(region instanceof Uint8Array);
+  assert.deepEqual(Array.from(region), [1, 2, 3, 1, 2, 3, 1, 2, 3, 1, 2, 3]);
+
+  // Written with saturation, and in place
+  mat.writeRegion(new cv.Rect(2, 1, 1, 1), new Float32Array([300, -5, 2.6]));
+  assert.deepEqual(mat.pixel(1, 2), [255, 0, 3]);
+
+  var row = mat.readRow(1, new Float32Array(9));
+  assert.deepEqual(Array.from(row), [1, 2, 3, 1, 2, 3, 255, 0, 3]);
+
+  mat.writeCol(0, new Uint8Array([7, 8, 9, 10, 11, 12]));
+  assert.deepEqual(Array.from(mat.readCol(0)), [7, 8, 9, 10, 11, 12]);
+
+  var floats = cv.Matrix.Zeros(2, 2, cv.Constants.CV_32FC1);
+  floats.writeRegion({x: 0, y: 0, width: 2, height: 2}, new Float32Array([0.5, 1.5, 2.5, 3.5]));
+  assert.ok(floats.readRow(0) instanceof Float32Array);
+  assert.deepEqual(Array.from(floats.readRow(0, new Uint8Array(2))), [0, 2], 'rounded to even');
+  assert.deepEqual(Array.from(floats.readRow(1, new Uint8Array(2))), [2, 4]);
+
+  assert.throws(function() { mat.readRegion({x: 2, y: 0, width: 2, height: 1}) }, /inside the matrix/);
+  assert.throws(function() { mat.readRow(0, new Uint8Array(8)) }, /too small/);
+  assert.throws(function() { mat.writeRow(0) }, /typed array/);
+  assert.end();
+})
+
+test('Matrix fromBuffer', function(assert) {
+  var buf = Buffer.from([1, 2, 3, 4, 5, 6, 0, 0, 7, 8, 9, 10, 11, 12]);
+  var mat = cv.Matrix.fromBuffer(buf, 2, 2, cv.Constants.CV_8UC3, 8);
+  assert.equal(mat.width(), 2);
+  assert.equal(mat.height(), 2);
+  assert.deepEqual(mat.pixelRow(1), [7, 8, 9, 10, 11, 12]);
+
+  // No copy is made, so writes to the Buffer show up in the matrix
+  buf[8] = 99;
+  assert.deepEqual(mat.pixel(1, 0), [99, 8, 9]);
+
+  assert.throws(function() { cv.Matrix.fromBuffer(buf, 3, 2, cv.Constants.CV_8UC3) }, /too small/);
+  assert.throws(function() { cv.Matrix.fromBuffer(buf, 2, 2, cv.Constants.CV_8UC3, 4) }, /step/);
+  assert.throws(function() { cv.Matrix.fromBuffer(buf, 2, 2, cv.Constants.CV_8UC3, -1) }, /step/);
+  assert.throws(function() { cv.Matrix.fromBuffer(buf, 3, 2, cv.Constants.CV_8UC3, Math.pow(2, 63)) }, /step/);
+  assert.throws(function() { cv.Matrix.fromBuffer(buf, 2, 2, cv.Constants.CV_8UC3, Math.pow(2, 52)) }, /too small/);
+  assert.throws(function() { cv.Matrix.fromBuffer(buf, 1, 1, cv.Constants.CV_16UC1, 3) }, /multiple/);
+  assert.throws(function() { cv.Matrix.fromBuffer([], 1, 1, cv.Constants.CV_8UC1) }, /Buffer/);
+  assert.end();
+})
+
+test('Matrix async operations', function(assert) {
+  assert.plan(8);
+
+  var mat = cv.Matrix.Zeros(100, 100, cv.Constants.CV_8UC1);
+  mat.rectangle([20, 20], [40, 40], [255], -1);
+
+  mat.clone().gaussianBlurAsync([5, 5]).then(function(res) {
+    assert.equal(res.width(), 100);
+    assert.ok(res.pixel(20, 20) < 255, 'blurred');
+  });
+
+  mat.resizeAsync(new cv.Size(50, 25), function(err, res) {
+    assert.error(err);
+    assert.equal(res.width(), 50);
+    assert.equal(res.height(), 25);
+  });
+
+  mat.findContoursAsync().then(function(contours) {
+    assert.equal(contours.size(), 1);
+    assert.equal(mat.pixel(20, 20), 255, 'source left untouched');
+  });
+
+  // Arguments are validated before the work is queued
+  assert.throws(function() { mat.medianBlurAsync(4) }, /odd/);
+})
+
+test('Pipeline', function(assert) {
+  var mat = cv.Matrix.Zeros(100, 100, cv.Constants.CV_8UC3);
+  mat.rectangle([20, 20], [40, 40], [255, 255, 255], -1);
+
+  var pipeline = new cv.Pipeline()
+    .convertGrayscale()
+    .gaussianBlur([3, 3])
+    .resize(new cv.Size(50, 50));
+  assert.equal(pipeline.size(), 3);
+
+  assert.throws(function() { pipeline.add('noSuchOp') }, /Unknown operation/);
+  assert.throws(function() { pipeline.medianBlur(2) }, /odd/);
+
+  pipeline.run(mat).then(function(res) {
+    assert.equal(res.width(), 50);
+    assert.equal(res.channels(), 1);
+    assert.equal(mat.channels(), 3, 'input left untouched');
+
+    var contours = new cv.Pipeline().convertGrayscale().findContours();
+    assert.throws(function() { contours.pyrDown() }, /Nothing can follow/);
+
+    contours.run(mat, function(err, res) {
+      assert.error(err);
+      assert.equal(res.size(), 1);
+      assert.end();
+    });
+  }, assert.end);
+})
+
+test('Matrix memory pool', function(assert) {
+  if (!cv.matPool.stats().supported) {
+    assert.throws(function() { cv.matPool.enable() }, /OpenCV 3/);
+    return assert.end();
+  }
+
+  cv.matPool.enable({maxBytes: 1024 * 1024});
+  var mat = new cv.Matrix(100, 100, cv.Constants.CV_8UC3);
+  mat.release();
+  assert.equal(cv.matPool.stats().pooledBuffers, 1);
+
+  var before = cv.matPool.stats().hits;
+  mat = new cv.Matrix(100, 100, cv.Constants.CV_8UC3);
+  assert.equal(cv.matPool.stats().hits, before + 1, 'buffer reused');
+  assert.equal(cv.matPool.stats().pooledBuffers, 0);
+
+  // Larger than the cap, so not kept
+  new cv.Matrix(1000, 1000, cv.Constants.CV_8UC3).release();
+  assert.equal(cv.matPool.stats().pooledBuffers, 0);
+
+  cv.matPool.disable();
+  mat.release();
+  var stats = cv.matPool.stats();
+  assert.equal(stats.enabled, false);
+  assert.equal(stats.pooledBytes, 0);
+  assert.end();
+})
+
+test('Matrix memory is reported to V8', function(assert) {
+  if (process.memoryUsage().external === undefined) {
+    return assert.end();
+  }
+
+  var before = process.memoryUsage().external;
+  var mat = new cv.Matrix(1000, 1000, cv.Constants.CV_8UC3);
+  assert.ok(process.memoryUsage().external - before >= 3e6, 'new matrix counted');
+
+  // A roi() shares the parent's pixels, which are already counted
+  var counted = process.memoryUsage().external;
+  var rois = [];
+  for (var i = 0; i < 10; i++) {
+    rois.push(mat.roi(0, 0, 10, 10));
+  }
+  assert.ok(process.memoryUsage().external - counted < 3e6, 'roi() not counted again');
+
+  var small = mat.resize(new cv.Size(100, 100));
+  rois.forEach(function(roi) { roi.release(); });
+  mat.release();
+  var after = process.memoryUsage().external - before;
+  assert.ok(after >= 3e4 && after < 3e6, 'release and new results counted');
+
+  small.release();
+  assert.end();
+})
+
+test('Profiler stats', function(assert) {
+  cv.profiler.enable();
+  cv.profiler.reset();
+
+  var mat = new cv.Matrix(100, 100, cv.Constants.CV_8UC3);
+  for (var i = 0; i < 3; i++) {
+    mat.resize(new cv.Size(50, 50));
+  }
+
+  var stats = cv.stats()['Matrix.resize'];
+  assert.equal(stats.calls, 3);
+  assert.ok(stats.p99Ms >= stats.p50Ms);
+  assert.ok(stats.minMs <= stats.maxMs);
+  assert.ok(stats.totalMs >= stats.maxMs);
+  assert.equal(cv.stats()['Matrix.crop'], undefined, 'uncalled methods left out');
+
+  mat.resizeAsync(new cv.Size(50, 50)).then(function() {
+    var worker = cv.stats()['Matrix.resizeAsync:worker'];
+    assert.equal(worker.calls, 1);
+    assert.ok(worker.bytes >= 50 * 50 * 3, 'allocation counted');
+    assert.ok(worker.queueMs >= 0);
+
+    cv.profiler.disable();
+    mat.resize(new cv.Size(50, 50));
+    assert.equal(cv.stats()['Matrix.resize'].calls, 3, 'nothing recorded while disabled');
+
+    cv.profiler.reset();
+    assert.deepEqual(cv.stats(), {});
+    assert.end();
+  }, assert.end);
+})
+
 test('Matrix functions', function(assert) {
   // convertTo
   var mat = new cv.Matrix(75, 75, cv.Constants.CV_32F, [2.0]);
@@ -304,6 +548,83 @@ test("Matrix toBuffer Async", function(assert){
   })
 })
 
+test("Matrix toBuffer into a Buffer", function(assert){
+  cv.readImage('./examples/files/mona.png', function(err, mat){
+    var expected = mat.toBuffer({ext: '.png'})
+    var out = Buffer.alloc(expected.length + 100)
+
+    var n = mat.toBuffer({ext: '.png', buffer: out})
+    assert.equal(n, expected.length)
+    assert.ok(out.slice(0, n).equals(expected))
+    assert.throws(function() { mat.toBuffer({buffer: Buffer.alloc(10)}) }, /does not fit/)
+    assert.throws(function() { mat.toBuffer({buffer: 'no'}) }, /Buffer/)
+
+    out.fill(0)
+    mat.toBufferAsync(function(err, n) {
+      assert.error(err)
+      assert.equal(n, expected.length)
+      assert.ok(out.slice(0, n).equals(expected))
+
+      mat.toBufferAsync(function(err) {
+        assert.ok(/does not fit/.test(err.message))
+        assert.end()
+      }, {buffer: Buffer.alloc(10)})
+    }, {ext: '.png', buffer: out})
+  })
+})
+test("Matrix toBufferAsync maxBytes", function(assert){
+  cv.readImage('./examples/files/car1.jpg', function(err, im){
+    assert.throws(function() { im.toBuffer({maxBytes: 1000}) }, /callback/)
+    assert.throws(function() { im.toBufferAsync(function() {}, {ext: '.png', maxBytes: 1000}) }, /jpg/)
+    assert.throws(function() { im.toBufferAsync(function() {}, {maxBytes: -1}) }, /maxBytes/)
+
+    var full = im.toBuffer({ext: '.jpg', jpegQuality: 95})
+    var maxBytes = Math.round(full.length / 2)
+    im.toBufferAsync(function(err, buf, quality) {
+      assert.error(err)
+      assert.ok(buf.length <= maxBytes, buf.length + ' <= ' + maxBytes)
+      assert.ok(quality >= 1 && quality < 95, 'quality ' + quality)
+      assert.equal(im.toBuffer({ext: '.jpg', jpegQuality: quality}).length, buf.length)
+      assert.ok(im.toBuffer({ext: '.jpg', jpegQuality: quality + 1}).length > maxBytes,
+          'the highest quality that fits')
+
+      im.toBufferAsync(function(err) {
+        assert.ok(/maxBytes/.test(err.message))
+        assert.end()
+      }, {ext: '.jpg', maxBytes: 100})
+    }, {ext: '.jpg', maxBytes: maxBytes})
+  })
+})
+
+test("Matrix encodeRenditions", function(assert){
+  assert.throws(function() { new cv.Matrix(10, 10).encodeRenditions({}) }, /array/)
+  assert.throws(function() { new cv.Matrix(10, 10).encodeRenditions([{maxWidth: 0}]) }, /maxWidth/)
+
+  cv.readImage('./examples/files/car1.jpg', function(err, im){
+    im.encodeRenditions([
+      {jpegQuality: 90},
+      {maxWidth: 640, jpegQuality: 80},
+      {maxWidth: 160, ext: '.png'},
+      {maxWidth: 4000}
+    ]).then(function(bufs) {
+      assert.equal(bufs.length, 4)
+      assert.equal(bufs[2].slice(1, 4).toString(), 'PNG')
+      return Promise.all(bufs.map(function(buf) { return cv.readImage(buf) }))
+    }).then(function(ims) {
+      assert.deepEqual(ims[0].size(), [680, 1024])
+      assert.deepEqual(ims[1].size(), [425, 640])
+      assert.deepEqual(ims[2].size(), [106, 160])
+      assert.deepEqual(ims[3].size(), [680, 1024], 'never scaled up')
+
+      im.encodeRenditions([{maxWidth: 100}], function(err, bufs) {
+        assert.error(err)
+        assert.equal(bufs.length, 1)
+        assert.end()
+      })
+    }).catch(assert.end)
+  })
+})
+
 
 test("detectObject", function(assert){
   cv.readImage("./examples/files/mona.png", function(err, im){
@@ -416,6 +737,219 @@ test("Cascade Classifier", function(assert){
   })
 })
 
+test("Cascade Classifier concurrent detections", function(assert){
+  var N = 6;
+  assert.plan(N * 2);
+
+  cv.readImage("./examples/files/mona.png", function(err, im){
+    var cascade = new cv.CascadeClassifier("./data/haarcascade_frontalface_alt.xml");
+    for (var i = 0; i < N; i++) {
+      cascade.detectMultiScale(im, function(err, faces){
+        assert.error(err);
+        assert.equal(faces.length, 1);
+      })
+    }
+  })
+})
+
+test("Cascade Classifier batch detection", function(assert){
+  cv.readImage("./examples/files/mona.png", function(err, im){
+    var cascade = new cv.CascadeClassifier("./data/haarcascade_frontalface_alt.xml");
+    var blank = cv.Matrix.Zeros(100, 100, cv.Constants.CV_8UC1);
+
+    cascade.detectMultiScaleBatch([im, blank, im], {}, function(err, res){
+      assert.error(err);
+      assert.ok(res.rects instanceof Int32Array);
+      assert.deepEqual(Array.prototype.slice.call(res.offsets), [0, 1, 1, 2]);
+      assert.equal(res.rects.length, 2 * 4);
+      assert.deepEqual(res.rects.subarray(0, 4), res.rects.subarray(4, 8));
+
+      assert.throws(function() { cascade.detectMultiScaleBatch([im, 'x']) }, /array of Matrix/);
+      assert.end();
+    })
+  })
+})
+
+test("Typed array results", function(assert){
+  var mat = cv.Matrix.Zeros(100, 100, cv.Constants.CV_8UC3);
+  mat.rectangle([20, 20], [40, 40], [255, 255, 255], -1);
+
+  var corners = mat.goodFeaturesToTrack();
+  var typedCorners = mat.goodFeaturesToTrack({typed: true});
+  assert.ok(typedCorners instanceof Float32Array);
+  assert.equal(typedCorners.length, corners.length * 2);
+  assert.deepEqual([typedCorners[0], typedCorners[1]], corners[0]);
+
+  var gray = mat.copy();
+  gray.convertGrayscale();
+  gray.canny(5, 300);
+  var lines = gray.houghLinesP(1, Math.PI / 180, 10, 10, 1, {typed: true});
+  assert.ok(lines instanceof Int32Array);
+  assert.equal(lines.length, gray.houghLinesP(1, Math.PI / 180, 10, 10, 1).length * 4);
+
+  var contours = gray.findContours();
+  var data = contours.serialize({typed: true});
+  assert.equal(data.offsets.length, contours.size() + 1);
+  assert.equal(data.offsets[1], contours.cornerCount(0));
+  assert.equal(data.hierarchy.length, contours.size() * 4);
+
+  var copy = gray.findContours();
+  copy.deserialize(data);
+  assert.deepEqual(copy.serialize(), contours.serialize());
+
+  cv.readImage("./examples/files/mona.png", function(err, im){
+    var cascade = new cv.CascadeClassifier("./data/haarcascade_frontalface_alt.xml");
+    cascade.detectMultiScale(im, function(err, faces){
+      assert.error(err);
+      assert.ok(faces instanceof Int32Array);
+      assert.equal(faces.length, 4);
+      assert.end();
+    }, 1.1, 2, 30, 30, {typed: true});
+  });
+})
+
+
+test('Matrix transforms into dst', function(assert) {
+  cv.readImage('./examples/files/mona.png', function(err, im) {
+    assert.error(err);
+    var before = im.pixel(100, 100);
+
+    var small = new cv.Matrix();
+    assert.equal(im.resize(new cv.Size(100, 80), small), small);
+    assert.deepEqual(small.size(), [80, 100]);
+
+    // A dst of the right size and type is written in place
+    var buf = Buffer.alloc(80 * 100 * 3);
+    var wrapped = cv.Matrix.fromBuffer(buf, 80, 100, cv.Constants.CV_8UC3);
+    im.resize(new cv.Size(100, 80), wrapped);
+    assert.deepEqual(buf, small.getData());
+
+    var gray = new cv.Matrix();
+    assert.equal(small.cvtColor('CV_BGR2GRAY', gray), gray);
+    assert.equal(gray.channels(), 1);
+    assert.equal(small.channels(), 3, 'source left alone');
+
+    var blurred = new cv.Matrix();
+    im.gaussianBlur([5, 5], blurred);
+    assert.deepEqual(blurred.size(), im.size());
+    assert.deepEqual(im.pixel(100, 100), before);
+
+    var rotated = new cv.Matrix();
+    im.rotate(90, rotated);
+    assert.deepEqual(rotated.size(), [im.width(), im.height()]);
+    assert.deepEqual(im.size(), [756, 500]);
+
+    assert.throws(function() { im.gaussianBlur([5, 5], im); }, /share memory/);
+
+    // Side by side ROIs of one frame share a buffer but not pixels
+    var composite = cv.Matrix.Zeros(100, 200, cv.Constants.CV_8UC3);
+    var left = composite.roi(0, 0, 100, 100);
+    left.rectangle([0, 0], [100, 100], [255, 255, 255], -1);
+    left.gaussianBlur([5, 5], composite.roi(100, 0, 100, 100));
+    assert.deepEqual(composite.pixel(50, 150), [255, 255, 255], 'written into the right half');
+    assert.throws(function() { left.gaussianBlur([5, 5], composite.roi(50, 0, 100, 100)); }, /share memory/);
+    assert.end();
+  });
+});
+
+test('readImage options', function(assert) {
+  assert.throws(function() { cv.readImage(PATH_TO_MONA_PNG, {mode: 'sepia'}) }, /mode/);
+  assert.throws(function() { cv.readImage(PATH_TO_MONA_PNG, {maxDim: 0}) }, /maxDim/);
+
+  cv.readImage(PATH_TO_MONA_PNG, {mode: 'grayscale', maxDim: 100}, function(err, im) {
+    assert.error(err);
+    assert.equal(im.channels(), 1);
+    assert.equal(Math.max(im.width(), im.height()), 100);
+    assert.end();
+  });
+});
+
+test('readImage reduce and crop', function(assert) {
+  var car = path.resolve(__dirname, '../examples/files/car1.jpg');
+  assert.throws(function() { cv.readImage(car, {reduce: 3}) }, /reduce/);
+  assert.throws(function() { cv.readImage(car, {reduce: 2, mode: 'unchanged'}) }, /reduce/);
+
+  Promise.all([
+    cv.readImage(car, {reduce: 4}),
+    cv.readImage(car, {maxDim: 200}),
+    cv.readImage(car, {crop: {x: 100, y: 50, width: 300, height: 200}}),
+    cv.readImage(car, {crop: {x: 100, y: 50, width: 300, height: 200}, reduce: 2})
+  ]).then(function(ims) {
+    assert.deepEqual(ims[0].size(), [170, 256], '1024x680 / 4');
+    assert.equal(Math.max(ims[1].width(), ims[1].height()), 200);
+    assert.deepEqual(ims[2].size(), [200, 300]);
+    assert.deepEqual(ims[3].size(), [100, 150]);
+
+    return cv.readImage(car, {crop: {x: 1000, y: 0, width: 100, height: 100}}).then(function() {
+      assert.fail('crop outside the image');
+    }, function(err) {
+      assert.ok(/crop/.test(err.message));
+    });
+  }).then(function() {
+    assert.end();
+  }, assert.end);
+});
+
+test('probeImage', function(assert) {
+  var files = path.resolve(__dirname, '../examples/files');
+  assert.throws(function() { cv.probeImage(0) }, /path, a Buffer/);
+  assert.throws(function() { cv.probeImage(path.join(files, 'nope.png')) }, /open/);
+  assert.throws(function() { cv.probeImage(Buffer.from('not an image')) }, /format/);
+
+  assert.deepEqual(cv.probeImage(path.join(files, 'car1.jpg')),
+    {format: 'jpeg', width: 1024, height: 680, channels: 3, depth: cv.Constants.CV_8U});
+  assert.deepEqual(cv.probeImage(fs.readFileSync(PATH_TO_MONA_PNG)),
+    {format: 'png', width: 500, height: 756, channels: 3, depth: cv.Constants.CV_8U});
+  assert.equal(cv.probeImage(path.join(files, 'alpha-test.png')).channels, 4);
+
+  var tiff = cv.probeImage(path.join(files, 'multipage.tif'));
+  assert.equal(tiff.format, 'tiff');
+  assert.equal(tiff.width, 800);
+  assert.equal(tiff.height, 600);
+
+  var paths = [path.join(files, 'car1.jpg'), path.join(files, 'nope.png'), PATH_TO_MONA_PNG];
+  var probes = cv.probeImage(paths);
+  assert.equal(probes.length, 3);
+  assert.equal(probes[0].width, 1024);
+  assert.ok(/open/.test(probes[1].error));
+  assert.equal(probes[2].format, 'png');
+
+  cv.probeImage(paths, function(err, async) {
+    assert.error(err);
+    assert.deepEqual(async, probes);
+
+    cv.probeImage(paths[1], function(err) {
+      assert.ok(/open/.test(err.message));
+      assert.end();
+    });
+  });
+});
+
+test('readImages', function(assert) {
+  var files = ['mona.png', 'car1.jpg', 'missing.png', 'shapes.jpg'].map(function(f) {
+    return path.resolve(__dirname, '../examples/files', f);
+  });
+  var iterator = cv.readImages(files, {concurrency: 2, maxDim: 64});
+  var results = [];
+
+  function next() {
+    iterator.next().then(function(step) {
+      if (!step.done) {
+        results.push(step.value);
+        return next();
+      }
+
+      assert.deepEqual(results.map(function(r) { return r.index; }), [0, 1, 2, 3]);
+      assert.ok(results[2].error, 'missing file');
+      [0, 1, 3].forEach(function(i) {
+        assert.equal(results[i].path, files[i]);
+        assert.ok(Math.max(results[i].image.width(), results[i].image.height()) <= 64);
+      });
+      assert.end();
+    });
+  }
+  next();
+});
 
 test("ImageDataStream", function(assert){
   var s = new cv.ImageDataStream()
@@ -429,6 +963,36 @@ test("ImageDataStream", function(assert){
 
 })
 
+test("ImageDecoder", function(assert){
+  var data = fs.readFileSync('./examples/files/mona.png')
+  var decoder = new cv.ImageDecoder(data.length)
+
+  for (var i = 0; i < data.length; i += 1000) {
+    decoder.push(data.slice(i, i + 1000))
+  }
+  assert.equal(decoder.length(), data.length)
+
+  decoder.decode(function(err, im){
+    assert.error(err)
+    assert.deepEqual(im.size(), [756,500])
+    assert.throws(function(){ decoder.push(data) }, /decode/)
+
+    new cv.ImageDecoder().decode(function(err){
+      assert.ok(err, 'nothing to decode')
+
+      // A bogus Content-Length is only a hint, and must not abort
+      var huge = new cv.ImageDecoder(1e12)
+      huge.push(data)
+      huge.decode(function(err, im){
+        assert.error(err)
+        assert.deepEqual(im.size(), [756,500])
+        assert.throws(function(){ new cv.ImageDecoder(-1) }, /negative/)
+        assert.end()
+      })
+    })
+  })
+})
+
 test("ImageStream", function(assert){
   var s = new cv.ImageStream()
     , im = fs.readFileSync('./examples/files/mona.png')
@@ -593,5 +1157,152 @@ test('setColor works will alpha channels', function(assert) {
   });
 });
 
+test('VideoCapture background grabbing', function(assert) {
+  var cap = new cv.VideoCapture(path.resolve(__dirname, '../examples/files/motion.mov'));
+  assert.throws(function() { cap.startGrabbing({policy: 'sometimes'}) }, /policy/);
+
+  cap.startGrabbing({size: 2, policy: 'block'});
+  assert.throws(function() { cap.startGrabbing() }, /already running/);
+  assert.throws(function() { cap.grab(function() {}) }, /background grabbing/);
+
+  var frames = 0;
+  cap.read(function next(err, im) {
+    assert.error(err);
+    if (!im.empty() && ++frames < 5) return cap.read(next);
+
+    var stats = cap.grabberStats();
+    assert.equal(stats.size, 2);
+    assert.equal(stats.dropped, 0, 'block policy drops nothing');
+    assert.ok(stats.grabbed >= frames);
+    assert.ok(stats.depth <= 2);
+
+    cap.stopGrabbing();
+    assert.equal(cap.grabberStats().running, false);
+    cap.release();
+    assert.end();
+  });
+});
+
+test('VideoCaptureGroup', function(assert) {
+  var file = path.resolve(__dirname, '../examples/files/motion.mov');
+  var caps = [new cv.VideoCapture(file), new cv.VideoCapture(file)];
+  assert.throws(function() { new cv.VideoCaptureGroup([]) }, /array of VideoCaptures/);
+  assert.throws(function() { new cv.VideoCaptureGroup([caps[0], caps[0]]) }, /once/);
+
+  var group = new cv.VideoCaptureGroup(caps);
+  assert.equal(group.size(), 2);
+
+  group.read(function(err, frames, timestamps) {
+    assert.error(err);
+    assert.equal(frames.length, 2);
+    assert.deepEqual(frames[0].size(), frames[1].size());
+    assert.ok(!frames[0].empty());
+    assert.ok(Math.abs(timestamps[0] - Date.now()) < 10000, 'wall clock ms');
+
+    var batches = 0;
+    group.start(function(err, frames) {
+      assert.error(err);
+      assert.throws(function() { group.read(function() {}) }, /started/);
+      if (++batches < 3 && !frames[0].empty()) return;
+
+      group.stop(function() {
+        var stats = group.stats();
+        assert.equal(stats.running, false);
+        assert.equal(stats.dropped, 0, 'block policy drops nothing');
+        assert.ok(stats.ticks >= 4);
+        assert.ok(stats.skewMs >= 0);
+        caps.forEach(function(cap) { cap.release(); });
+        assert.end();
+      });
+      assert.equal(group.stats().running, false, 'no more batches after stop()');
+    }, {policy: 'block'});
+  });
+});
+
+test('VideoWriter', function(assert) {
+  var file = path.join(require('os').tmpdir(), 'node-opencv-writer-' + process.pid + '.avi');
+  assert.throws(function() { new cv.VideoWriter(file, 'MJPEG', 10, [64, 48]) }, /four character/);
+
+  var writer = new cv.VideoWriter(file, 'MJPG', 10, [64, 48], {queueSize: 2});
+  assert.ok(writer.isOpened());
+  assert.throws(function() { writer.write(new cv.Matrix(10, 10, cv.Constants.CV_8UC3)) }, /size/);
+
+  var stream = writer.toStream();
+  for (var i = 0; i < 10; i++) {
+    var frame = new cv.Matrix(48, 64, cv.Constants.CV_8UC3, [i * 20, 0, 0]);
+    stream.write(frame);
+  }
+  stream.end();
+
+  stream.on('finish', function() {
+    var stats = writer.stats();
+    assert.equal(stats.written, 10);
+    assert.equal(stats.queued, 0);
+    assert.equal(writer.isOpened(), false);
+
+    var cap = new cv.VideoCapture(file);
+    cap.read(function(err, im) {
+      assert.error(err);
+      assert.deepEqual(im.size(), [48, 64]);
+      cap.release();
+      fs.unlinkSync(file);
+      assert.end();
+    });
+  });
+});
+
+test('MjpegProducer', function(assert) {
+  var http = require('http');
+  var cap = new cv.VideoCapture(path.resolve(__dirname, '../examples/files/motion.mov'));
+  assert.throws(function() { new cv.MjpegProducer({}) }, /VideoCapture/);
+  assert.throws(function() { cap.toMjpeg({quality: 20, minQuality: 30}) }, /quality/);
+  assert.throws(function() { cap.toMjpeg({boundary: 'a\r\nb'}) }, /boundary/);
+
+  var producer = cap.toMjpeg({quality: 70, maxWidth: 160, boundary: 'testframe'});
+  assert.equal(producer.contentType(), 'multipart/x-mixed-replace; boundary=testframe');
+
+  var server = http.createServer(function(req, res) {
+    res.writeHead(200, {'Content-Type': producer.contentType()});
+    producer.subscribe().pipe(res);
+  });
+
+  server.listen(0, '127.0.0.1', function() {
+    http.get({host: '127.0.0.1', port: server.address().port}, function(res) {
+      assert.equal(res.headers['content-type'], producer.contentType());
+      var body = [];
+      res.on('data', function(data) { body.push(data); });
+      res.on('end', function() {
+        var all = Buffer.concat(body);
+        var jpegs = [];
+        var pos = 0;
+        // Each part is the boundary, its headers, and a JPEG of the length
+        // they give
+        while (pos < all.length) {
+          var headerEnd = all.indexOf('\r\n\r\n', pos);
+          var head = all.slice(pos, headerEnd).toString();
+          assert.equal(head.indexOf('--testframe\r\nContent-Type: image/jpeg\r\n'), 0);
+          var length = +/Content-Length: (\d+)/.exec(head)[1];
+          jpegs.push(all.slice(headerEnd + 4, headerEnd + 4 + length));
+          assert.equal(all.slice(headerEnd + 4 + length, headerEnd + 6 + length).toString(), '\r\n');
+          pos = headerEnd + 6 + length;
+        }
+
+        var stats = producer.stats();
+        assert.ok(jpegs.length > 0, jpegs.length + ' parts');
+        assert.ok(stats.encoded >= jpegs.length);
+        assert.ok(stats.quality >= 30 && stats.quality <= 70);
+
+        cv.readImage(jpegs[0], function(err, im) {
+          assert.error(err);
+          assert.equal(im.width(), 160);
+          server.close();
+          cap.release();
+          assert.end();
+        });
+      });
+    });
+  });
+});
+
 // Test the examples folder.
 require('./examples')()